@@ -1,51 +1,145 @@
 #include "checkpoint.h"
 #include "moleculardynamics/Ar_moleculardynamics.h"
+#include <cerrno>    // for errno, ERANGE
+#include <cstdint>   // for std::int32_t
+#include <cstdlib>   // for std::atoi, std::strtol, EXIT_FAILURE
+#include <iostream>  // for std::cerr
+#include <limits>    // for std::numeric_limits
+#include <stdexcept> // for std::invalid_argument
+
+#ifdef USE_MPI
+    #include <boost/mpi/communicator.hpp>   // for boost::mpi::communicator
+    #include <boost/mpi/environment.hpp>    // for boost::mpi::environment
+#endif
 
 namespace {
     static auto constexpr LOOP = 100;
 }
 
-int main()
+int main(int argc, char * argv[])
 {
+#ifdef USE_MPI
+    // mpirun -np NŋNƁAŌN̃vZXŔԕČvZ
+    // 񉻖ETBBEOpenCLł̌vZƌʂ̕\́Aŏ̃vZXs
+    boost::mpi::environment env(argc, argv);
+    auto const root = boost::mpi::communicator().rank() == 0;
+#else
+    auto const root = true;
+#endif
+
     checkpoint::CheckPoint cp;
     cp.checkpoint("Jn", __LINE__);
 
-    moleculardynamics::Ar_moleculardynamics<float> armd;
+    // ڂ̈OpenCLfoCXwłiF"gpu"A"cpu:4"A"cpu:numa"j
+    moleculardynamics::Ar_moleculardynamics<float> armd(argc > 2 ? argv[2] : "");
 
-    cp.checkpoint("", __LINE__);
+    // Ŋiq̐w肳Ă΁Ȃ傫̌nɂi̐łȂΏIj
+    if (argc > 1) {
+        char * end;
+        errno = 0;
+        auto const nc = std::strtol(argv[1], &end, 10);
+        if (*end != '\0' || errno == ERANGE || nc < 1 || nc > std::numeric_limits<std::int32_t>::max()) {
+            std::cerr << "The number of supercells must be a positive integer: " << argv[1] << std::endl;
+            return EXIT_FAILURE;
+        }
 
-    for (auto i = 0; i < LOOP; i++) {
-        armd.Calc_Forces<moleculardynamics::ParallelType::NoParallel>();
-        armd.Move_Atoms<moleculardynamics::ParallelType::NoParallel>();
+        // q傫ꍇsetNcO𓊂
+        try {
+            armd.setNc(static_cast<std::int32_t>(nc));
+        }
+        catch (std::invalid_argument const & e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
     }
 
-    cp.checkpoint("񉻖", __LINE__);
+    // Oڂ̈0ȊOȂATBBłNUMAm[hƂɌq𕪂Aem[h̃RAɌŒ肵XbhŌvZ
+    if (argc > 3 && std::atoi(argv[3]) != 0) {
+        armd.setTbbAffinity(true);
+    }
 
-    armd.reset();
-    
-    cp.checkpoint("ď", __LINE__);
+    cp.checkpoint("", __LINE__);
 
-    for (auto i = 0; i < LOOP; i++) {
-        armd.Calc_Forces<moleculardynamics::ParallelType::Tbb>();
-        armd.Move_Atoms<moleculardynamics::ParallelType::Tbb>();
-    }
+    if (root) {
+        for (auto i = 0; i < LOOP; i++) {
+            armd.Calc_Forces<moleculardynamics::ParallelType::NoParallel>();
+            armd.Move_Atoms<moleculardynamics::ParallelType::NoParallel>();
+        }
+
+        cp.checkpoint("񉻖", __LINE__);
+
+        armd.reset();
+
+        cp.checkpoint("ď", __LINE__);
+
+        for (auto i = 0; i < LOOP; i++) {
+            armd.Calc_Forces<moleculardynamics::ParallelType::Tbb>();
+            armd.Move_Atoms<moleculardynamics::ParallelType::Tbb>();
+        }
+
+        cp.checkpoint("TBBŕ", __LINE__);
+
+        armd.reset();
 
-    cp.checkpoint("TBBŕ", __LINE__);
+        cp.checkpoint("ď", __LINE__);
 
+        for (auto i = 0; i < LOOP; i++) {
+            armd.Calc_Forces<moleculardynamics::ParallelType::OpenCl>();
+            armd.Move_Atoms<moleculardynamics::ParallelType::OpenCl>();
+        }
+
+        cp.checkpoint("OpenCLŕ", __LINE__);
+
+        armd.reset();
+
+        cp.checkpoint("ď", __LINE__);
+
+        // TBBOpenCLƂŌq𕪂ēɌvZihybrid_split.txtɋL^j
+        for (auto i = 0; i < LOOP; i++) {
+            armd.Calc_Forces<moleculardynamics::ParallelType::Hybrid>();
+            armd.Move_Atoms<moleculardynamics::ParallelType::Hybrid>();
+        }
+
+        cp.checkpoint("TBBOpenCLŕ", __LINE__);
+
+        armd.reset();
+
+        cp.checkpoint("ď", __LINE__);
+
+        // TBB̃t[OtŎԔWiGlM[̏o͂Ɠaz֐̌vŹÃXebv̌vZƓɍsj
+        armd.runFlowGraph(LOOP, true);
+
+        cp.checkpoint("TBB̃t[Otŕ", __LINE__);
+    }
+
+#ifdef USE_MPI
+    // SẴvZXœԂn߂iԂ͍ŏ̃vZX̂̂zj
     armd.reset();
 
     cp.checkpoint("ď", __LINE__);
 
     for (auto i = 0; i < LOOP; i++) {
-        armd.Calc_Forces<moleculardynamics::ParallelType::OpenCl>();
-        armd.Move_Atoms<moleculardynamics::ParallelType::OpenCl>();
+        armd.Calc_Forces<moleculardynamics::ParallelType::Mpi>();
+        armd.Move_Atoms<moleculardynamics::ParallelType::Mpi>();
     }
 
-    cp.checkpoint("OpenCLŕ", __LINE__);
+    cp.checkpoint("MPIŕ", __LINE__);
+
+    // evZX󂯎qW߂iSẴvZXŌĂяoKvj
+    armd.reset();
+
+    if (!root) {
+        return 0;
+    }
+#endif
 
     cp.checkpoint_print();
     
     armd.getinfo();
 
+    armd.benchmarkForceKernel(10);
+
+    armd.printstatistics();
+
     return 0;
 }
\ No newline at end of file
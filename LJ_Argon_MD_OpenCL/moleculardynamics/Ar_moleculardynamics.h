@@ -11,26 +11,65 @@
 #pragma once
 
 #include "../myrandom/myrand.h"
+#include "deviceselector.h"
+#include "deviceslab.h"
+#include "forcekerneltype.h"
+#include "linkedcell.h"
+#include "ljkernel.h"
+#ifdef USE_MPI
+    #include "mpidomain.h"
+#endif
+#include "neighborsearchtype.h"
+#include "pairpotential.h"
+#include "pairpotentialtype.h"
 #include "paralleltype.h"
+#include "particlestore.h"
+#include "precision.h"
+#include "programcache.h"
+#include "radialdistribution.h"
+#include "simdtype.h"
+#include "stepsnapshot.h"
+#include "tbbaffinity.h"
+#include "thermostattype.h"
+#include "verletlist.h"
+#include <algorithm>                                // for std::find, std::max, std::max_element, std::min, std::sort
+#include <array>                                    // for std::array
+#include <cstddef>                                  // for std::size_t
 #include <cstdint>                                  // for std::int32_t
-#include <cmath>                                    // for std::sqrt, std::pow
-#include <fstream>                                  // for std::ofstream
-#include <iostream>                                 // for std::ios_base::fixed, std::ios_base::floatfield, std::cout
-#include <string>                                   // for std::string
+#include <cmath>                                    // for std::fabs, std::floor, std::lround, std::nearbyint, std::pow, std::sqrt
+#include <fstream>                                  // for std::ifstream, std::ofstream
+#include <iostream>                                 // for std::ios_base::fixed, std::ios_base::floatfield, std::cout, std::hexfloat
+#include <limits>                                   // for std::numeric_limits
+#include <memory>                                   // for std::make_shared, std::shared_ptr
+#include <numeric>                                  // for std::accumulate
+#include <sstream>                                  // for std::ostringstream
+#include <stdexcept>                                // for std::invalid_argument, std::runtime_error
+#include <string>                                   // for std::string, std::to_string
+#include <tuple>                                    // for std::get, std::make_tuple, std::tuple
+#include <utility>                                  // for std::make_pair, std::move, std::pair
+#include <type_traits>                              // for std::is_same
 #include <vector>                                   // for std::vector
-#include <boost/compute/algorithm/accumulate.hpp>   // for boost::compute::accumulate
+#include <boost/compute/algorithm/exclusive_scan.hpp>   // for boost::compute::exclusive_scan
 #include <boost/compute/algorithm/fill.hpp>         // for boost::compute::fill
-#include <boost/compute/algorithm/transform.hpp>    // for boost::compute::transform
+#include <boost/compute/algorithm/gather.hpp>       // for boost::compute::gather
+#include <boost/compute/algorithm/iota.hpp>         // for boost::compute::iota
+#include <boost/compute/algorithm/scatter.hpp>      // for boost::compute::scatter
+#include <boost/compute/algorithm/sort_by_key.hpp>  // for boost::compute::sort_by_key
 #include <boost/compute/container/vector.hpp>       // for boost::compute::vector
+#include <boost/compute/event.hpp>                  // for boost::compute::event
+#include <boost/compute/iterator/counting_iterator.hpp> // for boost::compute::counting_iterator
+#include <boost/compute/memory/local_buffer.hpp>    // for boost::compute::local_buffer
 #include <boost/compute/types/fundamental.hpp>		// for boost::compute::float4_
 #include <boost/compute/utility/source.hpp>         // for BOOST_COMPUTE_STRINGIZE_SOURCE
+#include <boost/compute/utility/wait_list.hpp>      // for boost::compute::wait_list
 #include <boost/format.hpp>                         // for boost::format
 #include <boost/mpl/int.hpp>                        // for boost::mpl::int_
-#include <boost/optional.hpp>                       // for boost::optional
-#include <boost/range/algorithm/generate.hpp>       // for boost::generate
-#include <boost/utility/in_place_factory.hpp>       // for boost::in_place
 #include <tbb/combinable.h>                         // for tbb::combinable
+#include <tbb/enumerable_thread_specific.h>         // for tbb::enumerable_thread_specific
+#include <tbb/flow_graph.h>                         // for tbb::flow::graph
 #include <tbb/parallel_for.h>                       // for tbb::parallel_for
+#include <tbb/task_group.h>                         // for tbb::task_group
+#include <tbb/tick_count.h>                         // for tbb::tick_count
 
 namespace moleculardynamics {
     namespace compute = boost::compute;
@@ -41,14 +80,44 @@ namespace moleculardynamics {
     */
     template <typename T>
     class Ar_moleculardynamics final {
+        // #region 型エイリアス
+
+        //! A typedef.
+        /*!
+            力とエネルギーの足し合わせ、および座標・速度の時間発展に用いる型（混合精度の場合はdouble）
+        */
+        using real_type = typename Precision<T>::real_type;
+
+        //! A typedef.
+        /*!
+            real_typeに対応するデバイス側の4成分のベクトルの型
+        */
+        using real4_type = typename DeviceType<real_type>::vector4_type;
+
+        //! A typedef.
+        /*!
+            Tに対応するデバイス側の4成分のベクトルの型
+        */
+        using pair4_type = typename DeviceType<T>::vector4_type;
+
+        //! A typedef.
+        /*!
+            デバイス側の座標・速度・力の配列の要素の型（SoAならreal_typeで、x, y, z成分のブロックを順に並べる）
+        */
+        using particle_type = typename ParticleStore<real_type>::device_type;
+
+        // #endregion 型エイリアス
+
         // #region コンストラクタ・デストラクタ
 
     public:
         //! A constructor.
         /*!
             コンストラクタ
+            \param devicespec 使用するOpenCLデバイスの指定（書式はDeviceSelectorを参照、空文字列なら既定のデバイス）
+                複数のデバイスを指定すると、原子を分割してそれぞれのデバイスで計算する
         */
-        Ar_moleculardynamics();
+        explicit Ar_moleculardynamics(std::string const & devicespec = std::string());
 
         //! A destructor.
         /*!
@@ -60,6 +129,23 @@ namespace moleculardynamics {
 
         // #region publicメンバ関数
 
+        //! A public member function.
+        /*!
+            現在の座標について、全ての原子の組を計算するOpenCLのカーネルを、
+            グローバルメモリから直接読み込むものとローカルメモリでタイル化したものとで比較する
+            \param repeat それぞれのカーネルを実行する回数
+        */
+        void benchmarkForceKernel(std::int32_t repeat);
+
+        //! A public member function.
+        /*!
+            OpenCLで力を計算するカーネルと時間発展のカーネルについて、
+            使用できるワークグループの大きさをそれぞれ試し、最も速いものを設定してディスクに保存する
+            （保存した設定は、同じデバイスと原子数で次に起動したときに読み込まれる）
+            \param repeat それぞれの組み合わせでカーネルを実行する回数
+        */
+        void autotune(std::int32_t repeat);
+
         //! A public member function.
         /*!
             原子に働く力を計算する
@@ -87,6 +173,20 @@ namespace moleculardynamics {
             原子に働く力を計算する（TBBで並列化）
         */
         void Calc_Forces(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Tbb)>);
+
+        //! A public member function.
+        /*!
+            原子に働く力を計算する（原子をTBBとOpenCLとに分けて同時に計算し、両方が同時に終わるように分け方を調整する）
+        */
+        void Calc_Forces(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Hybrid)>);
+
+#ifdef USE_MPI
+        //! A public member function.
+        /*!
+            原子に働く力を計算する（MPIで箱を空間分割し、各プロセスが受け持つ原子について計算する）
+        */
+        void Calc_Forces(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Mpi)>);
+#endif
         
         //! A public member function.
         /*!
@@ -121,6 +221,20 @@ namespace moleculardynamics {
             原子を移動させる（TBBで並列化）
         */
         void Move_Atoms(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Tbb)>);
+
+        //! A public member function.
+        /*!
+            原子を移動させる（TBBとOpenCLとで力を計算した場合、時間発展はホスト側でTBBを用いて行う）
+        */
+        void Move_Atoms(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Hybrid)>);
+
+#ifdef USE_MPI
+        //! A public member function.
+        /*!
+            原子を移動させる（MPIで箱を空間分割し、部分領域の外に出た原子は隣のプロセスに移す）
+        */
+        void Move_Atoms(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Mpi)>);
+#endif
         
         //! A public member function.
         /*!
@@ -128,1177 +242,5395 @@ namespace moleculardynamics {
         */
         void reset();
 
-        // #endregion publicメンバ関数
-
-        // #region privateメンバ関数
+        //! A public member function.
+        /*!
+            OpenCLで計算する場合に、座標・速度・力をデバイス側に置いたままにするかどうかを設定する
+            falseにすると、ステップごとにホストとデバイスの間で転送する
+            \param deviceresident デバイス側に置いたままにするならtrue
+        */
+        void setDeviceResident(bool deviceresident)
+        {
+            // 最新の値をホスト側に戻してから切り替える
+            UseHostState();
+            deviceresident_ = deviceresident;
+        }
 
-    private:
-        //! A private member function.
+        //! A public member function.
         /*!
-            原子の初期位置を決める
+            OpenCLのカーネルを-cl-fast-relaxed-mathでビルドするかどうかを設定する
+            精度が落ちるので、既定ではビルドしない（次に力を計算するときにビルドし直す）
+            \param fastmath -cl-fast-relaxed-mathでビルドするならtrue
         */
-        void MD_initPos();
+        void setFastMath(bool fastmath)
+        {
+            fastmath_ = fastmath;
+        }
 
-        //! A private member function.
+        //! A public member function.
         /*!
-            原子の初期速度を決める
+            TBBで並列化した場合に、Newtonの第三法則を用いて各原子の組を一度だけ計算するかどうかを設定する
+            \param halfpair 各原子の組を一度だけ計算するならtrue
         */
-        void MD_initVel();
+        void setHalfPair(bool halfpair)
+        {
+            halfpair_ = halfpair;
+        }
 
-        //! A private member function.
+        //! A public member function.
         /*!
-            カーネルを設定する
+            スーパーセルの個数を設定し、原子数が4 * nc^3の系で初期化し直す
+            \param nc 1辺あたりのスーパーセルの個数
+            \throw std::invalid_argument ncが1より小さいか、原子数4 * nc^3がstd::int32_tに収まらない場合
         */
-        void SetKernel();
+        void setNc(std::int32_t nc);
 
-        //! A private member function (constant).
+        //! A public member function.
         /*!
-            ノルムの二乗を求める
-            \param x x座標
-            \param y y座標
-            \param z z座標
-            \return ノルムの二乗
+            相互作用する原子の組を探索する手法を設定する
+            \param neighborsearchtype 相互作用する原子の組を探索する手法
         */
-        T norm2(T x, T y, T z) const
+        void setNeighborSearchType(NeighborSearchType neighborsearchtype)
         {
-            return x * x + y * y + z * z;
+            neighborsearchtype_ = neighborsearchtype;
+            rebuildverletlist_ = true;
         }
 
-        // #endregion privateメンバ関数
-
-        // #region メンバ変数
-
-    public:
-        //! A private member variable (constant).
+        //! A public member function.
         /*!
-            初期のスーパーセルの個数
+            Lennard-Jonesポテンシャルの評価方法を設定する（ホスト側とデバイス側で共通）
+            SIMD命令を用いる場合は常にr^2の式で計算し、スプライン補間の場合はSIMD命令を用いない
+            \param type 評価方法
+            \param tablesize スプライン補間の表の区間の個数
         */
-        static auto constexpr FIRSTNC = 8;
+        void setPairPotentialType(PairPotentialType type, std::int32_t tablesize = PairPotential<T>::DEFAULTTABLESIZE)
+        {
+            pairpotential_.setup(type, tablesize, rc2_, Vrc_);
+            SetPairPotentialArgs();
+        }
 
-        //! A private member variable (constant).
+        //! A public member function.
         /*!
-            初期の格子定数のスケール
+            CPUで力を計算する場合に使用するSIMD命令セットを設定する（CPUが対応していなければ、対応する中で最も新しいもの）
+            \param simdtype 使用するSIMD命令セット
         */
-        static T const FIRSTSCALE;
+        void setSimdType(SimdType simdtype)
+        {
+            ljkernel_.setup(simdtype, periodiclen_, rc2_, Vrc_);
+        }
 
-        //! A private member variable (constant).
+        //! A public member function.
         /*!
-            初期温度（絶対温度）
+            近接リストのスキンの厚さを設定する
+            \param skin 近接リストのスキンの厚さ
         */
-        static T const FIRSTTEMP;
+        void setSkin(T skin)
+        {
+            skin_ = skin;
+            rebuildverletlist_ = true;
+        }
 
-    private:
-        //! A private member variable (constant).
+        //! A public member function.
         /*!
-            Woodcockの温度スケーリングの係数
+            TBBで並列化した場合に、原子をNUMAノードごとに分けて各ノードのコアに固定したスレッドで計算し、
+            ステップ間で同じ原子の区間を同じスレッドに割り当てるかどうかを設定する
+            有効にすると、原子の配列も受け持つノードのスレッドで書き込み直して、そのノードのメモリに置く
+            \param affinity NUMAノードとキャッシュの親和性を保つならtrue
         */
-        static T const ALPHA;
+        void setTbbAffinity(bool affinity)
+        {
+            // 最新の値をホスト側に戻してから切り替える
+            UseHostState();
+            tbbaffinity_.setup(affinity);
+            FirstTouch();
+        }
 
-        //! A private member variable (constant).
+        //! A public member function.
         /*!
-            時間刻みΔt
+            温度のスケーリングに用いる運動エネルギーの求め方を設定する
+            Laggedの場合は一つ前のステップの温度を用いるので、時間発展の前に運動エネルギーの総和を待たなくてよい
+            \param thermostattype 運動エネルギーの求め方
         */
-        static T const DT;
-        
-        //! A private member variable (constant).
+        void setThermostatType(ThermostatType thermostattype)
+        {
+            thermostattype_ = thermostattype;
+        }
+
+        //! A public member function.
         /*!
-            ボルツマン定数
+            OpenCLで全ての原子の組を計算する場合に、ローカルメモリでタイル化したカーネルを用いるかどうかを設定する
+            \param tiledforce タイル化したカーネルを用いるならtrue
         */
-        static T const KB;
-        
-        //! A private member variable (constant).
+        void setTiledForce(bool tiledforce)
+        {
+            tiledforce_ = tiledforce;
+        }
+
+        //! A public member function.
         /*!
-            ローカルワークサイズ
+            統計情報を表示する
         */
-        static auto constexpr LOCALWORKSIZE = 256;
+        void printstatistics() const;
 
-        //! A private member variable (constant).
+        //! A public member function.
         /*!
-            OpenCLで並列化した場合の結果を出力するファイル名
+            TBBのフローグラフで、指定したステップ数だけ時間発展させる
+            力の計算と運動エネルギーの計算を同時に行い、エネルギーの出力と解析は次のステップの計算と同時に行う
+            \param steps ステップ数
+            \param analysis ANALYSISINTERVALステップごとに動径分布関数を求め（前の解析が終わっていなければ飛ばす）、最後にrdf.txtに出力するならtrue
         */
-        static std::string const OPENCLRESULTFILENAME;
-        
-        //! A private member variable (constant).
+        void runFlowGraph(std::int32_t steps, bool analysis = false);
+
+        // #endregion publicメンバ関数
+
+        // #region privateメンバ関数
+
+    private:
+        //! A private member function.
         /*!
-            並列化無しの場合の結果を出力するファイル名
+            全ての原子の組について、[begin, end)番目の原子に働く力を計算する
+            \tparam HalfPair trueならNewtonの第三法則を用いて各原子の組を一度だけ計算する
+            \param F 力を加える配列
+            \param begin 最初の原子の番号
+            \param end 最後の原子の番号の次
+            \param W [begin, end)番目の原子が関わるビリアルを加える変数
+            \return [begin, end)番目の原子が関わるポテンシャルエネルギーの和
         */
-        static std::string const RESULTFILENAME;
+        template <bool HalfPair>
+        real_type Calc_Forces_AllPairs(ParticleStore<real_type> & F, std::int32_t begin, std::int32_t end, real_type & W);
 
-        //! A private member variable (constant).
+        //! A private member function.
         /*!
-            TBBで並列化した場合の結果を出力するファイル名
+            セルリストを用いて、[begin, end)番目の原子に働く力を計算する
+            \tparam HalfPair trueならNewtonの第三法則を用いて各原子の組を一度だけ計算する
+            \param F 力を加える配列
+            \param begin 最初の原子の番号
+            \param end 最後の原子の番号の次
+            \param W [begin, end)番目の原子が関わるビリアルを加える変数
+            \return [begin, end)番目の原子が関わるポテンシャルエネルギーの和
         */
-        static std::string const TBBRESULTFILENAME;
+        template <bool HalfPair>
+        real_type Calc_Forces_LinkedCell(ParticleStore<real_type> & F, std::int32_t begin, std::int32_t end, real_type & W);
 
-        //! A private member variable (constant).
+        //! A private member function.
         /*!
-            アルゴン原子に対するε
+            相互作用する原子の組を探索する手法に従って、[begin, end)番目の原子に働く力を計算する
+            \tparam HalfPair trueならNewtonの第三法則を用いて各原子の組を一度だけ計算する
+            \param F 力を加える配列
+            \param begin 最初の原子の番号
+            \param end 最後の原子の番号の次
+            \param W [begin, end)番目の原子が関わるビリアルを加える変数
+            \return [begin, end)番目の原子が関わるポテンシャルエネルギーの和
         */
-        static T const YPSILON;
+        template <bool HalfPair>
+        real_type Calc_Forces_Range(ParticleStore<real_type> & F, std::int32_t begin, std::int32_t end, real_type & W);
 
-        //! A private member variable (constant).
+        //! A private member function.
         /*!
-            時間刻みの二乗
+            近接原子を連続した配列に詰め込み、SIMD命令を用いて[begin, end)番目の原子に働く力を計算する
+            \tparam HalfPair trueならNewtonの第三法則を用いて各原子の組を一度だけ計算する
+            \param F 力を加える配列
+            \param begin 最初の原子の番号
+            \param end 最後の原子の番号の次
+            \param W [begin, end)番目の原子が関わるビリアルを加える変数
+            \return [begin, end)番目の原子が関わるポテンシャルエネルギーの和
         */
-        T const dt2;
+        template <bool HalfPair>
+        real_type Calc_Forces_Simd(ParticleStore<real_type> & F, std::int32_t begin, std::int32_t end, real_type & W);
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            OpenCLデバイス
+            近接リストを用いて、[begin, end)番目の原子に働く力を計算する
+            \tparam HalfPair trueならNewtonの第三法則を用いて各原子の組を一度だけ計算する
+            \param F 力を加える配列
+            \param begin 最初の原子の番号
+            \param end 最後の原子の番号の次
+            \param W [begin, end)番目の原子が関わるビリアルを加える変数
+            \return [begin, end)番目の原子が関わるポテンシャルエネルギーの和
         */
-        compute::device device_;
+        template <bool HalfPair>
+        real_type Calc_Forces_VerletList(ParticleStore<real_type> & F, std::int32_t begin, std::int32_t end, real_type & W);
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            OpenCL context
+            原子の組に働く力を計算し、n個目の原子に働く力に加える
+            \tparam HalfPair trueならm個目の原子にも反作用を加える
+            \param F 力を加える配列
+            \param n 原子の番号
+            \param m 相手の原子の番号
+            \param dx 原子間の距離のx成分
+            \param dy 原子間の距離のy成分
+            \param dz 原子間の距離のz成分
+            \param r2 原子間の距離の二乗
+            \param W ビリアルを加える変数（HalfPairがfalseなら二重計算のために0.5をかけたものを加える）
+            \return 原子の組のポテンシャルエネルギー（HalfPairがfalseなら二重計算のために0.5をかけたもの）
         */
-        compute::context context_;
+        template <bool HalfPair>
+        T Calc_Force_Pair(ParticleStore<real_type> & F, std::int32_t n, std::int32_t m, T dx, T dy, T dz, T r2, real_type & W);
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            格子定数
+            複数のOpenCLデバイスで、それぞれが受け持つ原子に働く力を計算する
         */
-        T lat_;
+        void Calc_Forces_MultiDevice();
 
-        //! A private member variable (constant).
+        //! A private member function.
         /*!
-            スーパーセルの個数
+            デバイス上で各原子が属するセルを求め、デバイス側の座標・速度をセルの番号順に並べ替える
         */
-        std::int32_t Nc_ = Ar_moleculardynamics::FIRSTNC;
+        void BinAtoms();
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            n個目の原子に働く力
+            近接リストまたはセルリストを、必要であれば構築する
         */
-        std::vector<compute::float4_> F_;
-        
-        //! A private member variable.
+        void BuildNeighborSearch();
+
+        //! A private member function.
         /*!
-            n個目の原子に働く力（デバイス側）
+            近接リストの再構築が必要かどうかを、原子の最大変位から判定する
+            \param maxdisp2 近接リストを構築した時点からの原子の変位の二乗の最大値
         */
-        compute::vector<compute::float4_> F_dev_;
-        
-        //! A private member variable.
+        void CheckVerletList(T maxdisp2);
+
+        //! A private member function.
         /*!
-            周期境界条件をチェックするカーネル
+            デバイス側で求めた原子の最大変位が読み込まれていれば、近接リストの再構築が必要かどうかを判定する
         */
-        compute::kernel kernel_check_periodic_;
+        void CheckVerletListDevice();
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            各原子に働く力を計算するカーネル
+            直前に投入したカーネルの完了を待つようにして、カーネルを投入する（ホスト側は完了を待たない）
+            \param kernel 投入するカーネル
+            \param localworksize ワークグループの大きさ
         */
-        compute::kernel kernel_force_;
+        void EnqueueKernel(compute::kernel & kernel, std::int32_t localworksize);
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            Verlet法で時間発展するカーネル
+            直前に投入したカーネルの完了を待つようにして、先頭からglobalsize個のワークアイテムでカーネルを投入する
+            \param kernel 投入するカーネル
+            \param localworksize ワークグループの大きさ
+            \param globalsize ワークアイテムの個数（ワークグループの大きさの倍数）
         */
-        compute::kernel kernel_move_atoms_;
-        
-        //! A private member variable.
+        void EnqueueKernel(compute::kernel & kernel, std::int32_t localworksize, std::int32_t globalsize);
+
+        //! A private member function.
         /*!
-            修正Euler法で時間発展するカーネル
+            デバイスが受け持つ原子の範囲をグローバルワークオフセットとして、そのデバイスのキューにカーネルを投入する
+            （そのデバイスの座標を他のデバイスに送るコピーと、直前に投入したコマンドの完了を待つ）
+            \param slab デバイスが受け持つ範囲とキュー
+            \param kernel 投入するカーネル
+            \param localworksize ワークグループの大きさ
         */
-        compute::kernel kernel_move_atoms1_;
+        void EnqueueSlabKernel(DeviceSlab<real_type> & slab, compute::kernel & kernel, std::int32_t localworksize);
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            MDのステップ数
+            各デバイスが時間発展させた原子の座標を、他の全てのデバイスにコピーする（ホストを経由しない）
         */
-        std::int32_t MD_iter_;
+        void ExchangePositions();
 
-        //! A private member variable (constant).
+        //! A private member function.
         /*!
-            相互作用を計算するセルの個数
+            使用できるワークグループの大きさについて、カーネルをrepeat回実行するのにかかった時間を測る
+            \param name 統計情報に表示するカーネルの名前
+            \param kernel 実行するカーネル
+            \param repeat カーネルを実行する回数
+            \param prepare カーネルを実行する前に、ワークグループの大きさを引数として呼び出す関数
+            \return 最も速かったワークグループの大きさと、そのときの1回あたりの時間
         */
-        std::int32_t const ncp_ = 4;
+        template <typename Function>
+        std::pair<std::int32_t, double> TuneKernel(std::string const & name, compute::kernel & kernel, std::int32_t repeat, Function const & prepare);
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            原子数
+            デバイス側の配列をホスト側の配列に転送する（セルの番号順に並べ替えている場合は元の原子の番号順に戻す）
+            \param dev デバイス側の配列
+            \param host ホスト側の配列
         */
-        std::int32_t NumAtom_;
-        
-        //! A private member variable.
+        void CopyFromDevice(compute::vector<particle_type> const & dev, ParticleStore<real_type> & host);
+
+        //! A private member function.
         /*!
-            並列化無しの場合の結果出力用のファイルストリーム
+            ホスト側の配列をデバイス側の配列に転送する（セルの番号順に並べ替えている場合は同じ順に並べる）
+            \param host ホスト側の配列
+            \param dev デバイス側の配列
         */
-        std::ofstream ofs_;
+        void CopyToDevice(ParticleStore<real_type> const & host, compute::vector<particle_type> & dev);
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            OpenCLで並列化した場合の結果出力用のファイルストリーム
+            原子の初期位置を決める
         */
-        std::ofstream openclofs_;
+        void MD_initPos();
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            周期境界条件の長さ
+            原子の初期速度を決める
         */
-        T periodiclen_;
-        
-        //! A private member variable.
+        void MD_initVel();
+
+        //! A private member function.
         /*!
-            ベクトルの大きさの二乗を求める関数オブジェクト
+            スーパーセルの個数に合わせて、配列を確保して原子の初期位置と初期速度を決め直す
         */
-        boost::optional<compute::function<float(compute::float4_)>> pnorm2_;
+        void ModLattice();
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            OpenCLのキュー
+            TBBでNUMAノードとキャッシュの親和性を保つ場合に、原子の配列を確保し直し、
+            時間発展と同じ分割で各ノードのスレッドから最初に書き込んで、そのノードのメモリに置く
         */
-        compute::command_queue queue_;
+        void FirstTouch();
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            n個目の原子の座標
+            複数のOpenCLデバイスで、それぞれが受け持つ原子を時間発展させ、座標を交換する
         */
-        std::vector<compute::float4_> r_;
+        void Move_Atoms_MultiDevice();
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            n個目の原子の座標の複製
+            ホスト側でTBBを用いて原子を移動させる
+            \param ofs 結果出力用のファイルストリーム
         */
-        std::vector<compute::float4_> r_clone_;
+        void Move_Atoms_Tbb(std::ofstream & ofs);
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            n個目の原子の座標（デバイス側）
+            TBBで並列化して、運動エネルギーを求める
+            \return 運動エネルギー
         */
-        compute::vector<compute::float4_> r_dev_;
+        real_type Calc_Kinetic_Energy_Tbb();
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            n個目の原子の初期座標
+            TBBで並列化して、座標と速度を1ステップ分更新する
+            周期境界条件の処理、近接リストを構築した時点からの変位の判定、次のステップの力の初期化も同じループで行う
+            \param s 速度のスケーリングの係数
+            \param lagged 一つ前のステップの温度を用いる場合はtrue
+            \return 一つ前のステップの温度を用いる場合は、更新する前の速度から求めた運動エネルギー（それ以外は0）
         */
-        std::vector<compute::float4_> r1_;
+        real_type Integrate_Tbb(real_type s, bool lagged);
 
-        //! A private member variable.
+        //! A private member function (constant).
         /*!
-            n個目の原子の初期座標（デバイス側）
+            シミュレーションの定数をカーネルに埋め込むためのビルドオプションを返す
+            \return ビルドオプション
         */
-        compute::vector<compute::float4_> r1_dev_;
-        
-        //! A private member variable (constant).
+        std::string KernelOptions() const;
+
+        //! A private member function.
         /*!
-            カットオフ半径
+            ディスクに保存されたワークグループの大きさを読み込み、設定する
         */
-        T const rc_ = 2.5;
+        void LoadTuning();
 
-        //! A private member variable (constant).
+        //! A private member function (constant).
         /*!
-            カットオフ半径の2乗
+            カーネルに使用できるワークグループの大きさを返す
+            （2の累乗で、デバイスとカーネルの上限以下のもの）
+            \param kernel カーネル
+            \return 使用できるワークグループの大きさ
         */
-        T const rc2_;
+        std::vector<std::int32_t> LocalWorkSizes(compute::kernel const & kernel) const;
 
-        //! A private member variable (constant).
+        //! A private member function (constant).
         /*!
-            カットオフ半径の逆数の6乗
+            現在のデバイスと原子数に対応する、ワークグループの大きさを保存するファイル名を返す
+            \return ファイル名
         */
-        T const rcm6_;
+        std::string TuningPath() const;
 
-        //! A private member variable (constant).
+        //! A private member function.
         /*!
-            カットオフ半径の逆数の12乗
+            カーネルを設定する
         */
-        T const rcm12_;
+        void SetKernel();
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            格子定数のスケーリングの定数
+            カーネルに埋め込んだ定数が変わっていれば、カーネルを設定し直す
         */
-        T scale_ = Ar_moleculardynamics::FIRSTSCALE;
+        void UpdateKernel();
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            TBBで並列化した場合の結果出力用のファイルストリーム
+            スプライン補間の表をデバイスに転送し、力を計算するカーネルにポテンシャルの評価方法を設定する
         */
-        std::ofstream tbbofs_;
-        
-        //! A private member variable.
+        void SetPairPotentialArgs();
+
+        //! A private member function.
         /*!
-            計算された温度Tcalc
+            ワークグループごとの部分和をホスト側に非同期に読み込む
+            \param kinetic 運動エネルギーの部分和も読み込むならtrue
+            \return 読み込みのイベント（読み込むものがなければ空のイベント）
         */
-        T Tc_;
+        compute::event EnqueueReadPartials(bool kinetic);
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            与える温度Tgiven
+            ワークグループごとの部分和の読み込みを待ち、エネルギーとビリアルを求める
+            \param event 読み込みのイベント
+            \param kinetic 運動エネルギーも求めるならtrue
         */
-        T Tg_;
-        
-        //! A private member variable.
+        void FinishReadPartials(compute::event const & event, bool kinetic);
+
+        //! A private member function.
         /*!
-            運動エネルギー
+            全エネルギーを求めて出力し、温度を求める
+            \param ofs 結果出力用のファイルストリーム
+            \param s 時間発展に用いた（用いる）温度のスケーリングの係数（Laggedの場合に正確な係数と比較する）
         */
-        T Uk_;
+        void OutputEnergy(std::ofstream & ofs, real_type s);
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            ポテンシャルエネルギー
+            全エネルギーと温度を求め、出力するための値を写す
+            \param s 速度のスケーリングの係数（Exactの場合は0）
+            \return 出力するための値
         */
-        T Up_;
+        StepSnapshot<real_type> UpdateEnergy(real_type s);
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            各原子のポテンシャルエネルギー（デバイス側）
+            全エネルギーを出力し、ExactとLaggedの比較のための値を記録する
+            \param ofs 出力先のファイルストリーム
+            \param snapshot UpdateEnergy()で写した値
         */
-        compute::vector<float> Up_dev_;
+        void WriteEnergy(std::ofstream & ofs, StepSnapshot<real_type> const & snapshot);
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            全エネルギー
+            全てのデバイスのワークグループごとの部分和を読み込み、エネルギーとビリアルを求める
+            \param kinetic 運動エネルギーも求めるならtrue
         */
-        T Utot_;
-        
-        //! A private member variable.
+        void ReadSlabPartials(bool kinetic);
+
+        //! A private member function.
         /*!
-            n個目の原子の速度
+            TBBとOpenCLとで力を計算した時間を積算し、一定のステップごとにOpenCLで受け持つ原子の割合を決め直す
+            \param split OpenCLで受け持った原子の個数（残りをTBBで受け持った）
+            \param cputime TBBで力を計算した時間（秒）
+            \param devicetime OpenCLで力を計算し、結果を読み込んだ時間（秒）
         */
-        std::vector<compute::float4_> V_;
+        void RebalanceHybrid(std::int32_t split, double cputime, double devicetime);
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            n個目の原子の速度（複製用）
+            結果を出力するファイル名を返す（MPIで並列化した場合、最初のプロセス以外ではファイルを開かないように空文字列を返す）
+            \param filename ファイル名
+            \return 結果を出力するファイル名
         */
-        std::vector<compute::float4_> V_clone_;
+        static std::string ResultFileName(std::string const & filename);
 
-        //! A private member variable.
+        //! A private member function.
         /*!
-            n個目の原子の速度（デバイス側）
+            ワークグループごとの部分和をホスト側に読み込み、エネルギーとビリアルを求める
+            \param kinetic 運動エネルギーも求めるならtrue
         */
-        compute::vector<compute::float4_> V_dev_;
+        void ReadPartials(bool kinetic)
+        {
+            FinishReadPartials(EnqueueReadPartials(kinetic), kinetic);
+        }
 
-        //! A private member variable (constant).
+        //! A private member function.
         /*!
-            ポテンシャルエネルギーの打ち切り
+            デバイス側の座標・速度・力を、セルの番号順から元の原子の番号順に戻す
         */
-        T const Vrc_;
-        
-        // #endregion メンバ変数
-
-        // #region 禁止されたコンストラクタ・メンバ関数
+        void UnbinAtoms();
 
-        //! A private copy constructor (deleted).
+        //! A private member function.
         /*!
-            コピーコンストラクタ（禁止）
+            ホスト側で近接リストを構築してデバイスに転送し、近接リストを用いるカーネルに設定する
         */
-        Ar_moleculardynamics(Ar_moleculardynamics const &) = delete;
+        void UploadVerletList();
 
-        //! A private member function (deleted).
+        //! A private member function.
         /*!
-            operator=()の宣言（禁止）
-            \param コピー元のオブジェクト（未使用）
-            \return コピー元のオブジェクト
+            ホスト側で近接リストを構築して全てのデバイスに転送し、近接リストを用いるカーネルに設定する
         */
-        Ar_moleculardynamics & operator=(Ar_moleculardynamics const &) = delete;
+        void UploadVerletListSlabs();
 
-        // #endregion 禁止されたコンストラクタ・メンバ関数
-    };
+        //! A private member function.
+        /*!
+            デバイス側の座標・速度・力を最新の値にする（ホスト側の値は古くなる）
+        */
+        void UseDeviceState();
 
-    // #region static private 定数
+        //! A private member function.
+        /*!
+            ホスト側の座標・速度・力を最新の値にする（デバイス側の値は古くなる）
+        */
+        void UseHostState();
 
-    template <typename T>
-    T const Ar_moleculardynamics<T>::ALPHA = 0.2;
-    
-    template <typename T>
-    T const Ar_moleculardynamics<T>::DT = 0.001;
+#ifdef USE_MPI
+        //! A private member function.
+        /*!
+            MPIの各プロセスが受け持つ原子を最新の値にする（ホスト側の値は古くなる）
+        */
+        void UseMpiState();
+#endif
 
-    template <typename T>
-    T const Ar_moleculardynamics<T>::FIRSTSCALE = 1.0;
-    
-    template <typename T>
-    T const Ar_moleculardynamics<T>::FIRSTTEMP = 1.0;
+        //! A private member function.
+        /*!
+            デバイスごとの配列の座標・速度・力を最新の値にする（ホスト側と、最初のデバイスだけで計算する場合の値は古くなる）
+        */
+        void UseSlabState();
 
-    template <typename T>
-    T const Ar_moleculardynamics<T>::KB = 1.3806488E-23;
+        //! A private member function (constant).
+        /*!
+            最小イメージ規約に従って、原子間の距離の成分を周期境界条件の長さの半分以内に収める
+            \param d 原子間の距離の成分
+            \return 最も近いイメージとの距離の成分
+        */
+        real_type minimage(real_type d) const
+        {
+            return d - periodiclen_ * std::nearbyint(d / periodiclen_);
+        }
 
-    template <typename T>
-    std::string const Ar_moleculardynamics<T>::OPENCLRESULTFILENAME = "opencl_result.txt";
+        //! A private member function (constant).
+        /*!
+            Woodcockの温度スケーリングの係数を、現在のTc_から求める
+            \return 速度のスケーリングの係数
+        */
+        real_type thermostatscale() const
+        {
+            return std::sqrt((Tg_ + Ar_moleculardynamics::ALPHA * (Tc_ - Tg_)) / Tc_);
+        }
 
-    template <typename T>
-    std::string const Ar_moleculardynamics<T>::RESULTFILENAME = "result.txt";
+        //! A private member function (constant).
+        /*!
+            このステップで一つ前のステップの温度を用いて温度をスケーリングするかどうか
+            \return Laggedで、かつ最初のステップでなければtrue
+        */
+        bool uselaggedthermostat() const
+        {
+            return thermostattype_ == ThermostatType::Lagged && MD_iter_ > 1;
+        }
 
-    template <typename T>
-    std::string const Ar_moleculardynamics<T>::TBBRESULTFILENAME = "tbb_result.txt";
+        //! A private member function (constant).
+        /*!
+            ノルムの二乗を求める
+            \param x x座標
+            \param y y座標
+            \param z z座標
+            \return ノルムの二乗
+        */
+        real_type norm2(real_type x, real_type y, real_type z) const
+        {
+            return x * x + y * y + z * z;
+        }
 
-    template <typename T>
-    T const Ar_moleculardynamics<T>::YPSILON = 1.6540172624E-21;
+        //! A private static member function.
+        /*!
+            デバイス側でdoubleを使用するかどうか
+            \return Tまたはreal_typeがdoubleならtrue（cl_khr_fp64が必要）
+        */
+        static constexpr bool usefp64()
+        {
+            return std::is_same<T, double>::value || std::is_same<real_type, double>::value;
+        }
 
-    // #endregion static private 定数
+        //! A private member function (constant).
+        /*!
+            OpenCLで力を計算するのに用いるカーネルの種類を返す
+            \return 力を計算するのに用いるカーネルの種類
+        */
+        ForceKernelType forcekerneltype() const
+        {
+            if (useverletlist()) {
+                return ForceKernelType::VerletList;
+            }
+            else if (uselinkedcell()) {
+                return ForceKernelType::LinkedCell;
+            }
+            else {
+                return tiledforce_ ? ForceKernelType::AllPairsTiled : ForceKernelType::AllPairs;
+            }
+        }
 
-    // #region コンストラクタ
+        //! A private member function (constant).
+        /*!
+            TBBと同時に計算する場合に、OpenCLで力を計算するのに用いるカーネルの種類を返す
+            （セルリストのカーネルはデバイス上で原子を並べ替えるので、代わりに全ての原子の組を計算する）
+            \return 力を計算するのに用いるカーネルの種類
+        */
+        ForceKernelType hybridforcekerneltype() const
+        {
+            if (useverletlist()) {
+                return ForceKernelType::VerletList;
+            }
 
-    template <typename T>
-    Ar_moleculardynamics<T>::Ar_moleculardynamics()
-        :
-        device_(compute::system::default_device()),
-        context_(device_),
-        dt2(DT * DT),
-        F_(Nc_ * Nc_ * Nc_ * 4),
-        F_dev_(Nc_ * Nc_ * Nc_ * 4, context_),
-        ofs_(Ar_moleculardynamics::RESULTFILENAME),
-        openclofs_(Ar_moleculardynamics::OPENCLRESULTFILENAME),
-        queue_(context_, device_),
-        rc2_(rc_ * rc_),
-        rcm6_(std::pow(rc_, -6.0)),
-        rcm12_(std::pow(rc_, -12.0)),
-        Tg_(Ar_moleculardynamics::FIRSTTEMP * Ar_moleculardynamics::KB / Ar_moleculardynamics::YPSILON),
-        r_(Nc_ * Nc_ * Nc_ * 4),
-        r_clone_(Nc_ * Nc_ * Nc_ * 4),
-        r_dev_(Nc_ * Nc_ * Nc_ * 4, context_),
-        r1_(Nc_ * Nc_ * Nc_ * 4),
-        r1_dev_(Nc_ * Nc_ * Nc_ * 4, context_),
-        tbbofs_(Ar_moleculardynamics::TBBRESULTFILENAME),
-        Up_dev_(Nc_ * Nc_ * Nc_ * 4, context_),
-        V_(Nc_ * Nc_ * Nc_ * 4),
-        V_clone_(Nc_ * Nc_ * Nc_ * 4),
-        V_dev_(Nc_ * Nc_ * Nc_ * 4, context_),
-        Vrc_(4.0 * (rcm12_ - rcm6_))
-    {
-        // initalize parameters
-        lat_ = std::pow(2.0, 2.0 / 3.0) * scale_;
+            return tiledforce_ ? ForceKernelType::AllPairsTiled : ForceKernelType::AllPairs;
+        }
 
-        MD_iter_ = 1;
+        //! A private member function (constant).
+        /*!
+            TBBと同時に計算する場合に、OpenCLで受け持つワークグループの個数を返す
+            （原子が二つ以上のワークグループに分かれるときは、次の分け方を決められるように、どちらの側も原子を受け持つ）
+            \param localworksize ワークグループの大きさ
+            \return OpenCLで受け持つワークグループの個数
+        */
+        std::int32_t hybridgroups(std::int32_t localworksize) const
+        {
+            auto const ngroup = (NumAtom_ + localworksize - 1) / localworksize;
+            if (ngroup < 2) {
+                return hybridratio_ < 0.5 ? 0 : ngroup;
+            }
 
-        MD_initPos();
-        MD_initVel();
+            auto const groups = static_cast<std::int32_t>(std::lround(hybridratio_ * static_cast<double>(NumAtom_) / static_cast<double>(localworksize)));
+            return std::min(std::max(groups, 1), ngroup - 1);
+        }
 
-        periodiclen_ = lat_ * static_cast<T>(Nc_);
+        //! A private member function (constant).
+        /*!
+            OpenCLのカーネルのグローバルワークサイズを返す
+            \return 原子数をワークグループの大きさの最大値の倍数に切り上げたもの（デバイス側の配列の大きさ）
+        */
+        std::int32_t globalworksize() const
+        {
+            return (NumAtom_ + Ar_moleculardynamics::LOCALWORKSIZE - 1) / Ar_moleculardynamics::LOCALWORKSIZE * Ar_moleculardynamics::LOCALWORKSIZE;
+        }
 
-        SetKernel();
-    }
+        //! A private member function (constant).
+        /*!
+            ワークグループごとの部分和の配列で、一つの量が占める長さを返す
+            \return 最も小さいワークグループの大きさのときのワークグループの個数
+        */
+        std::int32_t partialstride() const
+        {
+            return globalworksize() / Ar_moleculardynamics::MINLOCALWORKSIZE;
+        }
 
-    // #endregion コンストラクタ
+        //! A private member function (constant).
+        /*!
+            最小イメージ規約を使用するかどうか
+            \return カットオフ半径が周期境界条件の長さの半分未満ならtrue
+        */
+        bool useminimage() const
+        {
+            return ncp_ == 0;
+        }
 
-    // #region publicメンバ関数
+        //! A private member function (constant).
+        /*!
+            SIMD命令を用いて力を計算するかどうか
+            \return SIMD命令を使用でき、かつ最も近いイメージとだけ相互作用するならtrue
+        */
+        bool usesimd() const
+        {
+            return ljkernel_.simdtype() != SimdType::Scalar &&
+                pairpotential_.type() != PairPotentialType::Spline &&
+                (useverletlist() || uselinkedcell() || useminimage());
+        }
 
-    template <typename T>
-    void Ar_moleculardynamics<T>::Calc_Forces(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::NoParallel)>)
-    {
-        // 各原子に働く力の初期化
-        for (auto n = 0; n < NumAtom_; n++) {
-            F_[n][0] = static_cast<T>(0);
-            F_[n][1] = static_cast<T>(0);
-            F_[n][2] = static_cast<T>(0);
+        //! A private member function (constant).
+        /*!
+            複数のOpenCLデバイスで原子を分割して計算するかどうか
+            （セルリスト法はデバイス上で原子を並べ替えるので、最初のデバイスだけで計算する）
+            \return 複数のデバイスを使い、かつセルリスト法を使用しないならtrue
+        */
+        bool usemultidevice() const
+        {
+            return slabs_.size() > 1 && !uselinkedcell();
         }
 
-        // ポテンシャルエネルギーの初期化
-        Up_ = 0.0;
+        //! A private member function (constant).
+        /*!
+            セルリスト法を使用するかどうか
+            \return セルリスト法を使用するならtrue
+        */
+        bool uselinkedcell() const
+        {
+            return neighborsearchtype_ == NeighborSearchType::LinkedCell && linkedcell_.usable();
+        }
 
-        for (auto n = 0; n < NumAtom_; n++) {
-            for (auto m = 0; m < NumAtom_; m++) {
+        //! A private member function (constant).
+        /*!
+            近接リストを使用するかどうか
+            \return 近接リストを使用するならtrue
+        */
+        bool useverletlist() const
+        {
+            return neighborsearchtype_ == NeighborSearchType::VerletList && VerletList<T>::usable(periodiclen_, rc_ + skin_);
+        }
 
-                // ±ncp_分のセル内の原子との相互作用を計算
-                for (auto i = -ncp_; i <= ncp_; i++) {
-                    for (auto j = -ncp_; j <= ncp_; j++) {
-                        for (auto k = -ncp_; k <= ncp_; k++) {
-                            auto const sx = static_cast<T>(i) * periodiclen_;
-                            auto const sy = static_cast<T>(j) * periodiclen_;
-                            auto const sz = static_cast<T>(k) * periodiclen_;
+        // #endregion privateメンバ関数
 
-                            // 自分自身との相互作用を排除
-                            if (n != m || i != 0 || j != 0 || k != 0) {
-                                auto const dx = r_[n][0] - (r_[m][0] + sx);
-                                auto const dy = r_[n][1] - (r_[m][1] + sy);
-                                auto const dz = r_[n][2] - (r_[m][2] + sz);
+        // #region メンバ変数
 
-                                auto const r2 = norm2(dx, dy, dz);
-                                // 打ち切り距離内であれば計算
-                                if (r2 <= rc2_) {
-                                    auto const r = std::sqrt(r2);
-                                    auto const rm6 = 1.0 / (r2 * r2 * r2);
-                                    auto const rm7 = rm6 / r;
-                                    auto const rm12 = rm6 * rm6;
-                                    auto const rm13 = rm12 / r;
+    public:
+        //! A private member variable (constant).
+        /*!
+            初期のスーパーセルの個数（setNc()で変更できる）
+        */
+        static auto constexpr FIRSTNC = 8;
 
-                                    auto const Fr = 48.0 * rm13 - 24.0 * rm7;
+        //! A private member variable (constant).
+        /*!
+            初期の格子定数のスケール
+        */
+        static T const FIRSTSCALE;
 
-                                    F_[n][0] += dx / r * Fr;
-                                    F_[n][1] += dy / r * Fr;
-                                    F_[n][2] += dz / r * Fr;
+        //! A private member variable (constant).
+        /*!
+            初期温度（絶対温度）
+        */
+        static T const FIRSTTEMP;
 
-                                    // エネルギーの計算、ただし二重計算のために0.5をかけておく
-                                    Up_ += 0.5 * (4.0 * (rm12 - rm6) - Vrc_);
-                                }
-                            }
-                        }
-                    }
-                }
-            }
-        }
-    }
+        //! A public member variable (constant).
+        /*!
+            近接リストのスキンの厚さの初期値
+        */
+        static T const FIRSTSKIN;
+
+    private:
+        //! A private member variable (constant).
+        /*!
+            Woodcockの温度スケーリングの係数
+        */
+        static T const ALPHA;
+
+        //! A private member variable (constant).
+        /*!
+            時間刻みΔt
+        */
+        static T const DT;
+        
+        //! A private member variable (constant).
+        /*!
+            ボルツマン定数
+        */
+        static T const KB;
+        
+        //! A private member variable (constant).
+        /*!
+            既定のローカルワークサイズ（自動調整で試す最大の大きさ）
+        */
+        static auto constexpr LOCALWORKSIZE = 256;
+
+        //! A private member variable (constant).
+        /*!
+            自動調整で試す最小のローカルワークサイズ
+        */
+        static auto constexpr MINLOCALWORKSIZE = 32;
+
+        //! A private member variable (constant).
+        /*!
+            力を計算するカーネルの種類ごとの名前
+        */
+        static std::array<std::string, 4> const FORCEKERNELNAME;
+
+        //! A private member variable (constant).
+        /*!
+            TBBとOpenCLとで同時に計算する場合に、原子の分け方を決め直す間隔（MDのステップ数）
+        */
+        static auto constexpr HYBRIDREBALANCEINTERVAL = 10;
+
+        //! A private member variable (constant).
+        /*!
+            TBBのフローグラフで解析を行う場合に、動径分布関数を求めるステップの間隔
+        */
+        static auto constexpr ANALYSISINTERVAL = 10;
+
+        //! A private member variable (constant).
+        /*!
+            TBBのフローグラフで時間発展させた場合の結果を出力するファイル名
+        */
+        static std::string const FLOWGRAPHRESULTFILENAME;
+
+        //! A private member variable (constant).
+        /*!
+            TBBとOpenCLとで同時に計算した場合の結果を出力するファイル名
+        */
+        static std::string const HYBRIDRESULTFILENAME;
+
+        //! A private member variable (constant).
+        /*!
+            TBBとOpenCLとで同時に計算した場合の、原子の分け方の記録を出力するファイル名
+        */
+        static std::string const HYBRIDSPLITFILENAME;
+
+        //! A private member variable (constant).
+        /*!
+            MPIで並列化した場合の結果を出力するファイル名
+        */
+        static std::string const MPIRESULTFILENAME;
+
+        //! A private member variable (constant).
+        /*!
+            OpenCLで並列化した場合の結果を出力するファイル名
+        */
+        static std::string const OPENCLRESULTFILENAME;
+
+        //! A private member variable (constant).
+        /*!
+            動径分布関数を出力するファイル名
+        */
+        static std::string const RDFFILENAME;
+        
+        //! A private member variable (constant).
+        /*!
+            並列化無しの場合の結果を出力するファイル名
+        */
+        static std::string const RESULTFILENAME;
+
+        //! A private member variable (constant).
+        /*!
+            TBBで並列化した場合の結果を出力するファイル名
+        */
+        static std::string const TBBRESULTFILENAME;
+
+        //! A private member variable (constant).
+        /*!
+            アルゴン原子に対するε
+        */
+        static T const YPSILON;
+
+        //! A private member variable (constant).
+        /*!
+            時間刻みの二乗
+        */
+        T const dt2;
+
+        //! A private member variable.
+        /*!
+            使用する全てのOpenCLデバイス
+        */
+        std::vector<compute::device> devices_;
+
+        //! A private member variable.
+        /*!
+            OpenCLデバイス（複数のデバイスを使う場合は最初のデバイス）
+        */
+        compute::device device_;
+
+        //! A private member variable.
+        /*!
+            OpenCL context
+        */
+        compute::context context_;
+
+        //! A private member variable.
+        /*!
+            OpenCLのプログラムのキャッシュ
+        */
+        ProgramCache programcache_;
+
+        //! A private member variable.
+        /*!
+            複数のOpenCLデバイスを使う場合の、デバイスごとに受け持つ原子の範囲とキュー・配列・カーネル（一つなら空）
+        */
+        std::vector<DeviceSlab<real_type>> slabs_;
+
+        //! A private member variable.
+        /*!
+            デバイスごとの配列の座標・速度・力が最新の値かどうか
+        */
+        bool slabcurrent_ = false;
+
+        //! A private member variable.
+        /*!
+            デバイスの間で座標を交換した量（バイト）
+        */
+        std::int64_t exchangebytes_ = 0;
+
+        //! A private member variable.
+        /*!
+            OpenCLのカーネルを-cl-fast-relaxed-mathでビルドするかどうか
+        */
+        bool fastmath_ = false;
+
+        //! A private member variable.
+        /*!
+            現在のカーネルをビルドしたときのビルドオプション
+        */
+        std::string kerneloptions_;
+
+        //! A private member variable.
+        /*!
+            力を計算するカーネルの種類ごとのワークグループの大きさ
+        */
+        std::array<std::int32_t, 4> forceworksize_ = { {
+            Ar_moleculardynamics::LOCALWORKSIZE,
+            Ar_moleculardynamics::LOCALWORKSIZE,
+            Ar_moleculardynamics::LOCALWORKSIZE,
+            Ar_moleculardynamics::LOCALWORKSIZE } };
+
+        //! A private member variable.
+        /*!
+            時間発展など、力を計算するカーネル以外のワークグループの大きさ
+        */
+        std::int32_t moveworksize_ = Ar_moleculardynamics::LOCALWORKSIZE;
+
+        //! A private member variable.
+        /*!
+            最後に投入した力を計算するカーネルのワークグループの個数
+        */
+        std::int32_t forcegroups_ = 0;
+
+        //! A private member variable.
+        /*!
+            自動調整の結果（カーネルの名前、ワークグループの大きさ、1回あたりの時間）
+        */
+        std::vector<std::tuple<std::string, std::int32_t, double>> autotuneresults_;
+
+        //! A private member variable.
+        /*!
+            ワークグループの大きさを自動調整したか、ディスクから読み込んだかどうか
+        */
+        bool autotuned_ = false;
+
+        //! A private member variable.
+        /*!
+            セルの番号順に並べたn個目の原子が属するセルの番号（デバイス側）
+        */
+        compute::vector<std::int32_t> atomcell_dev_;
+
+        //! A private member variable.
+        /*!
+            デバイス側の座標・速度・力をセルの番号順に並べ替えているかどうか
+        */
+        bool binned_ = false;
+
+        //! A private member variable.
+        /*!
+            デバイス側の座標・速度・力が最新の値かどうか
+        */
+        bool devicecurrent_ = false;
+
+        //! A private member variable.
+        /*!
+            OpenCLで計算する場合に、座標・速度・力をデバイス側に置いたままにするかどうか
+        */
+        bool deviceresident_ = true;
+
+        //! A private member variable.
+        /*!
+            デバイス→ホストの転送量（バイト）
+        */
+        std::int64_t downloadbytes_ = 0;
+
+        //! A private member variable.
+        /*!
+            ホスト側の座標・速度・力が最新の値かどうか
+        */
+        bool hostcurrent_ = true;
+
+        //! A private member variable.
+        /*!
+            OpenCLで計算したMDのステップ数
+        */
+        std::int32_t openclsteps_ = 0;
+
+        //! A private member variable.
+        /*!
+            ワークグループごとの部分和（デバイス側、ポテンシャルエネルギー・ビリアル・運動エネルギー・変位の二乗の最大値の順に並べる）
+        */
+        compute::vector<real_type> partial_dev_;
+
+        //! A private member variable.
+        /*!
+            ワークグループごとの部分和（ホスト側）
+        */
+        std::vector<real_type> partial_;
+
+        //! A private member variable.
+        /*!
+            デバイス側の運動エネルギーの部分和が、現在の速度に対応しているかどうか
+        */
+        bool ukcurrent_ = false;
+
+        //! A private member variable.
+        /*!
+            力のカーネルが求めたポテンシャルエネルギーとビリアルの部分和を、まだ読み込んでいないかどうか
+        */
+        bool forcepartialpending_ = false;
+
+        //! A private member variable.
+        /*!
+            原子の最大変位の部分和を非同期に読み込んでいるかどうか
+        */
+        bool disp2pending_ = false;
+
+        //! A private member variable.
+        /*!
+            原子の最大変位の部分和を読み込むイベント
+        */
+        compute::event disp2event_;
+
+        //! A private member variable.
+        /*!
+            直前に投入したカーネルのイベント
+        */
+        compute::event lastevent_;
+
+        //! A private member variable.
+        /*!
+            OpenCLで計算する場合に、ホスト側がデバイス側の結果を待った時間の合計
+        */
+        double hostwaittime_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            最後に計算したビリアル（どの方法で力を計算したかによらない）
+        */
+        real_type virial_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            ホスト→デバイスの転送量（バイト）
+        */
+        std::int64_t uploadbytes_ = 0;
+
+        //! A private member variable.
+        /*!
+            各セルに属する原子の個数（デバイス側）
+        */
+        compute::vector<std::int32_t> cellcount_dev_;
+
+        //! A private member variable.
+        /*!
+            各セルの先頭の位置（デバイス側）
+        */
+        compute::vector<std::int32_t> cellstart_dev_;
+
+        //! A private member variable.
+        /*!
+            TBBで並列化した場合の、スレッドごとの各原子に働く力
+        */
+        tbb::enumerable_thread_specific<ParticleStore<real_type>> Flocal_;
+
+        //! A private member variable.
+        /*!
+            TBBで並列化した場合に、Newtonの第三法則を用いて各原子の組を一度だけ計算するかどうか
+        */
+        bool halfpair_ = false;
+
+        //! A private member variable.
+        /*!
+            Newtonの第三法則を用いた場合の、力の計算にかかった時間の合計（秒）
+        */
+        double halfpairforcetime_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            Newtonの第三法則を用いた場合の、スレッドごとの力の足し合わせにかかった時間の合計（秒）
+        */
+        double halfpairreductiontime_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            Newtonの第三法則を用いて力を計算したMDのステップ数
+        */
+        std::int32_t halfpairsteps_ = 0;
+
+        //! A private member variable.
+        /*!
+            格子定数
+        */
+        T lat_;
+
+        //! A private member variable.
+        /*!
+            セルリスト
+        */
+        LinkedCell<T> linkedcell_;
+
+        //! A private member variable.
+        /*!
+            SIMD命令を用いて原子と近接原子との間に働く力を計算するオブジェクト
+        */
+        LJKernel<T> ljkernel_;
+
+        //! A private member variable.
+        /*!
+            スーパーセルの個数
+        */
+        std::int32_t Nc_ = Ar_moleculardynamics::FIRSTNC;
+
+        //! A private member variable.
+        /*!
+            n個目の原子に働く力
+        */
+        ParticleStore<real_type> F_;
+        
+        //! A private member variable.
+        /*!
+            n個目の原子に働く力（デバイス側）
+        */
+        compute::vector<particle_type> F_dev_;
+
+        //! A private member variable.
+        /*!
+            ホスト側の力が、TBBの時間発展で次のステップのために既にゼロになっているかどうか
+        */
+        bool forcecleared_ = false;
+
+        //! A private member variable.
+        /*!
+            TBBのフローグラフで時間発展させた場合の結果出力用のファイルストリーム
+        */
+        std::ofstream flowgraphofs_;
+
+        //! A private member variable.
+        /*!
+            TBBのフローグラフで、解析のノードが動径分布関数を求めるのにかかった時間の合計
+        */
+        double flowgraphanalysistime_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            TBBのフローグラフで、最後のステップの時間発展が終わってから出力と解析が終わるまで待った時間の合計
+        */
+        double flowgraphdraintime_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            TBBのフローグラフで、出力のノードがエネルギーを出力するのにかかった時間の合計
+        */
+        double flowgraphoutputtime_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            TBBのフローグラフで時間発展させたステップ数の合計
+        */
+        std::int32_t flowgraphsteps_ = 0;
+
+        //! A private member variable.
+        /*!
+            TBBのフローグラフで時間発展させるのにかかった時間の合計（出力と解析を待つ時間を含む）
+        */
+        double flowgraphtime_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            TBBとOpenCLとで同時に計算した場合の結果出力用のファイルストリーム
+        */
+        std::ofstream hybridofs_;
+
+        //! A private member variable.
+        /*!
+            TBBとOpenCLとで同時に計算した場合の、原子の分け方の記録用のファイルストリーム
+        */
+        std::ofstream hybridsplitofs_;
+
+        //! A private member variable.
+        /*!
+            TBBとOpenCLとで同時に計算する場合に、OpenCLで受け持つ原子の割合
+        */
+        double hybridratio_ = 0.5;
+
+        //! A private member variable.
+        /*!
+            原子の分け方を決め直してからの、TBBとOpenCLとで受け持った原子数の合計
+        */
+        std::array<std::int64_t, 2> hybridatoms_ = { { 0, 0 } };
+
+        //! A private member variable.
+        /*!
+            原子の分け方を決め直してからの、TBBとOpenCLとで力の計算にかかった時間の合計（秒）
+        */
+        std::array<double, 2> hybridtime_ = { { 0.0, 0.0 } };
+
+        //! A private member variable.
+        /*!
+            TBBとOpenCLとで力の計算にかかった時間の、全てのステップでの合計（秒）
+        */
+        std::array<double, 2> hybridtotaltime_ = { { 0.0, 0.0 } };
+
+        //! A private member variable.
+        /*!
+            原子の分け方を決め直してからのMDのステップ数
+        */
+        std::int32_t hybridwindow_ = 0;
+
+        //! A private member variable.
+        /*!
+            TBBとOpenCLとで同時に力を計算したMDのステップ数
+        */
+        std::int32_t hybridsteps_ = 0;
+
+        //! A private member variable.
+        /*!
+            原子の分け方を決め直した回数
+        */
+        std::int32_t hybridrebalances_ = 0;
+
+        //! A private member variable.
+        /*!
+            デバイスに転送した近接リストを、ホスト側で何回目に構築したものか
+        */
+        std::int32_t hybridlistbuild_ = -1;
+
+        //! A private member variable.
+        /*!
+            グローバルメモリから直接読み込むカーネルの、一回あたりの実行時間（秒）
+        */
+        double forcebenchmarkglobaltime_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            二つのカーネルで計算した力の差の最大値
+        */
+        double forcebenchmarkmaxdiff_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            カーネルを比較したときの実行回数（0なら未実行）
+        */
+        std::int32_t forcebenchmarkrepeat_ = 0;
+
+        //! A private member variable.
+        /*!
+            ローカルメモリでタイル化したカーネルの、一回あたりの実行時間（秒）
+        */
+        double forcebenchmarktiledtime_ = 0.0;
+        
+        //! A private member variable.
+        /*!
+            周期境界条件をチェックするカーネル
+        */
+        compute::kernel kernel_check_periodic_;
+
+        //! A private member variable.
+        /*!
+            近接リストを構築した時点からの変位を計算するカーネル
+        */
+        compute::kernel kernel_displacement_;
+
+        //! A private member variable.
+        /*!
+            各原子に働く力を計算するカーネル
+        */
+        compute::kernel kernel_force_;
+
+        //! A private member variable.
+        /*!
+            運動エネルギーのワークグループごとの部分和を求めるカーネル
+        */
+        compute::kernel kernel_kinetic_;
+
+        //! A private member variable.
+        /*!
+            各原子が属するセルを求めるカーネル
+        */
+        compute::kernel kernel_cellindex_;
+
+        //! A private member variable.
+        /*!
+            セルリストを用いて各原子に働く力を計算するカーネル
+        */
+        compute::kernel kernel_force_linkedcell_;
+
+        //! A private member variable.
+        /*!
+            原子の座標をローカルメモリにタイル単位で読み込んで、各原子に働く力を計算するカーネル
+        */
+        compute::kernel kernel_force_tiled_;
+
+        //! A private member variable.
+        /*!
+            近接リストを用いて各原子に働く力を計算するカーネル
+        */
+        compute::kernel kernel_force_verletlist_;
+
+        //! A private member variable.
+        /*!
+            Verlet法で時間発展するカーネル
+        */
+        compute::kernel kernel_move_atoms_;
+        
+        //! A private member variable.
+        /*!
+            修正Euler法で時間発展するカーネル
+        */
+        compute::kernel kernel_move_atoms1_;
+
+        //! A private member variable.
+        /*!
+            MDのステップ数
+        */
+        std::int32_t MD_iter_;
+
+        //! A private member variable.
+        /*!
+            相互作用を計算するセルの個数（最も近いイメージから数えて±ncp_個）
+        */
+        std::int32_t ncp_;
+
+        //! A private member variable.
+        /*!
+            各セルに隣接する27個のセルの番号（デバイス側）
+        */
+        compute::vector<std::int32_t> neighborcell_dev_;
+
+        //! A private member variable.
+        /*!
+            SIMD命令を用いて力を計算する場合の、スレッドごとの近接原子を詰め込む配列
+        */
+        tbb::enumerable_thread_specific<NeighborPack<T>> neighborpack_;
+
+        //! A private member variable.
+        /*!
+            並べ替えのための作業用の配列（デバイス側）
+        */
+        compute::vector<particle_type> particletmp_dev_;
+
+        //! A private member variable.
+        /*!
+            セルの番号順に並べたn個目の原子の、元の原子の番号（デバイス側）
+        */
+        compute::vector<std::int32_t> perm_dev_;
+
+        //! A private member variable.
+        /*!
+            元の原子の番号がn番の原子の、セルの番号順に並べたときの位置（デバイス側）
+        */
+        compute::vector<std::int32_t> perminv_dev_;
+
+        //! A private member variable.
+        /*!
+            元の原子の番号を並べ替えるための作業用の配列（デバイス側）
+        */
+        compute::vector<std::int32_t> permtmp_dev_;
+
+        //! A private member variable.
+        /*!
+            近接リストに含まれる原子の番号（デバイス側）
+        */
+        compute::vector<std::int32_t> neighbor_dev_;
+
+        //! A private member variable.
+        /*!
+            各原子の近接リストの先頭の位置（デバイス側）
+        */
+        compute::vector<std::int32_t> neighborstart_dev_;
+
+        //! A private member variable.
+        /*!
+            相互作用する原子の組を探索する手法
+        */
+        NeighborSearchType neighborsearchtype_ = NeighborSearchType::VerletList;
+
+        //! A private member variable.
+        /*!
+            原子数
+        */
+        std::int32_t NumAtom_;
+        
+        //! A private member variable.
+        /*!
+            並列化無しの場合の結果出力用のファイルストリーム
+        */
+        std::ofstream ofs_;
+
+        //! A private member variable.
+        /*!
+            OpenCLで並列化した場合の結果出力用のファイルストリーム
+        */
+        std::ofstream openclofs_;
+
+#ifdef USE_MPI
+        //! A private member variable.
+        /*!
+            MPIで並列化した場合の結果出力用のファイルストリーム（最初のプロセスだけが開く）
+        */
+        std::ofstream mpiofs_;
+
+        //! A private member variable.
+        /*!
+            MPIで箱を空間分割し、このプロセスが受け持つ原子とゴースト原子を管理するオブジェクト
+        */
+        MpiDomain<real_type> mpidomain_;
+
+        //! A private member variable.
+        /*!
+            MPIの各プロセスが受け持つ原子の座標・速度・力が最新の値かどうか
+        */
+        bool mpicurrent_ = false;
+#endif
+
+        //! A private member variable.
+        /*!
+            Lennard-Jonesポテンシャルと力を求めるオブジェクト
+        */
+        PairPotential<T> pairpotential_;
+
+        //! A private member variable.
+        /*!
+            スプライン補間の表（デバイス側）
+        */
+        compute::vector<pair4_type> pairtable_dev_;
+
+        //! A private member variable.
+        /*!
+            周期境界条件の長さ
+        */
+        real_type periodiclen_;
+        
+        //! A private member variable.
+        /*!
+            OpenCLのキュー
+        */
+        compute::command_queue queue_;
+
+        //! A private member variable.
+        /*!
+            TBBのフローグラフの解析のノードで求める動径分布関数
+        */
+        RadialDistribution<real_type> radialdistribution_;
+
+        //! A private member variable.
+        /*!
+            n個目の原子の座標
+        */
+        ParticleStore<real_type> r_;
+
+        //! A private member variable.
+        /*!
+            n個目の原子の座標の複製
+        */
+        ParticleStore<real_type> r_clone_;
+
+        //! A private member variable.
+        /*!
+            n個目の原子の座標（デバイス側）
+        */
+        compute::vector<particle_type> r_dev_;
+
+        //! A private member variable.
+        /*!
+            n個目の原子の初期座標
+        */
+        ParticleStore<real_type> r1_;
+
+        //! A private member variable.
+        /*!
+            n個目の原子の初期座標（デバイス側）
+        */
+        compute::vector<particle_type> r1_dev_;
+
+        //! A private member variable.
+        /*!
+            近接リストを再構築する必要があるかどうか
+        */
+        bool rebuildverletlist_ = true;
+
+        //! A private member variable.
+        /*!
+            近接リストを構築したときの原子の座標（デバイス側）
+        */
+        compute::vector<particle_type> rref_dev_;
+        
+        //! A private member variable (constant).
+        /*!
+            カットオフ半径
+        */
+        T const rc_ = 2.5;
+
+        //! A private member variable (constant).
+        /*!
+            カットオフ半径の2乗
+        */
+        T const rc2_;
+
+        //! A private member variable (constant).
+        /*!
+            カットオフ半径の逆数の6乗
+        */
+        T const rcm6_;
+
+        //! A private member variable (constant).
+        /*!
+            カットオフ半径の逆数の12乗
+        */
+        T const rcm12_;
+
+        //! A private member variable.
+        /*!
+            格子定数のスケーリングの定数
+        */
+        T scale_ = Ar_moleculardynamics::FIRSTSCALE;
+
+        //! A private member variable.
+        /*!
+            近接リストのスキンの厚さ
+        */
+        T skin_ = Ar_moleculardynamics::FIRSTSKIN;
+
+        //! A private member variable.
+        /*!
+            セルの番号順に並べ替えたときの、新しい順番から古い順番への対応（デバイス側）
+        */
+        compute::vector<std::int32_t> sortindex_dev_;
+
+        //! A private member variable.
+        /*!
+            TBBで並列化した場合に、NUMAノードとキャッシュの親和性を保つオブジェクト
+        */
+        TbbAffinity tbbaffinity_;
+
+        //! A private member variable.
+        /*!
+            原子の配列をNUMAノードごとに置き直すのにかかった時間の合計
+        */
+        double tbbfirsttouchtime_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            TBBで並列化した場合の結果出力用のファイルストリーム
+        */
+        std::ofstream tbbofs_;
+
+        //! A private member variable.
+        /*!
+            OpenCLで全ての原子の組を計算する場合に、ローカルメモリでタイル化したカーネルを用いるかどうか
+        */
+        bool tiledforce_ = true;
+
+        //! A private member variable.
+        /*!
+            温度のスケーリングに用いる運動エネルギーの求め方
+        */
+        ThermostatType thermostattype_ = ThermostatType::Exact;
+
+        //! A private member variable.
+        /*!
+            Exactで計算したときの、各ステップの全エネルギー（Laggedとの比較用）
+        */
+        std::vector<double> exacttrace_;
+
+        //! A private member variable.
+        /*!
+            Laggedで計算したステップ数
+        */
+        std::int32_t laggedsteps_ = 0;
+
+        //! A private member variable.
+        /*!
+            Laggedで計算したステップのうち、Exactの全エネルギーと比較したステップ数
+        */
+        std::int32_t laggedcompared_ = 0;
+
+        //! A private member variable.
+        /*!
+            Laggedで計算した全エネルギーと、Exactで計算した全エネルギーとの差の絶対値の最大値
+        */
+        double laggedmaxenergydiff_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            Laggedで用いた温度のスケーリングの係数と、正確な係数との差の絶対値の最大値
+        */
+        double laggedmaxscalediff_ = 0.0;
+        
+        //! A private member variable.
+        /*!
+            計算された温度Tcalc
+        */
+        real_type Tc_;
+
+        //! A private member variable.
+        /*!
+            与える温度Tgiven
+        */
+        T Tg_;
+        
+        //! A private member variable.
+        /*!
+            運動エネルギー
+        */
+        real_type Uk_;
+
+        //! A private member variable.
+        /*!
+            ポテンシャルエネルギー
+        */
+        real_type Up_;
+
+        //! A private member variable.
+        /*!
+            全エネルギー
+        */
+        real_type Utot_;
+        
+        //! A private member variable.
+        /*!
+            n個目の原子の速度
+        */
+        ParticleStore<real_type> V_;
+
+        //! A private member variable.
+        /*!
+            n個目の原子の速度（複製用）
+        */
+        ParticleStore<real_type> V_clone_;
+
+        //! A private member variable.
+        /*!
+            n個目の原子の速度（デバイス側）
+        */
+        compute::vector<particle_type> V_dev_;
+
+        //! A private member variable (constant).
+        /*!
+            ポテンシャルエネルギーの打ち切り
+        */
+        T const Vrc_;
+
+        //! A private member variable.
+        /*!
+            近接リスト
+        */
+        VerletList<T> verletlist_;
+        
+        // #endregion メンバ変数
+
+        // #region 禁止されたコンストラクタ・メンバ関数
+
+        //! A private copy constructor (deleted).
+        /*!
+            コピーコンストラクタ（禁止）
+        */
+        Ar_moleculardynamics(Ar_moleculardynamics const &) = delete;
+
+        //! A private member function (deleted).
+        /*!
+            operator=()の宣言（禁止）
+            \param コピー元のオブジェクト（未使用）
+            \return コピー元のオブジェクト
+        */
+        Ar_moleculardynamics & operator=(Ar_moleculardynamics const &) = delete;
+
+        // #endregion 禁止されたコンストラクタ・メンバ関数
+    };
+
+    // #region static private 定数
+
+    template <typename T>
+    T const Ar_moleculardynamics<T>::ALPHA = 0.2;
+    
+    template <typename T>
+    T const Ar_moleculardynamics<T>::DT = 0.001;
+
+    template <typename T>
+    T const Ar_moleculardynamics<T>::FIRSTSCALE = 1.0;
+    
+    template <typename T>
+    T const Ar_moleculardynamics<T>::FIRSTSKIN = 0.3;
+
+    template <typename T>
+    T const Ar_moleculardynamics<T>::FIRSTTEMP = 1.0;
+
+    template <typename T>
+    T const Ar_moleculardynamics<T>::KB = 1.3806488E-23;
+
+    template <typename T>
+    std::array<std::string, 4> const Ar_moleculardynamics<T>::FORCEKERNELNAME = { { "force", "force_tiled", "force_linkedcell", "force_verletlist" } };
+
+    template <typename T>
+    std::string const Ar_moleculardynamics<T>::FLOWGRAPHRESULTFILENAME = "flowgraph_result.txt";
+
+    template <typename T>
+    std::string const Ar_moleculardynamics<T>::HYBRIDRESULTFILENAME = "hybrid_result.txt";
+
+    template <typename T>
+    std::string const Ar_moleculardynamics<T>::HYBRIDSPLITFILENAME = "hybrid_split.txt";
+
+    template <typename T>
+    std::string const Ar_moleculardynamics<T>::MPIRESULTFILENAME = "mpi_result.txt";
+
+    template <typename T>
+    std::string const Ar_moleculardynamics<T>::OPENCLRESULTFILENAME = "opencl_result.txt";
+
+    template <typename T>
+    std::string const Ar_moleculardynamics<T>::RDFFILENAME = "rdf.txt";
+
+    template <typename T>
+    std::string const Ar_moleculardynamics<T>::RESULTFILENAME = "result.txt";
+
+    template <typename T>
+    std::string const Ar_moleculardynamics<T>::TBBRESULTFILENAME = "tbb_result.txt";
+
+    template <typename T>
+    T const Ar_moleculardynamics<T>::YPSILON = 1.6540172624E-21;
+
+    // #endregion static private 定数
+
+    // #region コンストラクタ
+
+    template <typename T>
+    Ar_moleculardynamics<T>::Ar_moleculardynamics(std::string const & devicespec)
+        :
+        dt2(DT * DT),
+        devices_(DeviceSelector::select(devicespec)),
+        device_(devices_.front()),
+        context_(devices_),
+        programcache_(context_),
+        atomcell_dev_(context_),
+        partial_dev_(context_),
+        cellcount_dev_(context_),
+        cellstart_dev_(context_),
+        F_dev_(context_),
+        flowgraphofs_(ResultFileName(Ar_moleculardynamics::FLOWGRAPHRESULTFILENAME)),
+        hybridofs_(ResultFileName(Ar_moleculardynamics::HYBRIDRESULTFILENAME)),
+        hybridsplitofs_(ResultFileName(Ar_moleculardynamics::HYBRIDSPLITFILENAME)),
+        neighborcell_dev_(context_),
+        particletmp_dev_(context_),
+        perm_dev_(context_),
+        perminv_dev_(context_),
+        permtmp_dev_(context_),
+        neighbor_dev_(context_),
+        neighborstart_dev_(context_),
+        ofs_(ResultFileName(Ar_moleculardynamics::RESULTFILENAME)),
+        openclofs_(ResultFileName(Ar_moleculardynamics::OPENCLRESULTFILENAME)),
+#ifdef USE_MPI
+        mpiofs_(ResultFileName(Ar_moleculardynamics::MPIRESULTFILENAME)),
+#endif
+        pairtable_dev_(context_),
+        queue_(context_, device_),
+        rc2_(rc_ * rc_),
+        rcm6_(std::pow(rc_, -6.0)),
+        rcm12_(std::pow(rc_, -12.0)),
+        Tg_(Ar_moleculardynamics::FIRSTTEMP * Ar_moleculardynamics::KB / Ar_moleculardynamics::YPSILON),
+        r_dev_(context_),
+        r1_dev_(context_),
+        rref_dev_(context_),
+        sortindex_dev_(context_),
+        tbbofs_(ResultFileName(Ar_moleculardynamics::TBBRESULTFILENAME)),
+        V_dev_(context_),
+        Vrc_(4.0 * (rcm12_ - rcm6_))
+    {
+        // 複数のデバイスを使う場合は、デバイスごとにキューと配列を用意する（原子の分割はModLattice()で決める）
+        if (devices_.size() > 1) {
+            for (auto const & device : devices_) {
+                slabs_.emplace_back(context_, device);
+            }
+        }
+
+        ModLattice();
+
+        // CPUが対応する最も新しいSIMD命令セットを使用する
+        ljkernel_.setup(LJKernel<T>::detect(), periodiclen_, rc2_, Vrc_);
+
+        // 既定では元の式でポテンシャルを評価する
+        pairpotential_.setup(PairPotentialType::Analytic, PairPotential<T>::DEFAULTTABLESIZE, rc2_, Vrc_);
+
+        // doubleを使用する場合は、全てのデバイスが倍精度浮動小数点数に対応している必要がある
+        for (auto const & device : devices_) {
+            if (Ar_moleculardynamics::usefp64() && !device.supports_extension("cl_khr_fp64")) {
+                throw std::runtime_error("The OpenCL device does not support double precision (cl_khr_fp64).");
+            }
+        }
+
+        SetKernel();
+
+        // 以前に自動調整したワークグループの大きさがあれば、それを用いる
+        LoadTuning();
+    }
+
+    // #endregion コンストラクタ
+
+    // #region publicメンバ関数
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::autotune(std::int32_t repeat)
+    {
+        // 自動調整での転送量は統計に含めない
+        auto const downloadbytes = downloadbytes_;
+        auto const uploadbytes = uploadbytes_;
+
+        // まだ読み込んでいない部分和を読み込んでから、最新の値をホスト側に戻す
+        if (forcepartialpending_) {
+            ReadPartials(false);
+        }
+        UseHostState();
+
+        // 元の原子の番号順のまま、全てデバイス側に転送し直す
+        binned_ = false;
+        UseDeviceState();
+
+        UpdateKernel();
+
+        autotuneresults_.clear();
+
+        // 時間発展のカーネルは座標と速度を書き換えるので、退避しておいて元に戻す
+        compute::vector<particle_type> const r(r_dev_, queue_);
+        compute::vector<particle_type> const r1(r1_dev_, queue_);
+        compute::vector<particle_type> const V(V_dev_, queue_);
+
+        kernel_move_atoms_.set_args(
+            r_dev_,
+            r1_dev_,
+            V_dev_,
+            F_dev_,
+            static_cast<real_type>(Ar_moleculardynamics::DT),
+            static_cast<real_type>(1),
+            partial_dev_);
+
+        moveworksize_ = TuneKernel("move_atoms", kernel_move_atoms_, repeat, [](std::int32_t) {}).first;
+
+        compute::copy(r.begin(), r.end(), r_dev_.begin(), queue_);
+        compute::copy(r1.begin(), r1.end(), r1_dev_.begin(), queue_);
+        compute::copy(V.begin(), V.end(), V_dev_.begin(), queue_);
+
+        // 全ての原子の組を計算するカーネル（力を足し合わせるので、実行するたびに0にする）
+        auto const allpairs = TuneKernel(FORCEKERNELNAME[static_cast<std::size_t>(ForceKernelType::AllPairs)], kernel_force_, repeat, [this](std::int32_t) {
+            compute::fill(F_dev_.begin(), F_dev_.end(), particle_type(static_cast<real_type>(0)), queue_);
+        });
+        forceworksize_[static_cast<std::size_t>(ForceKernelType::AllPairs)] = allpairs.first;
+
+        // ローカルメモリでタイル化したカーネル（タイルの大きさはワークグループの大きさと同じ）
+        auto const tiled = TuneKernel(FORCEKERNELNAME[static_cast<std::size_t>(ForceKernelType::AllPairsTiled)], kernel_force_tiled_, repeat, [this](std::int32_t localworksize) {
+            kernel_force_tiled_.set_arg(3, compute::local_buffer<real4_type>(localworksize));
+        });
+        forceworksize_[static_cast<std::size_t>(ForceKernelType::AllPairsTiled)] = tiled.first;
+        kernel_force_tiled_.set_arg(3, compute::local_buffer<real4_type>(tiled.first));
+
+        // 全ての原子の組を計算する場合は、速い方のカーネルを用いる
+        tiledforce_ = tiled.second < allpairs.second;
+
+        // 近接リストを用いるカーネル（現在の座標で近接リストを構築し直す）
+        UploadVerletList();
+        forceworksize_[static_cast<std::size_t>(ForceKernelType::VerletList)] =
+            TuneKernel(FORCEKERNELNAME[static_cast<std::size_t>(ForceKernelType::VerletList)], kernel_force_verletlist_, repeat, [](std::int32_t) {}).first;
+
+        // セルリストを用いるカーネル（原子をセルの番号順に並べ替えるので最後に試す）
+        if (linkedcell_.usable()) {
+            BinAtoms();
+            forceworksize_[static_cast<std::size_t>(ForceKernelType::LinkedCell)] =
+                TuneKernel(FORCEKERNELNAME[static_cast<std::size_t>(ForceKernelType::LinkedCell)], kernel_force_linkedcell_, repeat, [](std::int32_t) {}).first;
+        }
+
+        // 力は最後に試したカーネルで現在の座標について求め直されているが、運動エネルギーの部分和は上書きされた
+        ukcurrent_ = false;
+
+        if (!deviceresident_) {
+            UseHostState();
+        }
+
+        // 次に起動したときに用いるように、ディスクに保存する（書き込めなければ保存しない）
+        std::ofstream ofs(TuningPath());
+        if (ofs) {
+            ofs << "tiledforce " << (tiledforce_ ? 1 : 0) << '\n';
+            for (auto i = 0U; i < forceworksize_.size(); i++) {
+                ofs << Ar_moleculardynamics::FORCEKERNELNAME[i] << ' ' << forceworksize_[i] << '\n';
+            }
+            ofs << "move_atoms " << moveworksize_ << std::endl;
+        }
+
+        autotuned_ = true;
+
+        downloadbytes_ = downloadbytes;
+        uploadbytes_ = uploadbytes;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::benchmarkForceKernel(std::int32_t repeat)
+    {
+        // ベンチマークでの転送量は統計に含めない
+        auto const downloadbytes = downloadbytes_;
+        auto const uploadbytes = uploadbytes_;
+
+        UpdateKernel();
+
+        // ホスト→デバイス
+        if (deviceresident_) {
+            UseDeviceState();
+        }
+        else {
+            CopyToDevice(r_, r_dev_);
+        }
+
+        // グローバルメモリから直接読み込むカーネル
+        auto const start = tbb::tick_count::now();
+        for (auto i = 0; i < repeat; i++) {
+            compute::fill(F_dev_.begin(), F_dev_.end(), particle_type(static_cast<real_type>(0)), queue_);
+
+            auto const event_force = queue_.enqueue_1d_range_kernel(
+                kernel_force_,
+                0,
+                globalworksize(),
+                forceworksize_[static_cast<std::size_t>(ForceKernelType::AllPairs)]);
+            event_force.wait();
+        }
+        auto const middle = tbb::tick_count::now();
+
+        ParticleStore<real_type> Fglobal(NumAtom_);
+        CopyFromDevice(F_dev_, Fglobal);
+
+        // ローカルメモリでタイル化したカーネル
+        auto const middle2 = tbb::tick_count::now();
+        for (auto i = 0; i < repeat; i++) {
+            auto const event_force = queue_.enqueue_1d_range_kernel(
+                kernel_force_tiled_,
+                0,
+                globalworksize(),
+                forceworksize_[static_cast<std::size_t>(ForceKernelType::AllPairsTiled)]);
+            event_force.wait();
+        }
+        auto const finish = tbb::tick_count::now();
+
+        ParticleStore<real_type> Ftiled(NumAtom_);
+        CopyFromDevice(F_dev_, Ftiled);
+
+        // 二つのカーネルの結果が一致するかどうかを確かめる
+        auto maxdiff = 0.0;
+        for (auto n = 0; n < NumAtom_; n++) {
+            for (auto i = 0; i < 3; i++) {
+                maxdiff = std::max(maxdiff, static_cast<double>(std::fabs(Fglobal[n][i] - Ftiled[n][i])));
+            }
+        }
+
+        forcebenchmarkglobaltime_ = (middle - start).seconds() / static_cast<double>(repeat);
+        forcebenchmarktiledtime_ = (finish - middle2).seconds() / static_cast<double>(repeat);
+        forcebenchmarkmaxdiff_ = maxdiff;
+        forcebenchmarkrepeat_ = repeat;
+
+        downloadbytes_ = downloadbytes;
+        uploadbytes_ = uploadbytes;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::Calc_Forces(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::NoParallel)>)
+    {
+        // OpenCLで計算した結果がデバイス側にあれば、ホスト側に戻す
+        UseHostState();
+
+        // 各原子に働く力の初期化
+        for (auto n = 0; n < NumAtom_; n++) {
+            F_[n][0] = static_cast<T>(0);
+            F_[n][1] = static_cast<T>(0);
+            F_[n][2] = static_cast<T>(0);
+        }
+
+        // 近接リストまたはセルリストを構築
+        BuildNeighborSearch();
+
+        // 各原子に働く力とポテンシャルエネルギー、ビリアルを計算
+        auto W = static_cast<real_type>(0);
+        Up_ = Calc_Forces_Range<false>(F_, 0, NumAtom_, W);
+        virial_ = W;
+        forcecleared_ = false;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::Calc_Forces(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::OpenCl)>)
+    {
+        // 複数のデバイスを使う場合は、原子を分割してそれぞれのデバイスで計算する
+        if (usemultidevice()) {
+            Calc_Forces_MultiDevice();
+            return;
+        }
+
+        // セルリスト以外では、デバイス側の配列を元の原子の番号順のまま使う
+        if (!uselinkedcell() && binned_) {
+            if (devicecurrent_) {
+                UnbinAtoms();
+            }
+            else {
+                binned_ = false;
+            }
+        }
+
+        // ホスト→デバイス（デバイス側に置いたままにする場合は、デバイス側が古いときだけ転送）
+        if (deviceresident_) {
+            UseDeviceState();
+        }
+        else {
+            CopyToDevice(r_, r_dev_);
+        }
+
+        // 前のステップで求めた原子の最大変位から、近接リストの再構築が必要かどうかを判定
+        CheckVerletListDevice();
+
+        // 系の大きさやカットオフ半径、ビルドオプションが変わっていれば、カーネルをビルドし直す
+        UpdateKernel();
+
+        // 部分和を読み込むときのために、ワークグループの個数を覚えておく
+        auto const localworksize = forceworksize_[static_cast<std::size_t>(forcekerneltype())];
+        forcegroups_ = globalworksize() / localworksize;
+
+        if (useverletlist()) {
+            // 必要であれば近接リストを再構築
+            if (rebuildverletlist_) {
+                UploadVerletList();
+            }
+
+            // 近接リストを用いて各原子に働く力とポテンシャルエネルギーを計算
+            EnqueueKernel(kernel_force_verletlist_, localworksize);
+        }
+        else if (uselinkedcell()) {
+            // デバイス上で原子をセルの番号順に並べ替えて、セルリストを構築
+            BinAtoms();
+
+            // セルリストを用いて各原子に働く力とポテンシャルエネルギーを計算
+            EnqueueKernel(kernel_force_linkedcell_, localworksize);
+        }
+        else if (tiledforce_) {
+            // 原子の座標をローカルメモリにタイル単位で読み込んで、各原子に働く力とポテンシャルエネルギーを計算
+            EnqueueKernel(kernel_force_tiled_, localworksize);
+        }
+        else {
+            compute::fill(F_dev_.begin(), F_dev_.end(), particle_type(static_cast<real_type>(0)), queue_);
+
+            //// 各原子に働く力とポテンシャルエネルギーを計算
+            EnqueueKernel(kernel_force_, localworksize);
+        }
+
+        // ポテンシャルエネルギーとビリアルの部分和は、使うときに読み込む
+        forcepartialpending_ = true;
+
+        // デバイス→ホスト
+        if (!deviceresident_) {
+            CopyFromDevice(F_dev_, F_);
+        }
+
+        forcecleared_ = false;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::Calc_Forces(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Tbb)>)
+    {
+        // OpenCLで計算した結果がデバイス側にあれば、ホスト側に戻す
+        UseHostState();
+
+        // 近接リストまたはセルリストを構築
+        BuildNeighborSearch();
+
+        // ポテンシャルエネルギーとビリアルの初期化
+        tbb::combinable<real_type> Up;
+        tbb::combinable<real_type> W;
+
+        if (halfpair_) {
+            auto const start = tbb::tick_count::now();
+
+            // 各原子の組を一度だけ計算し、スレッドごとの配列に力を加える
+            tbbaffinity_.parallel_for(
+                NumAtom_,
+                TbbAffinity::ATOMLOOP,
+                [this, &Up, &W](auto const & range) {
+                    auto & F = Flocal_.local();
+                    if (F.size() != NumAtom_) {
+                        F = ParticleStore<real_type>(NumAtom_);
+                    }
+
+                    Up.local() += Calc_Forces_Range<true>(F, range.begin(), range.end(), W.local());
+            });
+
+            auto const middle = tbb::tick_count::now();
+
+            // スレッドごとの配列に加えられた力を足し合わせ、次のステップのためにゼロに戻す
+            tbbaffinity_.parallel_for(
+                NumAtom_,
+                TbbAffinity::ATOMLOOP,
+                [this](auto const & range) {
+                    for (auto && n = range.begin(); n != range.end(); ++n) {
+                        F_[n][0] = static_cast<T>(0);
+                        F_[n][1] = static_cast<T>(0);
+                        F_[n][2] = static_cast<T>(0);
+
+                        for (auto & F : Flocal_) {
+                            if (F.size() == NumAtom_) {
+                                F_[n][0] += F[n][0];
+                                F_[n][1] += F[n][1];
+                                F_[n][2] += F[n][2];
+                                F[n][0] = static_cast<T>(0);
+                                F[n][1] = static_cast<T>(0);
+                                F[n][2] = static_cast<T>(0);
+                            }
+                        }
+                    }
+            });
+
+            auto const finish = tbb::tick_count::now();
+
+            halfpairforcetime_ += (middle - start).seconds();
+            halfpairreductiontime_ += (finish - middle).seconds();
+            halfpairsteps_++;
+        }
+        else {
+            // 各原子に働く力を初期化してから、力とポテンシャルエネルギーを計算
+            // （前のステップの時間発展で既にゼロにしていれば、初期化しない）
+            auto const clear = !forcecleared_;
+            tbbaffinity_.parallel_for(
+                NumAtom_,
+                TbbAffinity::ATOMLOOP,
+                [this, clear, &Up, &W](auto const & range) {
+                    if (clear) {
+                        for (auto && n = range.begin(); n != range.end(); ++n) {
+                            F_[n][0] = static_cast<T>(0);
+                            F_[n][1] = static_cast<T>(0);
+                            F_[n][2] = static_cast<T>(0);
+                        }
+                    }
+
+                    Up.local() += Calc_Forces_Range<false>(F_, range.begin(), range.end(), W.local());
+            });
+        }
+
+        Up_ = Up.combine(std::plus<real_type>());
+        virial_ = W.combine(std::plus<real_type>());
+        forcecleared_ = false;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::Calc_Forces(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Hybrid)>)
+    {
+        // 時間発展はホスト側で行うので、OpenCLで計算した結果がデバイス側にあれば、ホスト側に戻す
+        UseHostState();
+
+        // デバイス側の配列は古くなったので、元の原子の番号順のまま使う
+        binned_ = false;
+
+        // 系の大きさやカットオフ半径、ビルドオプションが変わっていれば、カーネルをビルドし直す
+        UpdateKernel();
+
+        // ホスト→デバイス（OpenCLで受け持つ原子についても、全ての原子の座標が必要）
+        CopyToDevice(r_, r_dev_);
+
+        if (useverletlist()) {
+            // TBBとOpenCLとで同じ近接リストを用いるので、ホスト側で構築したものがデバイス側に無ければ転送する
+            if (rebuildverletlist_ || verletlist_.getBuildCount() != hybridlistbuild_) {
+                UploadVerletList();
+                hybridlistbuild_ = verletlist_.getBuildCount();
+            }
+        }
+        else {
+            // セルリストを構築
+            BuildNeighborSearch();
+        }
+
+        // 先頭からワークグループの個数ぶんの原子をOpenCLで、残りをTBBで受け持つ
+        auto const type = hybridforcekerneltype();
+        auto const localworksize = forceworksize_[static_cast<std::size_t>(type)];
+        forcegroups_ = hybridgroups(localworksize);
+        auto const split = std::min(forcegroups_ * localworksize, NumAtom_);
+
+        // TBBの側は、ワーカースレッドでsplit番目以降の原子に働く力とポテンシャルエネルギーを計算
+        // （前のステップの時間発展で力を既にゼロにしていれば、初期化しない）
+        tbb::combinable<real_type> Up;
+        tbb::combinable<real_type> W;
+        auto cputime = 0.0;
+        auto const clear = !forcecleared_;
+        tbb::task_group cpu;
+        cpu.run([this, split, clear, &Up, &W, &cputime] {
+            auto const start = tbb::tick_count::now();
+
+            tbb::parallel_for(
+                tbb::blocked_range<std::int32_t>(split, NumAtom_),
+                [this, clear, &Up, &W](auto const & range) {
+                    if (clear) {
+                        for (auto && n = range.begin(); n != range.end(); ++n) {
+                            F_[n][0] = static_cast<T>(0);
+                            F_[n][1] = static_cast<T>(0);
+                            F_[n][2] = static_cast<T>(0);
+                        }
+                    }
+
+                    Up.local() += Calc_Forces_Range<false>(F_, range.begin(), range.end(), W.local());
+            });
+
+            cputime = (tbb::tick_count::now() - start).seconds();
+        });
+
+        // OpenCLの側は、このスレッドでカーネルを投入し、split番目より前の原子に働く力を読み込むまで待つ
+        auto const start = tbb::tick_count::now();
+        Up_ = static_cast<real_type>(0);
+        virial_ = static_cast<real_type>(0);
+
+        if (forcegroups_ > 0) {
+            auto const globalsize = forcegroups_ * localworksize;
+
+            if (type == ForceKernelType::VerletList) {
+                EnqueueKernel(kernel_force_verletlist_, localworksize, globalsize);
+            }
+            else if (type == ForceKernelType::AllPairsTiled) {
+                EnqueueKernel(kernel_force_tiled_, localworksize, globalsize);
+            }
+            else {
+                compute::fill(F_dev_.begin(), F_dev_.end(), particle_type(static_cast<real_type>(0)), queue_);
+                EnqueueKernel(kernel_force_, localworksize, globalsize);
+            }
+
+            forcepartialpending_ = true;
+            auto const event = EnqueueReadPartials(false);
+
+            // デバイス→ホスト（OpenCLで受け持った原子の分だけ）
+            F_.copy_from_device(F_dev_, queue_, 0, split);
+            downloadbytes_ += static_cast<std::int64_t>(split) * ParticleStore<real_type>::DEVICEBYTES;
+
+            FinishReadPartials(event, false);
+        }
+
+        auto const devicetime = (tbb::tick_count::now() - start).seconds();
+
+        // TBBの側の完了を待ち、ポテンシャルエネルギーを足し合わせる
+        cpu.wait();
+        Up_ += Up.combine(std::plus<real_type>());
+        virial_ += W.combine(std::plus<real_type>());
+        forcecleared_ = false;
+
+        RebalanceHybrid(split, cputime, devicetime);
+    }
+
+#ifdef USE_MPI
+    template <typename T>
+    void Ar_moleculardynamics<T>::Calc_Forces(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Mpi)>)
+    {
+        // 初めてMPIで計算するときは、各プロセスが受け持つ原子を選ぶ
+        UseMpiState();
+
+        // 隣の部分領域とゴースト原子を交換
+        mpidomain_.exchangeGhosts();
+
+        auto & r = mpidomain_.r();
+        auto & F = mpidomain_.F();
+
+        // ポテンシャルエネルギーとビリアルの初期化
+        auto Up = static_cast<real_type>(0);
+        auto W = static_cast<real_type>(0);
+
+        // 受け持つ原子に働く力とポテンシャルエネルギー、ビリアルを計算
+        // （ゴースト原子は周期境界条件のイメージの座標を持っているので、座標の差をそのまま用いる）
+        for (auto n = 0; n < mpidomain_.nlocal(); n++) {
+            F[n][0] = static_cast<T>(0);
+            F[n][1] = static_cast<T>(0);
+            F[n][2] = static_cast<T>(0);
+
+            // 原子ごとに足し合わせてから加える（セルの順に全ての組を一つの変数に足すと、丸め誤差が大きくなる）
+            auto Upn = static_cast<real_type>(0);
+            auto Wn = static_cast<real_type>(0);
+            mpidomain_.forEachNeighbor(n, [this, n, &r, &F, &Upn, &Wn](std::int32_t m) {
+                auto const dx = static_cast<T>(r[n][0] - r[m][0]);
+                auto const dy = static_cast<T>(r[n][1] - r[m][1]);
+                auto const dz = static_cast<T>(r[n][2] - r[m][2]);
+
+                auto const r2 = norm2(dx, dy, dz);
+                // 打ち切り距離内であれば計算
+                if (r2 <= rc2_) {
+                    Upn += Calc_Force_Pair<false>(F, n, m, dx, dy, dz, r2, Wn);
+                }
+            });
+
+            Up += Upn;
+            W += Wn;
+        }
+
+        // 全てのプロセスのポテンシャルエネルギーとビリアルを足し合わせる
+        Up_ = mpidomain_.sum(Up);
+        virial_ = mpidomain_.sum(W);
+    }
+#endif
+    
+    template <typename T>
+    void Ar_moleculardynamics<T>::getinfo() const
+    {
+        // OpenCLプラットフォーム及びデバイスの情報を表示する
+        // 参考：https://bitbucket.org/aokomoriuta/simd/src/4d86663bf1c4d7d30d5441feca83115e1c7dcaf3/ocl/ocl/ocl.cpp?fileviewer=file-view-default
+        // by 青子守歌様
+
+        std::cout << "== Platform : " << device_.platform().name() << " ==\n";
+        std::cout <<
+        	"Name    : " << device_.platform().get_info<CL_PLATFORM_NAME>() << '\n' <<
+        	"Vendor  : " << device_.platform().get_info<CL_PLATFORM_VENDOR>() << '\n' <<
+        	"Version : " << device_.platform().get_info<CL_PLATFORM_VERSION>() << '\n' ;
+
+        std::cout << "== Device : " << device_.name() << " ==\n";
+        std::cout <<
+        	"Name               : " << device_.get_info<CL_DEVICE_NAME>() << '\n' <<
+        	"Vendor             : " << device_.get_info<CL_DEVICE_VENDOR>() <<
+            " (ID:" << device_.get_info<CL_DEVICE_VENDOR_ID>() << ")\n" <<
+        	"Version            : " << device_.get_info<CL_DEVICE_VERSION>() << '\n' <<
+        	"Driver version     : " << device_.get_info<CL_DRIVER_VERSION>() << '\n' <<
+        	"OpenCL C version   : " << device_.get_info<CL_DEVICE_OPENCL_C_VERSION>() << '\n' <<
+            "Double precision   : " << (device_.supports_extension("cl_khr_fp64") ? "supported" : "not supported") << '\n' <<
+            "Atoms              : " <<
+            boost::format("%d (global work size %d, buffer capacity %d)\n") % NumAtom_ % globalworksize() % (r_dev_.capacity() / ParticleStore<real_type>::DEVICEBLOCKS) <<
+            "Build options      : " << kerneloptions_ << '\n' <<
+            "Work-group sizes   : " <<
+            boost::format("force %d, force_tiled %d, force_linkedcell %d, force_verletlist %d, move_atoms %d (%s)\n") %
+                forceworksize_[static_cast<std::size_t>(ForceKernelType::AllPairs)] %
+                forceworksize_[static_cast<std::size_t>(ForceKernelType::AllPairsTiled)] %
+                forceworksize_[static_cast<std::size_t>(ForceKernelType::LinkedCell)] %
+                forceworksize_[static_cast<std::size_t>(ForceKernelType::VerletList)] %
+                moveworksize_ %
+                (autotuned_ ? "autotuned" : "default") <<
+            "Program cache      : " << programcache_.getHits() << " hits, " << programcache_.getMisses() << " misses, " <<
+            boost::format("%.3f") % programcache_.getBuildTime() << " sec (" << programcache_.getDirectory() << ")" << std::endl;
+
+        if (slabs_.size() > 1) {
+            // 複数のデバイスを使う場合は、各デバイスが受け持つ原子の範囲を表示する
+            std::cout << "== Devices : " << slabs_.size() << (usemultidevice() ? " (atoms split into slabs) ==\n" : " (linked cell runs on the first device) ==\n");
+            for (auto i = 0U; i < slabs_.size(); i++) {
+                auto const & slab = slabs_[i];
+                std::cout << boost::format("%-2d %-40s: ") % i % devices_[i].name();
+                if (slab.empty()) {
+                    std::cout << "no atoms\n";
+                }
+                else {
+                    std::cout << boost::format("atoms [%d, %d)\n") % slab.begin % slab.last(NumAtom_);
+                }
+            }
+            std::cout << std::flush;
+        }
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::Move_Atoms(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::NoParallel)>)
+    {
+        // OpenCLで計算した結果がデバイス側にあれば、ホスト側に戻す
+        UseHostState();
+
+        // 一つ前のステップの温度を用いる場合は、運動エネルギーを時間発展のループの中で求める
+        auto const lagged = uselaggedthermostat();
+
+        // 運動エネルギーの初期化
+        Uk_ = 0.0;
+
+        if (!lagged) {
+            // 運動エネルギーの計算
+            for (auto n = 0; n < NumAtom_; n++) {
+                Uk_ += norm2(V_[n][0], V_[n][1], V_[n][2]);
+            }
+            Uk_ *= 0.5;
+
+            // 全エネルギーの出力と温度の計算
+            OutputEnergy(ofs_, 0.0);
+        }
+
+        // calculate temperture
+        auto const s = thermostatscale();
+
+        switch (MD_iter_) {
+        case 1:
+            // update the coordinates by the second order Euler method
+            // 最初のステップだけ修正Euler法で時間発展
+            for (auto n = 0; n < NumAtom_; n++) {
+                r1_.set(n, r_.get(n));
+
+                // scaling of velocity
+                V_[n][0] *= s;
+                V_[n][1] *= s;
+                V_[n][2] *= s;
+
+                // update coordinates and velocity
+                r_[n][0] += Ar_moleculardynamics::DT * V_[n][0] + 0.5 * F_[n][0] * dt2;
+                r_[n][1] += Ar_moleculardynamics::DT * V_[n][1] + 0.5 * F_[n][1] * dt2;
+                r_[n][2] += Ar_moleculardynamics::DT * V_[n][2] + 0.5 * F_[n][2] * dt2;
+
+                V_[n][0] += Ar_moleculardynamics::DT * F_[n][0];
+                V_[n][1] += Ar_moleculardynamics::DT * F_[n][1];
+                V_[n][2] += Ar_moleculardynamics::DT * F_[n][2];
+            }
+        break;
+
+        default:
+            // update the coordinates by the Verlet method
+            for (auto n = 0; n < NumAtom_; n++) {
+                if (lagged) {
+                    // 更新する前の速度から運動エネルギーを計算
+                    Uk_ += norm2(V_[n][0], V_[n][1], V_[n][2]);
+                }
+
+                auto const rtmp = r_.get(n);
+#ifdef NVE
+                r_[n][0] = 2.0 * r_[n][0] - r1_[n][0] + F_[n][0] * dt2;
+                r_[n][1] = 2.0 * r_[n][1] - r1_[n][1] + F_[n][1] * dt2;
+                r_[n][2] = 2.0 * r_[n][2] - r1_[n][2] + F_[n][2] * dt2;
+#else
+                // update coordinates and velocity
+                // Verlet法の座標更新式において速度成分を抜き出し、その部分をスケールする
+                r_[n][0] += s * (r_[n][0] - r1_[n][0]) + F_[n][0] * dt2;
+                r_[n][1] += s * (r_[n][1] - r1_[n][1]) + F_[n][1] * dt2;
+                r_[n][2] += s * (r_[n][2] - r1_[n][2]) + F_[n][2] * dt2;
+#endif
+
+                V_[n][0] = 0.5 * (r_[n][0] - r1_[n][0]) / Ar_moleculardynamics::DT;
+                V_[n][1] = 0.5 * (r_[n][1] - r1_[n][1]) / Ar_moleculardynamics::DT;
+                V_[n][2] = 0.5 * (r_[n][2] - r1_[n][2]) / Ar_moleculardynamics::DT;
+                
+                r1_.set(n, rtmp);
+            }
+        break;
+        }
+
+        if (lagged) {
+            // 全エネルギーの出力と温度の計算
+            Uk_ *= 0.5;
+            OutputEnergy(ofs_, s);
+        }
+
+        // consider the periodic boundary condination
+        // セルの外側に出たら座標をセル内に戻す
+        for (auto n = 0; n < NumAtom_; n++) {
+            for (auto i = 0; i < 3; i++) {
+                if (r_[n][i] > periodiclen_) {
+                    r_[n][i] -= periodiclen_;
+                    r1_[n][i] -= periodiclen_;
+                }
+                else if (r_[n][i] < 0.0) {
+                    r_[n][i] += periodiclen_;
+                    r1_[n][i] += periodiclen_;
+                }
+            }
+        }
+
+        if (useverletlist() && !rebuildverletlist_) {
+            // 近接リストを構築した時点からの原子の最大変位を求める
+            auto maxdisp2 = static_cast<T>(0);
+            for (auto n = 0; n < NumAtom_; n++) {
+                maxdisp2 = std::max(maxdisp2, verletlist_.displacement2(n, r_[n][0], r_[n][1], r_[n][2]));
+            }
+
+            // 近接リストの再構築が必要かどうかを判定
+            CheckVerletList(maxdisp2);
+        }
+
+        MD_iter_++;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::Move_Atoms(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::OpenCl)>)
+    {
+        // 複数のデバイスを使う場合は、原子を分割してそれぞれのデバイスで計算する
+        if (usemultidevice()) {
+            Move_Atoms_MultiDevice();
+            return;
+        }
+
+        // ホスト→デバイス（デバイス側に置いたままにする場合は、デバイス側が古いときだけ転送）
+        if (deviceresident_) {
+            UseDeviceState();
+        }
+        else {
+            CopyToDevice(r_, r_dev_);
+            CopyToDevice(r1_, r1_dev_);
+            CopyToDevice(V_, V_dev_);
+            ukcurrent_ = false;
+        }
+
+        // 速度が前のステップの時間発展のカーネルで求めたものでなければ、運動エネルギーの部分和を求め直す
+        if (!ukcurrent_) {
+            EnqueueKernel(kernel_kinetic_, moveworksize_);
+        }
+
+        // 運動エネルギー（と、まだ読み込んでいなければポテンシャルエネルギー）の部分和を読み込む
+        // 時間発展のカーネルが運動エネルギーの部分和を上書きするので、その前に読み込みを投入しておく
+        auto const lagged = uselaggedthermostat();
+        auto const event_partials = EnqueueReadPartials(true);
+
+        if (!lagged) {
+            // 温度のスケーリングに必要なので、ここでデバイス側の完了を待つ
+            FinishReadPartials(event_partials, true);
+
+            // 全エネルギーの出力と温度の計算
+            OutputEnergy(openclofs_, 0.0);
+        }
+
+        // calculate temperture
+        // （Laggedの場合は一つ前のステップの温度を用いるので、ホスト側は待たずに時間発展のカーネルを投入できる）
+        auto const s = thermostatscale();
+
+        switch (MD_iter_) {
+        case 1:
+            {
+                // update the coordinates by the second order Euler method
+                // 最初のステップだけ修正Euler法で時間発展
+                kernel_move_atoms1_.set_args(
+                    r_dev_,
+                    r1_dev_,
+                    V_dev_,
+                    F_dev_,
+                    static_cast<real_type>(Ar_moleculardynamics::DT),
+                    s,
+                    partial_dev_);
+
+                EnqueueKernel(kernel_move_atoms1_, moveworksize_);
+            }
+        break;
+
+        default:
+            {
+                // update the coordinates by the Verlet method
+                kernel_move_atoms_.set_args(
+                    r_dev_,
+                    r1_dev_,
+                    V_dev_,
+                    F_dev_,
+                    static_cast<real_type>(Ar_moleculardynamics::DT),
+                    s,
+                    partial_dev_);
+
+                EnqueueKernel(kernel_move_atoms_, moveworksize_);
+            }
+        break;
+        }
+
+        // 周期境界条件のチェック
+        EnqueueKernel(kernel_check_periodic_, moveworksize_);
+
+        if (useverletlist() && !rebuildverletlist_) {
+            // 近接リストを構築した時点からの原子の変位を計算
+            EnqueueKernel(kernel_displacement_, moveworksize_);
+
+            // 原子の最大変位の部分和を非同期に読み込み、次のステップの最初に近接リストの再構築が必要かどうかを判定する
+            auto const ngroup = globalworksize() / moveworksize_;
+            disp2event_ = queue_.enqueue_read_buffer_async(
+                partial_dev_.get_buffer(),
+                3 * partialstride() * sizeof(real_type),
+                ngroup * sizeof(real_type),
+                partial_.data() + 3 * partialstride(),
+                compute::wait_list(lastevent_));
+            disp2pending_ = true;
+        }
+
+        if (lagged) {
+            // 時間発展のカーネルを投入した後で部分和の読み込みを待ち、全エネルギーの出力と温度の計算を行う
+            FinishReadPartials(event_partials, true);
+            OutputEnergy(openclofs_, s);
+        }
+
+        // デバイス→ホスト
+        if (!deviceresident_) {
+            CopyFromDevice(r_dev_, r_);
+            CopyFromDevice(r1_dev_, r1_);
+            CopyFromDevice(V_dev_, V_);
+        }
+
+        // 時間発展のカーネルが、次のステップの運動エネルギーの部分和を求めている
+        ukcurrent_ = true;
+
+        openclsteps_++;
+        MD_iter_++;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::Move_Atoms(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Tbb)>)
+    {
+        Move_Atoms_Tbb(tbbofs_);
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::Move_Atoms(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Hybrid)>)
+    {
+        // 力はTBBとOpenCLとで分けて求めたものがホスト側に揃っているので、時間発展はTBBで行う
+        Move_Atoms_Tbb(hybridofs_);
+    }
+
+#ifdef USE_MPI
+    template <typename T>
+    void Ar_moleculardynamics<T>::Move_Atoms(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Mpi)>)
+    {
+        // 力を計算する前に呼ばれた場合も、各プロセスが受け持つ原子を選ぶ
+        UseMpiState();
+
+        auto & r = mpidomain_.r();
+        auto & r1 = mpidomain_.r1();
+        auto & V = mpidomain_.V();
+        auto & F = mpidomain_.F();
+        auto const nlocal = mpidomain_.nlocal();
+
+        // 一つ前のステップの温度を用いる場合は、運動エネルギーを時間発展のループの中で求める
+        auto const lagged = uselaggedthermostat();
+        auto Uk = static_cast<real_type>(0);
+
+        if (!lagged) {
+            // 運動エネルギーの計算（全てのプロセスの分を足し合わせる）
+            for (auto n = 0; n < nlocal; n++) {
+                Uk += norm2(V[n][0], V[n][1], V[n][2]);
+            }
+            Uk_ = 0.5 * mpidomain_.sum(Uk);
+
+            // 全エネルギーの出力と温度の計算
+            OutputEnergy(mpiofs_, 0.0);
+        }
+
+        // calculate temperture
+        auto const s = thermostatscale();
+
+        switch (MD_iter_) {
+        case 1:
+            // update the coordinates by the second order Euler method
+            // 最初のステップだけ修正Euler法で時間発展
+            for (auto n = 0; n < nlocal; n++) {
+                r1.set(n, r.get(n));
+
+                // scaling of velocity
+                V[n][0] *= s;
+                V[n][1] *= s;
+                V[n][2] *= s;
+
+                // update coordinates and velocity
+                r[n][0] += Ar_moleculardynamics::DT * V[n][0] + 0.5 * F[n][0] * dt2;
+                r[n][1] += Ar_moleculardynamics::DT * V[n][1] + 0.5 * F[n][1] * dt2;
+                r[n][2] += Ar_moleculardynamics::DT * V[n][2] + 0.5 * F[n][2] * dt2;
+
+                V[n][0] += Ar_moleculardynamics::DT * F[n][0];
+                V[n][1] += Ar_moleculardynamics::DT * F[n][1];
+                V[n][2] += Ar_moleculardynamics::DT * F[n][2];
+            }
+            break;
+
+        default:
+            // update the coordinates by the Verlet method
+            for (auto n = 0; n < nlocal; n++) {
+                if (lagged) {
+                    // 更新する前の速度から運動エネルギーを計算
+                    Uk += norm2(V[n][0], V[n][1], V[n][2]);
+                }
+
+                auto const rtmp = r.get(n);
+#ifdef NVE
+                r[n][0] = 2.0 * r[n][0] - r1[n][0] + F[n][0] * dt2;
+                r[n][1] = 2.0 * r[n][1] - r1[n][1] + F[n][1] * dt2;
+                r[n][2] = 2.0 * r[n][2] - r1[n][2] + F[n][2] * dt2;
+#else
+                // update coordinates and velocity
+                // Verlet法の座標更新式において速度成分を抜き出し、その部分をスケールする
+                r[n][0] += s * (r[n][0] - r1[n][0]) + F[n][0] * dt2;
+                r[n][1] += s * (r[n][1] - r1[n][1]) + F[n][1] * dt2;
+                r[n][2] += s * (r[n][2] - r1[n][2]) + F[n][2] * dt2;
+#endif
+
+                V[n][0] = 0.5 * (r[n][0] - r1[n][0]) / Ar_moleculardynamics::DT;
+                V[n][1] = 0.5 * (r[n][1] - r1[n][1]) / Ar_moleculardynamics::DT;
+                V[n][2] = 0.5 * (r[n][2] - r1[n][2]) / Ar_moleculardynamics::DT;
+
+                r1.set(n, rtmp);
+            }
+            break;
+        }
+
+        if (lagged) {
+            // 全エネルギーの出力と温度の計算
+            Uk_ = 0.5 * mpidomain_.sum(Uk);
+            OutputEnergy(mpiofs_, s);
+        }
+
+        // consider the periodic boundary condination
+        // セルの外側に出たら座標をセル内に戻す
+        for (auto n = 0; n < nlocal; n++) {
+            for (auto i = 0; i < 3; i++) {
+                if (r[n][i] > periodiclen_) {
+                    r[n][i] -= periodiclen_;
+                    r1[n][i] -= periodiclen_;
+                }
+                else if (r[n][i] < 0.0) {
+                    r[n][i] += periodiclen_;
+                    r1[n][i] += periodiclen_;
+                }
+            }
+        }
+
+        // 部分領域の外に出た原子を、その原子を含む部分領域のプロセスに移す
+        mpidomain_.migrate();
+
+        MD_iter_++;
+    }
+#endif
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::printstatistics() const
+    {
+        std::cout <<
+            "== Particle storage ==\n" <<
+            boost::format("Layout                     : %s\n") % ParticleStore<real_type>::name();
+
+        std::cout <<
+            "== Precision ==\n" <<
+            boost::format("Pair / accumulation        : %s / %s\n") % DeviceType<T>::name() % DeviceType<real_type>::name();
+
+        std::cout <<
+            "== CPU force kernel ==\n" <<
+            boost::format("SIMD ISA                   : %s (detected: %s)\n") %
+                LJKernel<T>::name(usesimd() ? ljkernel_.simdtype() : SimdType::Scalar) % LJKernel<T>::name(LJKernel<T>::detect());
+
+        std::cout <<
+            "== Pair potential ==\n" <<
+            boost::format("Evaluator                  : %s\n") % PairPotential<T>::name(pairpotential_.type());
+
+        if (pairpotential_.type() == PairPotentialType::Spline) {
+            std::cout << boost::format("Table intervals            : %d (r^2 = %.2f .. %.2f)\n") %
+                pairpotential_.getTableSize() % PairPotential<T>::R2MIN % rc2_;
+        }
+
+        std::cout <<
+            boost::format("Max |dF| vs analytic       : %.3e\n") % pairpotential_.getMaxForceError() <<
+            boost::format("Max |dU| vs analytic       : %.3e\n") % pairpotential_.getMaxEnergyError();
+
+        std::cout << "== Neighbor search ==\n";
+
+        if (useverletlist()) {
+            std::cout <<
+                boost::format("Method                     : Verlet list (cutoff = %.3f, skin = %.3f)\n") % rc_ % skin_ <<
+                boost::format("Neighbors per atom         : %.2f\n") %
+                    (static_cast<double>(verletlist_.neighbor().size()) / static_cast<double>(NumAtom_)) <<
+                boost::format("List builds / MD steps     : %d / %d\n") % verletlist_.getBuildCount() % verletlist_.getStepCount() <<
+                boost::format("Steps between rebuilds     : mean = %.2f, min = %d, max = %d\n") %
+                    verletlist_.getMeanInterval() % verletlist_.getMinInterval() % verletlist_.getMaxInterval();
+        }
+        else if (uselinkedcell()) {
+            std::cout << boost::format("Method                     : Linked cell (%d x %d x %d cells)\n") %
+                linkedcell_.getNcell() % linkedcell_.getNcell() % linkedcell_.getNcell();
+        }
+        else if (useminimage()) {
+            std::cout << "Method                     : All pairs (minimum image)\n";
+        }
+        else {
+            std::cout << boost::format("Method                     : All pairs (%d images)\n") %
+                ((2 * ncp_ + 1) * (2 * ncp_ + 1) * (2 * ncp_ + 1));
+        }
+
+        if (forcebenchmarkrepeat_ > 0) {
+            // 全ての原子の組を計算するOpenCLのカーネルの比較
+            std::cout <<
+                boost::format("== OpenCL all-pairs force kernel (%d runs) ==\n") % forcebenchmarkrepeat_ <<
+                boost::format("Global memory per run      : %.3f ms\n") % (forcebenchmarkglobaltime_ * 1000.0) <<
+                boost::format("Local-memory tiled per run : %.3f ms (x%.2f)\n") %
+                    (forcebenchmarktiledtime_ * 1000.0) % (forcebenchmarkglobaltime_ / forcebenchmarktiledtime_) <<
+                boost::format("Max |dF| between kernels   : %.3e\n") % forcebenchmarkmaxdiff_;
+        }
+
+        if (!autotuneresults_.empty()) {
+            // 力を計算するカーネルと時間発展のカーネルとに分けて、それぞれ速い順に並べる
+            std::vector<std::tuple<std::string, std::int32_t, double>> force, move;
+            for (auto const & result : autotuneresults_) {
+                (std::get<0>(result) == "move_atoms" ? move : force).push_back(result);
+            }
+
+            auto const printranking = [](std::vector<std::tuple<std::string, std::int32_t, double>> & results) {
+                std::sort(results.begin(), results.end(), [](auto const & lhs, auto const & rhs) { return std::get<2>(lhs) < std::get<2>(rhs); });
+
+                std::cout << "Rank  Kernel            Work-group  Time [ms]  vs best\n";
+                for (auto i = 0U; i < results.size(); i++) {
+                    std::cout << boost::format("%4d  %-16s  %10d  %9.3f  x%.2f\n") %
+                        (i + 1) %
+                        std::get<0>(results[i]) %
+                        std::get<1>(results[i]) %
+                        (std::get<2>(results[i]) * 1000.0) %
+                        (std::get<2>(results[i]) / std::get<2>(results.front()));
+                }
+            };
+
+            std::cout << "== OpenCL autotuning (force kernels) ==\n";
+            printranking(force);
+            std::cout << "== OpenCL autotuning (integrate kernel) ==\n";
+            printranking(move);
+        }
+
+        if (openclsteps_ > 0) {
+            // OpenCLで計算した場合の、1ステップあたりのホストとデバイスの間の転送量
+            std::cout <<
+                "== OpenCL data transfer ==\n" <<
+                boost::format("State                      : %s\n") %
+                    (deviceresident_ ? "Device-resident (host refreshed on demand)" : "Host round trip every step") <<
+                boost::format("Host -> device per step    : %.1f KiB\n") %
+                    (static_cast<double>(uploadbytes_) / 1024.0 / static_cast<double>(openclsteps_)) <<
+                boost::format("Device -> host per step    : %.1f KiB\n") %
+                    (static_cast<double>(downloadbytes_) / 1024.0 / static_cast<double>(openclsteps_)) <<
+                boost::format("Host wait per step         : %.3f ms\n") % (hostwaittime_ / openclsteps_ * 1000.0);
+
+            if (slabs_.size() > 1) {
+                // デバイスの間で交換した座標の量（ホストを経由しない）
+                std::cout << boost::format("Device -> device per step  : %.1f KiB (%d devices)\n") %
+                    (static_cast<double>(exchangebytes_) / 1024.0 / static_cast<double>(openclsteps_)) % slabs_.size();
+            }
+
+            // 力と時間発展のカーネルの中でワークグループごとに足し合わせたエネルギーとビリアル
+            std::cout <<
+                "== OpenCL reductions ==\n" <<
+                boost::format("Partial sums (force)       : %d (work-group size %d)\n") %
+                    (globalworksize() / forceworksize_[static_cast<std::size_t>(forcekerneltype())]) %
+                    forceworksize_[static_cast<std::size_t>(forcekerneltype())] <<
+                boost::format("Partial sums (integrate)   : %d (work-group size %d)\n") %
+                    (globalworksize() / moveworksize_) % moveworksize_ <<
+                boost::format("Virial pressure (last step): %.5f\n") %
+                    ((2.0 * Uk_ + virial_) / (3.0 * periodiclen_ * periodiclen_ * periodiclen_));
+        }
+
+        std::cout <<
+            "== Thermostat ==\n" <<
+            boost::format("Kinetic energy for scaling : %s\n") %
+                (thermostattype_ == ThermostatType::Lagged ? "Lagged (previous step)" : "Exact (current step)");
+
+        if (laggedsteps_ > 0) {
+            // 一つ前のステップの温度を用いたことによる、正確な方法からのずれ
+            std::cout <<
+                boost::format("Lagged steps               : %d\n") % laggedsteps_ <<
+                boost::format("Max |s - s_exact|          : %.3e\n") % laggedmaxscalediff_;
+
+            if (laggedcompared_ > 0) {
+                std::cout << boost::format("Max |E - E_exact|          : %.3e (%d steps compared)\n") %
+                    laggedmaxenergydiff_ % laggedcompared_;
+            }
+            else {
+                std::cout << "Max |E - E_exact|          : n/a (no exact run recorded)\n";
+            }
+        }
+
+        if (halfpairsteps_ > 0) {
+            // 力の計算とスレッドごとの力の足し合わせにかかった時間を分けて表示する
+            std::cout <<
+                "== Half pair (Newton's third law) ==\n" <<
+                boost::format("Force loop per step        : %.3f ms\n") % (halfpairforcetime_ / halfpairsteps_ * 1000.0) <<
+                boost::format("Reduction per step         : %.3f ms\n") % (halfpairreductiontime_ / halfpairsteps_ * 1000.0);
+        }
+
+        if (hybridsteps_ > 0) {
+            // TBBとOpenCLとで同時に力を計算した場合の、最後に決めた分け方とそれぞれの時間
+            std::cout <<
+                "== Hybrid (TBB + OpenCL) ==\n" <<
+                boost::format("OpenCL share of atoms      : %.1f %% (%d rebalances, every %d steps)\n") %
+                    (hybridratio_ * 100.0) % hybridrebalances_ % static_cast<std::int32_t>(Ar_moleculardynamics::HYBRIDREBALANCEINTERVAL) <<
+                boost::format("TBB force per step         : %.3f ms\n") % (hybridtotaltime_[0] / hybridsteps_ * 1000.0) <<
+                boost::format("OpenCL force per step      : %.3f ms\n") % (hybridtotaltime_[1] / hybridsteps_ * 1000.0);
+        }
+
+        if (tbbaffinity_.enabled()) {
+            // 原子を分けたNUMAノードと、配列をノードごとに置き直すのにかかった時間
+            std::ostringstream nodes;
+            for (auto i = 0; i < tbbaffinity_.nodenum(); i++) {
+                nodes << (i ? ", " : "") << tbbaffinity_.nodeid(i);
+            }
+
+            std::cout <<
+                "== TBB affinity ==\n" <<
+                boost::format("NUMA nodes                 : %d (id %s)\n") % tbbaffinity_.nodenum() % nodes.str() <<
+                "Partitioner                : affinity_partitioner (reused across steps)\n" <<
+                boost::format("First-touch placement      : %.3f ms\n") % (tbbfirsttouchtime_ * 1000.0);
+        }
+
+        if (flowgraphsteps_ > 0) {
+            // TBBのフローグラフで時間発展させた場合の、ステップあたりの時間と、次のステップと同時に行った出力・解析の時間
+            std::cout <<
+                "== TBB flow graph ==\n" <<
+                boost::format("Wall time per step         : %.3f ms (%d steps)\n") % (flowgraphtime_ / flowgraphsteps_ * 1000.0) % flowgraphsteps_ <<
+                boost::format("Energy output per step     : %.3f ms (overlapped)\n") % (flowgraphoutputtime_ / flowgraphsteps_ * 1000.0) <<
+                boost::format("RDF analysis per sample    : %.3f ms (%d samples, at most every %d steps)\n") %
+                    (radialdistribution_.samples() ? flowgraphanalysistime_ / radialdistribution_.samples() * 1000.0 : 0.0) %
+                    radialdistribution_.samples() % static_cast<std::int32_t>(Ar_moleculardynamics::ANALYSISINTERVAL) <<
+                boost::format("Drain after last step      : %.3f ms\n") % (flowgraphdraintime_ * 1000.0);
+        }
+
+#ifdef USE_MPI
+        if (mpidomain_.getExchangeCount() > 0) {
+            // 空間分割の仕方と、ステップあたりの原子数と通信時間（最初のプロセスの値）
+            auto const count = mpidomain_.getExchangeCount();
+            auto const & dims = mpidomain_.getDims();
+            std::cout <<
+                "== MPI domain decomposition ==\n" <<
+                boost::format("Processes                  : %d (%d x %d x %d)\n") % mpidomain_.size() % dims[0] % dims[1] % dims[2] <<
+                boost::format("Owned atoms per step       : %.1f\n") % (static_cast<double>(mpidomain_.getOwnedCount()) / count) <<
+                boost::format("Ghost atoms per step       : %.1f\n") % (static_cast<double>(mpidomain_.getGhostCount()) / count) <<
+                boost::format("Migrated atoms per step    : %.2f\n") % (static_cast<double>(mpidomain_.getMigrationCount()) / count) <<
+                boost::format("Ghost exchange per step    : %.3f ms\n") % (mpidomain_.getExchangeTime() / count * 1000.0);
+        }
+#endif
+
+        std::cout << std::flush;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::runFlowGraph(std::int32_t steps, bool analysis)
+    {
+        if (steps <= 0) {
+            return;
+        }
+
+        // OpenCLで計算した結果がデバイス側にあれば、ホスト側に戻す
+        UseHostState();
+
+        using snapshot_ptr = std::shared_ptr<StepSnapshot<real_type>>;
+
+        auto const start = tbb::tick_count::now();
+        auto finish = start;
+
+        tbb::flow::graph g;
+
+        // 各ステップの始まり（力の計算と運動エネルギーの計算の両方にステップの番号を送る）
+        tbb::flow::broadcast_node<std::int32_t> begin(g);
+
+        // 力の計算（ノードの中はtbb::parallel_forで並列化されている）
+        tbb::flow::function_node<std::int32_t, std::int32_t> force(g, tbb::flow::serial, [this](std::int32_t i) {
+            Calc_Forces(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Tbb)>());
+            return i;
+        });
+
+        // Exactの場合の運動エネルギーは速度だけから求まるので、力の計算と同時に求める
+        // （ステップ数は前のステップの時間発展が終わってから変わらないので、ここで温度の求め方を決めてよい）
+        tbb::flow::function_node<std::int32_t, std::int32_t> kinetic(g, tbb::flow::serial, [this](std::int32_t i) {
+            if (!uselaggedthermostat()) {
+                Uk_ = Calc_Kinetic_Energy_Tbb();
+            }
+
+            return i;
+        });
+
+        tbb::flow::join_node<std::tuple<std::int32_t, std::int32_t>> join(g);
+
+        // 時間発展（出力と解析にこのステップの値を送り、残りのステップがあれば次のステップを始める）
+        using integrate_node = tbb::flow::multifunction_node<std::tuple<std::int32_t, std::int32_t>, std::tuple<snapshot_ptr, snapshot_ptr, std::int32_t>>;
+        integrate_node integrate(g, tbb::flow::serial, [this, steps, analysis, &finish](auto const & in, auto & ports) {
+            auto const i = std::get<0>(in);
+            auto const lagged = uselaggedthermostat();
+
+            auto snapshot = std::make_shared<StepSnapshot<real_type>>();
+            if (!lagged) {
+                *snapshot = UpdateEnergy(0.0);
+            }
+
+            auto const s = thermostatscale();
+            auto const Uk = Integrate_Tbb(s, lagged);
+
+            if (lagged) {
+                Uk_ = Uk;
+                *snapshot = UpdateEnergy(s);
+            }
+
+            // 解析に用いる座標は、次のステップで書き換えられる前に写しておく
+            auto const analyzestep = analysis && MD_iter_ % Ar_moleculardynamics::ANALYSISINTERVAL == 0;
+            if (analyzestep) {
+                snapshot->r = r_;
+            }
+
+            MD_iter_++;
+
+            std::get<0>(ports).try_put(snapshot);
+            if (analyzestep) {
+                std::get<1>(ports).try_put(snapshot);
+            }
+
+            if (i + 1 < steps) {
+                std::get<2>(ports).try_put(i + 1);
+            }
+            else {
+                finish = tbb::tick_count::now();
+            }
+        });
+
+        // エネルギーの出力（ファイルへの書き込みは次のステップの計算と同時に行う）
+        tbb::flow::function_node<snapshot_ptr> output(g, tbb::flow::serial, [this](snapshot_ptr const & snapshot) {
+            auto const start = tbb::tick_count::now();
+            WriteEnergy(flowgraphofs_, *snapshot);
+            flowgraphoutputtime_ += (tbb::tick_count::now() - start).seconds();
+        });
+
+        // 解析（写した座標から動径分布関数を求める）
+        // 前に送られた座標をまだ解析している間に送られたものは受け取らずに捨て、時間発展を待たせない
+        tbb::flow::function_node<snapshot_ptr, tbb::flow::continue_msg, tbb::flow::rejecting> analyze(g, tbb::flow::serial, [this](snapshot_ptr const & snapshot) {
+            auto const start = tbb::tick_count::now();
+            radialdistribution_.accumulate(snapshot->r, NumAtom_, periodiclen_);
+            flowgraphanalysistime_ += (tbb::tick_count::now() - start).seconds();
+        });
+
+        tbb::flow::make_edge(begin, force);
+        tbb::flow::make_edge(begin, kinetic);
+        tbb::flow::make_edge(force, tbb::flow::input_port<0>(join));
+        tbb::flow::make_edge(kinetic, tbb::flow::input_port<1>(join));
+        tbb::flow::make_edge(join, integrate);
+        tbb::flow::make_edge(tbb::flow::output_port<0>(integrate), output);
+        tbb::flow::make_edge(tbb::flow::output_port<1>(integrate), analyze);
+        tbb::flow::make_edge(tbb::flow::output_port<2>(integrate), begin);
+
+        begin.try_put(0);
+        g.wait_for_all();
+
+        auto const end = tbb::tick_count::now();
+        flowgraphsteps_ += steps;
+        flowgraphtime_ += (end - start).seconds();
+        flowgraphdraintime_ += (end - finish).seconds();
+
+        if (analysis) {
+            radialdistribution_.save(ResultFileName(Ar_moleculardynamics::RDFFILENAME));
+        }
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::reset()
+    {
+        // ホスト側の値で初期化するので、デバイス側の値は使わない
+        UseHostState();
+
+        MD_iter_ = 1;
+
+        // 座標が変わるので、近接リストを再構築する
+        rebuildverletlist_ = true;
+        
+        r_ = r_clone_;
+        V_ = V_clone_;
+
+        // 動径分布関数は新しい時間発展から求め直す
+        radialdistribution_.clear();
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::setNc(std::int32_t nc)
+    {
+        if (nc < 1) {
+            throw std::invalid_argument("The number of supercells must be at least 1: " + std::to_string(nc));
+        }
+
+        // 原子数はstd::int32_tで数えるので、溢れる大きさは受け付けない（nc^3はstd::int64_tでも溢れうるのでdoubleで比べる）
+        if (4.0 * nc * nc * nc > static_cast<double>(std::numeric_limits<std::int32_t>::max())) {
+            throw std::invalid_argument("The number of supercells is too large: " + std::to_string(nc));
+        }
+
+        // 投入済みのカーネルの完了を待ち、読み込んでいない部分和を捨てる
+        UseHostState();
+        forcepartialpending_ = false;
+
+        Nc_ = nc;
+        ModLattice();
+
+        // TBBとOpenCLとで同時に計算する場合の時間は、新しい原子数で測り直す（割合はそのまま引き継ぐ）
+        hybridatoms_.fill(0);
+        hybridtime_.fill(0.0);
+        hybridwindow_ = 0;
+
+        // 原子数と周期境界条件の長さが変わったので、カーネルをビルドし直す
+        UpdateKernel();
+        ljkernel_.setup(ljkernel_.simdtype(), periodiclen_, rc2_, Vrc_);
+
+        // 最適なワークグループの大きさは原子数によって変わるので、その原子数で自動調整したものを読み込み直す
+        forceworksize_.fill(static_cast<std::int32_t>(Ar_moleculardynamics::LOCALWORKSIZE));
+        moveworksize_ = Ar_moleculardynamics::LOCALWORKSIZE;
+        autotuned_ = false;
+        autotuneresults_.clear();
+        LoadTuning();
+    }
+
+#ifdef USE_MPI
+    template <typename T>
+    void Ar_moleculardynamics<T>::UseMpiState()
+    {
+        if (mpicurrent_) {
+            return;
+        }
+
+        // 最新の値をホスト側に戻してから、各プロセスが受け持つ原子を選ぶ
+        UseHostState();
+
+        // 部分領域の幅がカットオフ半径より短ければ、例外を投げる
+        mpidomain_.setup(periodiclen_, rc_);
+        mpidomain_.scatter(r_, r1_, V_, F_, NumAtom_);
+
+        mpicurrent_ = true;
+    }
+#endif
+
+    // #endregion publicメンバ関数
+
+    // #region privateメンバ関数
+
+    template <typename T>
+    template <bool HalfPair>
+    typename Ar_moleculardynamics<T>::real_type Ar_moleculardynamics<T>::Calc_Forces_AllPairs(ParticleStore<real_type> & F, std::int32_t begin, std::int32_t end, real_type & W)
+    {
+        auto Up = static_cast<real_type>(0);
+
+        if (useminimage()) {
+            // 最小イメージ規約に従って、最も近いイメージとだけ相互作用を計算
+            for (auto n = begin; n < end; n++) {
+                // ポテンシャルエネルギーとビリアルは原子ごとに足し合わせてから加える（全ての組を一つの変数に足すと、丸め誤差が大きくなる）
+                auto Upn = static_cast<real_type>(0);
+                auto Wn = static_cast<real_type>(0);
+
+                // Newtonの第三法則を用いる場合は、m > nの組だけを計算
+                for (auto m = HalfPair ? n + 1 : 0; m < NumAtom_; m++) {
+                    // 自分自身との相互作用を排除
+                    if (n != m) {
+                        auto const dx = static_cast<T>(minimage(r_[n][0] - r_[m][0]));
+                        auto const dy = static_cast<T>(minimage(r_[n][1] - r_[m][1]));
+                        auto const dz = static_cast<T>(minimage(r_[n][2] - r_[m][2]));
+
+                        auto const r2 = norm2(dx, dy, dz);
+                        // 打ち切り距離内であれば計算
+                        if (r2 <= rc2_) {
+                            Upn += Calc_Force_Pair<HalfPair>(F, n, m, dx, dy, dz, r2, Wn);
+                        }
+                    }
+                }
+
+                Up += Upn;
+
+                W += Wn;
+            }
+
+            return Up;
+        }
+
+        for (auto n = begin; n < end; n++) {
+            auto Upn = static_cast<real_type>(0);
+            auto Wn = static_cast<real_type>(0);
+
+            // Newtonの第三法則を用いる場合は、m >= nの組だけを計算
+            for (auto m = HalfPair ? n : 0; m < NumAtom_; m++) {
+                // 最も近いイメージとの距離
+                auto const dx0 = static_cast<T>(minimage(r_[n][0] - r_[m][0]));
+                auto const dy0 = static_cast<T>(minimage(r_[n][1] - r_[m][1]));
+                auto const dz0 = static_cast<T>(minimage(r_[n][2] - r_[m][2]));
+
+                // 最も近いイメージから±ncp_分のセル内の原子との相互作用を計算
+                for (auto i = -ncp_; i <= ncp_; i++) {
+                    for (auto j = -ncp_; j <= ncp_; j++) {
+                        for (auto k = -ncp_; k <= ncp_; k++) {
+                            // 自分自身のイメージとの相互作用は、(i, j, k)と(-i, -j, -k)の一方だけを計算
+                            if (HalfPair && n == m && (i < 0 || (i == 0 && (j < 0 || (j == 0 && k <= 0))))) {
+                                continue;
+                            }
+
+                            auto const sx = static_cast<T>(i) * periodiclen_;
+                            auto const sy = static_cast<T>(j) * periodiclen_;
+                            auto const sz = static_cast<T>(k) * periodiclen_;
+
+                            // 自分自身との相互作用を排除
+                            if (n != m || i != 0 || j != 0 || k != 0) {
+                                auto const dx = dx0 - sx;
+                                auto const dy = dy0 - sy;
+                                auto const dz = dz0 - sz;
+
+                                auto const r2 = norm2(dx, dy, dz);
+                                // 打ち切り距離内であれば計算
+                                if (r2 <= rc2_) {
+                                    Upn += Calc_Force_Pair<HalfPair>(F, n, m, dx, dy, dz, r2, Wn);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            Up += Upn;
+
+            W += Wn;
+        }
+
+        return Up;
+    }
+
+    template <typename T>
+    template <bool HalfPair>
+    typename Ar_moleculardynamics<T>::real_type Ar_moleculardynamics<T>::Calc_Forces_LinkedCell(ParticleStore<real_type> & F, std::int32_t begin, std::int32_t end, real_type & W)
+    {
+        auto const & cellatom = linkedcell_.cellatom();
+        auto const & cellstart = linkedcell_.cellstart();
+        auto const & neighborcell = linkedcell_.neighborcell();
+
+        auto Up = static_cast<real_type>(0);
+
+        for (auto n = begin; n < end; n++) {
+            // ポテンシャルエネルギーとビリアルは原子ごとに足し合わせてから加える（全ての組を一つの変数に足すと、丸め誤差が大きくなる）
+            auto Upn = static_cast<real_type>(0);
+            auto Wn = static_cast<real_type>(0);
+
+            auto const c = linkedcell_.atomcell(n) * LinkedCell<T>::NEIGHBORCELLNUM;
+
+            // 自分自身を含む隣接する27個のセル内の原子との相互作用を計算
+            for (auto i = 0; i < LinkedCell<T>::NEIGHBORCELLNUM; i++) {
+                auto const nc = neighborcell[c + i];
+
+                for (auto idx = cellstart[nc]; idx < cellstart[nc + 1]; idx++) {
+                    auto const m = cellatom[idx];
+
+                    // 自分自身との相互作用を排除（Newtonの第三法則を用いる場合は、m > nの組だけを計算）
+                    if (HalfPair ? n < m : n != m) {
+                        // セルの一辺の長さはカットオフ半径以上なので、最も近いイメージとだけ相互作用する
+                        auto const dx = static_cast<T>(minimage(r_[n][0] - r_[m][0]));
+                        auto const dy = static_cast<T>(minimage(r_[n][1] - r_[m][1]));
+                        auto const dz = static_cast<T>(minimage(r_[n][2] - r_[m][2]));
+
+                        auto const r2 = norm2(dx, dy, dz);
+                        // 打ち切り距離内であれば計算
+                        if (r2 <= rc2_) {
+                            Upn += Calc_Force_Pair<HalfPair>(F, n, m, dx, dy, dz, r2, Wn);
+                        }
+                    }
+                }
+            }
+
+            Up += Upn;
+
+            W += Wn;
+        }
+
+        return Up;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::Calc_Forces_MultiDevice()
+    {
+        // 最新の座標・速度・力を全てのデバイスに置く
+        UseSlabState();
+
+        // 系の大きさやカットオフ半径、ビルドオプションが変わっていれば、カーネルをビルドし直す
+        UpdateKernel();
+
+        auto const localworksize = forceworksize_[static_cast<std::size_t>(forcekerneltype())];
+
+        // 必要であれば近接リストを再構築（原子の最大変位は、前のステップの時間発展のときに判定している）
+        if (useverletlist() && rebuildverletlist_) {
+            UploadVerletListSlabs();
+        }
+
+        for (auto & slab : slabs_) {
+            if (slab.empty()) {
+                continue;
+            }
+
+            // 部分和を読み込むときのために、ワークグループの個数を覚えておく
+            slab.forcegroups = (slab.end - slab.begin) / localworksize;
+
+            // 各デバイスは全ての原子の座標を持っているので、受け持つ原子に働く力だけを計算すればよい
+            if (useverletlist()) {
+                EnqueueSlabKernel(slab, slab.force_verletlist, localworksize);
+            }
+            else if (tiledforce_) {
+                slab.force_tiled.set_arg(3, compute::local_buffer<real4_type>(localworksize));
+                EnqueueSlabKernel(slab, slab.force_tiled, localworksize);
+            }
+            else {
+                for (auto b = 0; b < ParticleStore<real_type>::DEVICEBLOCKS; b++) {
+                    auto const first = slab.F.begin() + b * globalworksize();
+                    compute::fill(first + slab.begin, first + slab.end, particle_type(static_cast<real_type>(0)), slab.queue);
+                }
+                EnqueueSlabKernel(slab, slab.force, localworksize);
+            }
+        }
+    }
+
+    template <typename T>
+    template <bool HalfPair>
+    typename Ar_moleculardynamics<T>::real_type Ar_moleculardynamics<T>::Calc_Forces_Range(ParticleStore<real_type> & F, std::int32_t begin, std::int32_t end, real_type & W)
+    {
+        if (usesimd()) {
+            return Calc_Forces_Simd<HalfPair>(F, begin, end, W);
+        }
+        else if (useverletlist()) {
+            return Calc_Forces_VerletList<HalfPair>(F, begin, end, W);
+        }
+        else if (uselinkedcell()) {
+            return Calc_Forces_LinkedCell<HalfPair>(F, begin, end, W);
+        }
+        else {
+            return Calc_Forces_AllPairs<HalfPair>(F, begin, end, W);
+        }
+    }
+
+    template <typename T>
+    template <bool HalfPair>
+    typename Ar_moleculardynamics<T>::real_type Ar_moleculardynamics<T>::Calc_Forces_Simd(ParticleStore<real_type> & F, std::int32_t begin, std::int32_t end, real_type & W)
+    {
+        auto const verletlist = useverletlist();
+        auto const linkedcell = uselinkedcell();
+
+        auto & pack = neighborpack_.local();
+        auto Up = static_cast<real_type>(0);
+
+        for (auto n = begin; n < end; n++) {
+            pack.clear();
+
+            auto const rn = r_.get(n);
+
+            // 近接原子の座標を連続した配列に詰め込む（Newtonの第三法則を用いる場合は、m > nの原子だけ）
+            auto const push = [this, &pack, &rn, n](std::int32_t m) {
+                if (HalfPair ? n < m : n != m) {
+                    if (Precision<T>::MIXED) {
+                        // 混合精度の場合は、最も近いイメージとの相対座標をreal_typeで求めてから丸める
+                        pack.push_back(
+                            m,
+                            static_cast<T>(minimage(r_[m][0] - rn[0])),
+                            static_cast<T>(minimage(r_[m][1] - rn[1])),
+                            static_cast<T>(minimage(r_[m][2] - rn[2])));
+                    }
+                    else {
+                        pack.push_back(m, r_[m][0], r_[m][1], r_[m][2]);
+                    }
+                }
+            };
+
+            if (verletlist) {
+                auto const & neighbor = verletlist_.neighbor();
+                auto const & neighborstart = verletlist_.neighborstart();
+
+                for (auto idx = neighborstart[n]; idx < neighborstart[n + 1]; idx++) {
+                    push(neighbor[idx]);
+                }
+            }
+            else if (linkedcell) {
+                auto const & cellatom = linkedcell_.cellatom();
+                auto const & cellstart = linkedcell_.cellstart();
+                auto const c = linkedcell_.atomcell(n) * LinkedCell<T>::NEIGHBORCELLNUM;
+
+                for (auto i = 0; i < LinkedCell<T>::NEIGHBORCELLNUM; i++) {
+                    auto const nc = linkedcell_.neighborcell()[c + i];
+
+                    for (auto idx = cellstart[nc]; idx < cellstart[nc + 1]; idx++) {
+                        push(cellatom[idx]);
+                    }
+                }
+            }
+            else {
+                for (auto m = 0; m < NumAtom_; m++) {
+                    push(m);
+                }
+            }
+
+            // 詰め込んだ原子との相互作用をまとめて計算
+            std::array<T, 3> const ri = Precision<T>::MIXED ?
+                std::array<T, 3>{ { static_cast<T>(0), static_cast<T>(0), static_cast<T>(0) } } :
+                std::array<T, 3>{ { static_cast<T>(rn[0]), static_cast<T>(rn[1]), static_cast<T>(rn[2]) } };
+
+            std::array<T, 3> fi;
+            T wi;
+            auto const U = ljkernel_(ri, pack, HalfPair, fi, wi);
+
+            F[n][0] += fi[0];
+            F[n][1] += fi[1];
+            F[n][2] += fi[2];
+
+            if (HalfPair) {
+                // 反作用を各近接原子に加える
+                for (auto k = 0; k < pack.size(); k++) {
+                    auto const m = pack.index(k);
+
+                    F[m][0] -= pack.f(0)[k];
+                    F[m][1] -= pack.f(1)[k];
+                    F[m][2] -= pack.f(2)[k];
+                }
+
+                Up += U;
+                W += wi;
+            }
+            else {
+                // 二重計算のために0.5をかけておく
+                Up += 0.5 * U;
+                W += 0.5 * wi;
+            }
+        }
+
+        return Up;
+    }
+
+    template <typename T>
+    template <bool HalfPair>
+    typename Ar_moleculardynamics<T>::real_type Ar_moleculardynamics<T>::Calc_Forces_VerletList(ParticleStore<real_type> & F, std::int32_t begin, std::int32_t end, real_type & W)
+    {
+        auto const & neighbor = verletlist_.neighbor();
+        auto const & neighborstart = verletlist_.neighborstart();
+
+        auto Up = static_cast<real_type>(0);
+
+        for (auto n = begin; n < end; n++) {
+            // ポテンシャルエネルギーとビリアルは原子ごとに足し合わせてから加える（全ての組を一つの変数に足すと、丸め誤差が大きくなる）
+            auto Upn = static_cast<real_type>(0);
+            auto Wn = static_cast<real_type>(0);
+
+            // 近接リストに含まれる原子との相互作用を計算
+            for (auto idx = neighborstart[n]; idx < neighborstart[n + 1]; idx++) {
+                auto const m = neighbor[idx];
+
+                // Newtonの第三法則を用いる場合は、m > nの組だけを計算
+                if (HalfPair && m < n) {
+                    continue;
+                }
+
+                // 近接リストのカットオフ半径は周期境界条件の長さの半分未満なので、最も近いイメージとだけ相互作用する
+                auto const dx = static_cast<T>(minimage(r_[n][0] - r_[m][0]));
+                auto const dy = static_cast<T>(minimage(r_[n][1] - r_[m][1]));
+                auto const dz = static_cast<T>(minimage(r_[n][2] - r_[m][2]));
+
+                auto const r2 = norm2(dx, dy, dz);
+                // 打ち切り距離内であれば計算
+                if (r2 <= rc2_) {
+                    Upn += Calc_Force_Pair<HalfPair>(F, n, m, dx, dy, dz, r2, Wn);
+                }
+            }
+
+            Up += Upn;
+
+            W += Wn;
+        }
+
+        return Up;
+    }
+
+    template <typename T>
+    template <bool HalfPair>
+    T Ar_moleculardynamics<T>::Calc_Force_Pair(ParticleStore<real_type> & F, std::int32_t n, std::int32_t m, T dx, T dy, T dz, T r2, real_type & W)
+    {
+        // 力の大きさを距離で割ったものとポテンシャルエネルギー
+        T U;
+        auto const fr = pairpotential_(r2, U);
+
+        auto const fx = dx * fr;
+        auto const fy = dy * fr;
+        auto const fz = dz * fr;
+
+        F[n][0] += fx;
+        F[n][1] += fy;
+        F[n][2] += fz;
+
+        if (HalfPair) {
+            // 反作用をm個目の原子に加える
+            F[m][0] -= fx;
+            F[m][1] -= fy;
+            F[m][2] -= fz;
+
+            // 各原子の組は一度だけ計算されるので、ビリアルとエネルギーをそのまま加える
+            W += fr * r2;
+            return U;
+        }
+
+        // ビリアルとエネルギーの計算、ただし二重計算のために0.5をかけておく
+        W += 0.5 * fr * r2;
+        return 0.5 * U;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::BinAtoms()
+    {
+        // 初めて並べ替えるときは、並びを元の原子の番号順にしておく
+        if (!binned_) {
+            compute::iota(perm_dev_.begin(), perm_dev_.begin() + NumAtom_, 0, queue_);
+        }
+
+        // 各原子が属するセルと、各セルに属する原子の個数を求める
+        compute::fill(cellcount_dev_.begin(), cellcount_dev_.end(), 0, queue_);
+
+        EnqueueKernel(kernel_cellindex_, moveworksize_);
+
+        // 原子の番号をセルの番号順に並べ替える
+        compute::sort_by_key(atomcell_dev_.begin(), atomcell_dev_.begin() + NumAtom_, sortindex_dev_.begin(), queue_);
+
+        // 各セルの先頭の位置を求める
+        compute::exclusive_scan(cellcount_dev_.begin(), cellcount_dev_.end(), cellstart_dev_.begin(), queue_);
+
+        // 座標・1ステップ前の座標・速度をセルの番号順に並べ替える（SoAの場合はx, y, z成分のブロックごと）
+        for (auto dev : { &r_dev_, &r1_dev_, &V_dev_ }) {
+            for (auto b = 0; b < ParticleStore<real_type>::DEVICEBLOCKS; b++) {
+                auto const offset = b * globalworksize();
+                compute::gather(sortindex_dev_.begin(), sortindex_dev_.begin() + NumAtom_, dev->begin() + offset, particletmp_dev_.begin() + offset, queue_);
+                compute::copy(particletmp_dev_.begin() + offset, particletmp_dev_.begin() + offset + NumAtom_, dev->begin() + offset, queue_);
+            }
+        }
+
+        // 元の原子の番号への対応を更新
+        compute::gather(sortindex_dev_.begin(), sortindex_dev_.begin() + NumAtom_, perm_dev_.begin(), permtmp_dev_.begin(), queue_);
+        compute::copy(permtmp_dev_.begin(), permtmp_dev_.begin() + NumAtom_, perm_dev_.begin(), queue_);
+
+        // 元の番号順に戻すときは、逆の対応を用いてgatherで読み込む
+        // （compute::scatterは書き込む位置に配列の先頭からの位置を二重に足すので、x, y, z成分のブロックの途中からは書き込めない）
+        compute::scatter(
+            compute::counting_iterator<std::int32_t>(0),
+            compute::counting_iterator<std::int32_t>(NumAtom_),
+            perm_dev_.begin(),
+            perminv_dev_.begin(),
+            queue_);
+
+        binned_ = true;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::BuildNeighborSearch()
+    {
+        if (useverletlist()) {
+            // 必要であれば近接リストを再構築
+            if (rebuildverletlist_) {
+                verletlist_.build(r_, NumAtom_, periodiclen_, rc_ + skin_);
+                rebuildverletlist_ = false;
+            }
+        }
+        else if (uselinkedcell()) {
+            // セルリストを構築
+            linkedcell_.build(r_, NumAtom_);
+        }
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::CheckVerletList(T maxdisp2)
+    {
+        verletlist_.step();
+
+        // 原子の最大変位がスキンの厚さの半分を超えたら、次のステップで近接リストを再構築する
+        if (maxdisp2 > 0.25 * skin_ * skin_) {
+            rebuildverletlist_ = true;
+        }
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::CheckVerletListDevice()
+    {
+        if (!disp2pending_) {
+            return;
+        }
+
+        auto const start = tbb::tick_count::now();
+        disp2event_.wait();
+        hostwaittime_ += (tbb::tick_count::now() - start).seconds();
+
+        auto const first = partial_.begin() + 3 * partialstride();
+        auto const maxdisp2 = *std::max_element(first, first + globalworksize() / moveworksize_);
+
+        disp2pending_ = false;
+
+        // 近接リストの再構築が必要かどうかを判定
+        CheckVerletList(static_cast<T>(maxdisp2));
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::CopyFromDevice(compute::vector<particle_type> const & dev, ParticleStore<real_type> & host)
+    {
+        downloadbytes_ += static_cast<std::int64_t>(NumAtom_) * ParticleStore<real_type>::DEVICEBYTES;
+
+        if (!binned_) {
+            host.copy_from_device(dev, queue_);
+            return;
+        }
+
+        // セルの番号順の配列を、元の原子の番号順に戻してから転送する
+        for (auto b = 0; b < ParticleStore<real_type>::DEVICEBLOCKS; b++) {
+            auto const offset = b * globalworksize();
+            compute::gather(perminv_dev_.begin(), perminv_dev_.begin() + NumAtom_, dev.begin() + offset, particletmp_dev_.begin() + offset, queue_);
+        }
+        host.copy_from_device(particletmp_dev_, queue_);
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::CopyToDevice(ParticleStore<real_type> const & host, compute::vector<particle_type> & dev)
+    {
+        uploadbytes_ += static_cast<std::int64_t>(NumAtom_) * ParticleStore<real_type>::DEVICEBYTES;
+
+        if (!binned_) {
+            host.copy_to_device(dev, queue_);
+            return;
+        }
+
+        // 元の原子の番号順の配列を転送してから、セルの番号順に並べ替える
+        host.copy_to_device(particletmp_dev_, queue_);
+        for (auto b = 0; b < ParticleStore<real_type>::DEVICEBLOCKS; b++) {
+            auto const offset = b * globalworksize();
+            compute::gather(perm_dev_.begin(), perm_dev_.begin() + NumAtom_, particletmp_dev_.begin() + offset, dev.begin() + offset, queue_);
+        }
+    }
+
+    template <typename T>
+    compute::event Ar_moleculardynamics<T>::EnqueueReadPartials(bool kinetic)
+    {
+        // 力のカーネルと時間発展のカーネルとでワークグループの個数が異なるので、それぞれの長さだけ読み込む
+        auto const stride = partialstride();
+        auto const first = forcepartialpending_ ? 0 : 2 * stride;
+        auto const last = kinetic ? 2 * stride + globalworksize() / moveworksize_ : stride + forcegroups_;
+        if (first >= last) {
+            return compute::event();
+        }
+
+        // 必要な部分和だけを一度に読み込む
+        compute::wait_list events;
+        if (lastevent_.get()) {
+            events.insert(lastevent_);
+        }
+
+        return queue_.enqueue_read_buffer_async(
+            partial_dev_.get_buffer(),
+            first * sizeof(real_type),
+            (last - first) * sizeof(real_type),
+            partial_.data() + first,
+            events);
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::EnqueueKernel(compute::kernel & kernel, std::int32_t localworksize)
+    {
+        // キューは順序通りに実行されるが、依存関係をイベントで明示しておく
+        compute::wait_list events;
+        if (lastevent_.get()) {
+            events.insert(lastevent_);
+        }
+
+        lastevent_ = queue_.enqueue_1d_range_kernel(
+            kernel,
+            0,
+            globalworksize(),
+            localworksize,
+            events);
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::EnqueueKernel(compute::kernel & kernel, std::int32_t localworksize, std::int32_t globalsize)
+    {
+        compute::wait_list events;
+        if (lastevent_.get()) {
+            events.insert(lastevent_);
+        }
+
+        lastevent_ = queue_.enqueue_1d_range_kernel(
+            kernel,
+            0,
+            globalsize,
+            localworksize,
+            events);
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::EnqueueSlabKernel(DeviceSlab<real_type> & slab, compute::kernel & kernel, std::int32_t localworksize)
+    {
+        // 他のデバイスが読み込み終わるまで、このデバイスの座標を書き換えない
+        compute::wait_list events;
+        if (slab.lastevent.get()) {
+            events.insert(slab.lastevent);
+        }
+
+        for (auto const & event : slab.sends) {
+            events.insert(event);
+        }
+
+        slab.lastevent = slab.queue.enqueue_1d_range_kernel(
+            kernel,
+            slab.begin,
+            slab.end - slab.begin,
+            localworksize,
+            events);
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::ExchangePositions()
+    {
+        // 各デバイスの時間発展と周期境界条件のチェックが終わったときのイベント
+        std::vector<compute::event> moved;
+        for (auto & slab : slabs_) {
+            moved.push_back(slab.lastevent);
+            slab.sends.clear();
+        }
+
+        // 受け持つ原子の座標を、他のデバイスの配列の同じ位置にコピーする
+        // （コピーは受け取る側のキューに投入するので、受け取る側の次のカーネルはコピーの完了を待つ）
+        for (auto & dst : slabs_) {
+            if (dst.empty()) {
+                continue;
+            }
+
+            for (auto i = 0U; i < slabs_.size(); i++) {
+                auto & src = slabs_[i];
+                if (&src == &dst || src.empty()) {
+                    continue;
+                }
+
+                auto const stride = static_cast<std::size_t>(globalworksize()) * sizeof(particle_type);
+                auto const offset = static_cast<std::size_t>(src.begin) * sizeof(particle_type);
+                auto const size = static_cast<std::size_t>(src.last(NumAtom_) - src.begin) * sizeof(particle_type);
+
+                // SoAの場合は、x, y, z成分のブロックごとに同じ範囲をコピーする
+                for (auto b = 0; b < ParticleStore<real_type>::DEVICEBLOCKS; b++) {
+                    dst.lastevent = dst.queue.enqueue_copy_buffer(
+                        src.r.get_buffer(),
+                        dst.r.get_buffer(),
+                        offset + b * stride,
+                        offset + b * stride,
+                        size,
+                        compute::wait_list(moved[i]));
+
+                    src.sends.push_back(dst.lastevent);
+                    exchangebytes_ += static_cast<std::int64_t>(size);
+                }
+            }
+        }
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::FinishReadPartials(compute::event const & event, bool kinetic)
+    {
+        if (!event.get()) {
+            return;
+        }
+
+        // ここでホスト側がデバイス側の完了を待つ
+        auto const start = tbb::tick_count::now();
+        event.wait();
+        hostwaittime_ += (tbb::tick_count::now() - start).seconds();
+
+        auto const stride = partialstride();
+        if (forcepartialpending_) {
+            Up_ = std::accumulate(partial_.begin(), partial_.begin() + forcegroups_, static_cast<real_type>(0));
+            virial_ = std::accumulate(partial_.begin() + stride, partial_.begin() + stride + forcegroups_, static_cast<real_type>(0));
+            forcepartialpending_ = false;
+        }
+
+        if (kinetic) {
+            auto const first = partial_.begin() + 2 * stride;
+            Uk_ = std::accumulate(first, first + globalworksize() / moveworksize_, static_cast<real_type>(0));
+        }
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::LoadTuning()
+    {
+        std::ifstream ifs(TuningPath());
+        if (!ifs) {
+            return;
+        }
+
+        // 使えないワークグループの大きさが書かれていれば、その種類のカーネルは既定の大きさのままにする
+        auto const usable = [this](compute::kernel const & kernel, std::int32_t localworksize) {
+            auto const localworksizes = LocalWorkSizes(kernel);
+            return std::find(localworksizes.begin(), localworksizes.end(), localworksize) != localworksizes.end();
+        };
+
+        std::array<compute::kernel const *, 4> const kernels = { { &kernel_force_, &kernel_force_tiled_, &kernel_force_linkedcell_, &kernel_force_verletlist_ } };
+
+        std::string name;
+        std::int32_t value;
+        while (ifs >> name >> value) {
+            if (name == "tiledforce") {
+                tiledforce_ = value != 0;
+            }
+            else if (name == "move_atoms" && usable(kernel_move_atoms_, value)) {
+                moveworksize_ = value;
+            }
+            else {
+                for (auto i = 0U; i < kernels.size(); i++) {
+                    if (name == Ar_moleculardynamics::FORCEKERNELNAME[i] && usable(*kernels[i], value)) {
+                        forceworksize_[i] = value;
+                    }
+                }
+            }
+        }
+
+        kernel_force_tiled_.set_arg(3, compute::local_buffer<real4_type>(forceworksize_[static_cast<std::size_t>(ForceKernelType::AllPairsTiled)]));
+
+        autotuned_ = true;
+    }
+
+    template <typename T>
+    std::vector<std::int32_t> Ar_moleculardynamics<T>::LocalWorkSizes(compute::kernel const & kernel) const
+    {
+        auto const maxsize = std::min(
+            device_.max_work_group_size(),
+            kernel.get_work_group_info<std::size_t>(device_, CL_KERNEL_WORK_GROUP_SIZE));
+
+        // ワークグループ内の総和は2の累乗の大きさを仮定している
+        // （グローバルワークサイズはLOCALWORKSIZEの倍数なので、どの大きさでも割り切れる）
+        std::vector<std::int32_t> localworksizes;
+        for (auto localworksize = static_cast<std::int32_t>(Ar_moleculardynamics::MINLOCALWORKSIZE);
+             localworksize <= Ar_moleculardynamics::LOCALWORKSIZE;
+             localworksize *= 2) {
+            if (static_cast<std::size_t>(localworksize) <= maxsize) {
+                localworksizes.push_back(localworksize);
+            }
+        }
+
+        return localworksizes;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::MD_initPos()
+    {
+        T sx, sy, sz;
+        auto n = 0;
+
+        for (auto i = 0; i < Nc_; i++) {
+            for (auto j = 0; j < Nc_; j++) {
+                for (auto k = 0; k < Nc_; k++) {
+                    // 基本セルをコピーする
+                    sx = static_cast<T>(i) * lat_;
+                    sy = static_cast<T>(j) * lat_;
+                    sz = static_cast<T>(k) * lat_;
+
+                    // 基本セル内には4つの原子がある
+                    r_[n][0] = sx;
+                    r_[n][1] = sy;
+                    r_[n][2] = sz;
+                    n++;
+
+                    r_[n][0] = 0.5 * lat_ + sx;
+                    r_[n][1] = 0.5 * lat_ + sy;
+                    r_[n][2] = sz;
+                    n++;
+
+                    r_[n][0] = sx;
+                    r_[n][1] = 0.5 * lat_ + sy;
+                    r_[n][2] = 0.5 * lat_ + sz;
+                    n++;
+
+                    r_[n][0] = 0.5 * lat_ + sx;
+                    r_[n][1] = sy;
+                    r_[n][2] = 0.5 * lat_ + sz;
+                    n++;
+                }
+            }
+        }
+
+        NumAtom_ = n;
+
+        // move the center of mass to the origin
+        // 系の重心を座標系の原点とする
+        sx = 0.0;
+        sy = 0.0;
+        sz = 0.0;
+
+        for (auto n = 0; n < NumAtom_; n++) {
+            sx += r_[n][0];
+            sy += r_[n][1];
+            sz += r_[n][2];
+        }
+
+        sx /= static_cast<T>(NumAtom_);
+        sy /= static_cast<T>(NumAtom_);
+        sz /= static_cast<T>(NumAtom_);
+
+        for (auto n = 0; n < NumAtom_; n++) {
+            r_[n][0] -= sx;
+            r_[n][1] -= sy;
+            r_[n][2] -= sz;
+        }
+
+        // 原子座標を複製
+        r_clone_ = r_;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::MD_initVel()
+    {
+        auto const v = std::sqrt(3.0 * Tg_);
+
+        myrandom::MyRand mr(-1.0, 1.0);
+
+        for (auto n = 0; n < NumAtom_; n++) {
+            T rndX = mr.myrand();
+            T rndY = mr.myrand();
+            T rndZ = mr.myrand();
+            T const tmp = 1.0 / std::sqrt(norm2(rndX, rndY, rndZ));
+            rndX *= tmp;
+            rndY *= tmp;
+            rndZ *= tmp;
+
+            // 方向はランダムに与える
+            V_[n][0] = v * rndX;
+            V_[n][1] = v * rndY;
+            V_[n][2] = v * rndZ;
+        }
+
+        auto sx = 0.0;
+        auto sy = 0.0;
+        auto sz = 0.0;
+
+        for (auto n = 0; n < NumAtom_; n++) {
+            sx += V_[n][0];
+            sy += V_[n][1];
+            sz += V_[n][2];
+        }
+
+        sx /= static_cast<T>(NumAtom_);
+        sy /= static_cast<T>(NumAtom_);
+        sz /= static_cast<T>(NumAtom_);
+
+        // 重心の並進運動を避けるために、速度の和がゼロになるように補正
+        for (auto n = 0; n < NumAtom_; n++) {
+            V_[n][0] -= sx;
+            V_[n][1] -= sy;
+            V_[n][2] -= sz;
+        }
+
+        // 速度の配列を複製
+        V_clone_ = V_;
+    }
 
     template <typename T>
-    void Ar_moleculardynamics<T>::Calc_Forces(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::OpenCl)>)
+    void Ar_moleculardynamics<T>::ModLattice()
     {
-        // ホスト→デバイス
-        compute::copy(r_.begin(), r_.end(), r_dev_.begin(), queue_);
+        // initalize parameters
+        lat_ = std::pow(2.0, 2.0 / 3.0) * scale_;
+
+        MD_iter_ = 1;
+
+        // ホスト側の配列は原子数ちょうどの大きさにする
+        NumAtom_ = Nc_ * Nc_ * Nc_ * 4;
+        F_.resize(NumAtom_);
+        forcecleared_ = false;
+        r_.resize(NumAtom_);
+        r1_.resize(NumAtom_);
+        V_.resize(NumAtom_);
+
+        MD_initPos();
+        MD_initVel();
+
+        periodiclen_ = lat_ * static_cast<T>(Nc_);
+
+        // デバイス側の配列は、グローバルワークサイズ（ワークグループの大きさの倍数）の大きさにする
+        // （容量が足りていれば確保し直さないので、原子数を減らしてから戻しても確保し直さない）
+        // 座標・速度・力の配列は、SoAの場合はこの大きさのx, y, z成分のブロックを三つ並べる
+        auto const globalsize = static_cast<std::size_t>(globalworksize());
+        auto const particlesize = globalsize * ParticleStore<real_type>::DEVICEBLOCKS;
+        for (auto dev : { &F_dev_, &particletmp_dev_, &r_dev_, &r1_dev_, &rref_dev_, &V_dev_ }) {
+            dev->resize(particlesize, queue_);
+        }
+
+        for (auto dev : { &atomcell_dev_, &perm_dev_, &perminv_dev_, &permtmp_dev_, &sortindex_dev_ }) {
+            dev->resize(globalsize, queue_);
+        }
+
+        neighborstart_dev_.resize(NumAtom_ + 1, queue_);
+
+        // ワークグループごとの部分和も使い回す
+        // （ワークグループの大きさを変えても確保し直さなくて済むように、最も小さいときの個数だけ確保する）
+        partial_.resize(4 * partialstride());
+        partial_dev_.resize(partial_.size(), queue_);
+
+        // 複数のデバイスを使う場合は、ワークグループの大きさの最大値を単位として原子をデバイスの数で分割する
+        // （切り上げて分けるので、原子が少なくて空になるのは後ろのデバイス）
+        auto const ngroup = globalworksize() / Ar_moleculardynamics::LOCALWORKSIZE;
+        auto const nslab = static_cast<std::int32_t>(slabs_.size());
+        for (auto i = 0; i < nslab; i++) {
+            auto & slab = slabs_[i];
+            slab.begin = (ngroup * i + nslab - 1) / nslab * Ar_moleculardynamics::LOCALWORKSIZE;
+            slab.end = (ngroup * (i + 1) + nslab - 1) / nslab * Ar_moleculardynamics::LOCALWORKSIZE;
+
+            for (auto dev : { &slab.F, &slab.r, &slab.r1, &slab.rref, &slab.V }) {
+                dev->resize(particlesize, slab.queue);
+            }
+
+            slab.neighborstart.resize(NumAtom_ + 1, slab.queue);
+            slab.partial.resize(partial_.size(), slab.queue);
+            slab.partialhost.resize(partial_.size());
+        }
+
+        // 最も近いイメージとの距離は周期境界条件の長さの半分以下なので、
+        // そこから±ncp_個のイメージまで考慮すれば、カットオフ半径内の全てのイメージを含む
+        // カットオフ半径が周期境界条件の長さの半分未満なら、ncp_ = 0（最小イメージ規約）となる
+        ncp_ = static_cast<std::int32_t>(std::floor(rc_ / periodiclen_ + 0.5));
+
+        // セルの分割を決める
+        linkedcell_.setup(periodiclen_, rc_);
+
+        // 新しい系はホスト側にだけあり、近接リストやセルの並びは作り直す
+        binned_ = false;
+        devicecurrent_ = false;
+        hostcurrent_ = true;
+        slabcurrent_ = false;
+        ukcurrent_ = false;
+        disp2pending_ = false;
+        rebuildverletlist_ = true;
+
+        // 前の系の全エネルギーとは比較しない
+        exacttrace_.clear();
+
+        // 新しい系の配列は、時間発展で受け持つNUMAノードのメモリに置き直す
+        FirstTouch();
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::FirstTouch()
+    {
+        if (!tbbaffinity_.enabled()) {
+            return;
+        }
+
+        auto const start = tbb::tick_count::now();
+
+        // 確保しただけの新しい配列に、時間発展と同じ分割で各NUMAノードのスレッドから値をコピーする
+        // （ページは最初に書き込んだスレッドのノードに置かれる）
+        for (auto store : { &F_, &r_, &r1_, &V_ }) {
+            ParticleStore<real_type> homed;
+            homed.resize_uninitialized(NumAtom_);
+
+            tbbaffinity_.parallel_for(
+                NumAtom_,
+                TbbAffinity::ATOMLOOP,
+                [store, &homed](auto const & range) {
+                    homed.copy_range(*store, range.begin(), range.end());
+            });
+
+            *store = std::move(homed);
+        }
+
+        tbbfirsttouchtime_ += (tbb::tick_count::now() - start).seconds();
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::Move_Atoms_MultiDevice()
+    {
+        UseSlabState();
+
+        // 速度が前のステップの時間発展のカーネルで求めたものでなければ、運動エネルギーの部分和を求め直す
+        if (!ukcurrent_) {
+            for (auto & slab : slabs_) {
+                if (!slab.empty()) {
+                    EnqueueSlabKernel(slab, slab.kinetic, moveworksize_);
+                }
+            }
+        }
+
+        // 時間発展のカーネルが運動エネルギーの部分和を上書きするので、その前に全てのデバイスの部分和を読み込む
+        ReadSlabPartials(true);
+
+        auto const lagged = uselaggedthermostat();
+        if (!lagged) {
+            // 全エネルギーの出力と温度の計算
+            OutputEnergy(openclofs_, 0.0);
+        }
+
+        // calculate temperture
+        auto const s = thermostatscale();
+
+        auto const displacement = useverletlist() && !rebuildverletlist_;
+        for (auto & slab : slabs_) {
+            if (slab.empty()) {
+                continue;
+            }
+
+            // 最初のステップだけ修正Euler法、それ以降はVerlet法で時間発展
+            auto & kernel = MD_iter_ == 1 ? slab.move_atoms1 : slab.move_atoms;
+            kernel.set_args(
+                slab.r,
+                slab.r1,
+                slab.V,
+                slab.F,
+                static_cast<real_type>(Ar_moleculardynamics::DT),
+                s,
+                slab.partial);
+
+            EnqueueSlabKernel(slab, kernel, moveworksize_);
+
+            // 周期境界条件のチェック
+            EnqueueSlabKernel(slab, slab.check_periodic, moveworksize_);
+
+            if (displacement) {
+                // 近接リストを構築した時点からの原子の変位を計算
+                EnqueueSlabKernel(slab, slab.displacement, moveworksize_);
+            }
+        }
+
+        // 次のステップの力の計算のために、全てのデバイスに全ての原子の座標を揃える
+        ExchangePositions();
+
+        if (displacement) {
+            // 全てのデバイスの原子の最大変位から、近接リストの再構築が必要かどうかを判定する
+            auto const start = tbb::tick_count::now();
+            auto const stride = partialstride();
+            auto maxdisp2 = static_cast<real_type>(0);
+            for (auto & slab : slabs_) {
+                if (slab.empty()) {
+                    continue;
+                }
+
+                auto const ngroup = (slab.end - slab.begin) / moveworksize_;
+                slab.queue.enqueue_read_buffer(
+                    slab.partial.get_buffer(),
+                    3 * stride * sizeof(real_type),
+                    ngroup * sizeof(real_type),
+                    slab.partialhost.data() + 3 * stride);
+
+                auto const first = slab.partialhost.begin() + 3 * stride;
+                maxdisp2 = std::max(maxdisp2, *std::max_element(first, first + ngroup));
+            }
+            hostwaittime_ += (tbb::tick_count::now() - start).seconds();
+
+            CheckVerletList(static_cast<T>(maxdisp2));
+        }
+
+        if (lagged) {
+            // 一つ前のステップの温度で時間発展した後で、全エネルギーの出力と温度の計算を行う
+            OutputEnergy(openclofs_, s);
+        }
+
+        // 時間発展のカーネルが、次のステップの運動エネルギーの部分和を求めている
+        ukcurrent_ = true;
+
+        // デバイス→ホスト
+        if (!deviceresident_) {
+            UseHostState();
+        }
+
+        openclsteps_++;
+        MD_iter_++;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::Move_Atoms_Tbb(std::ofstream & ofs)
+    {
+        // OpenCLで計算した結果がデバイス側にあれば、ホスト側に戻す
+        UseHostState();
+
+        // 一つ前のステップの温度を用いる場合は、運動エネルギーを時間発展のループの中で求める
+        auto const lagged = uselaggedthermostat();
+
+        // 運動エネルギーの初期化
+        Uk_ = 0.0;
+
+        if (!lagged) {
+            // 運動エネルギーの計算
+            Uk_ = Calc_Kinetic_Energy_Tbb();
+
+            // 全エネルギーの出力と温度の計算
+            OutputEnergy(ofs, 0.0);
+        }
+
+        // calculate temperture
+        auto const s = thermostatscale();
+
+        auto const Uk = Integrate_Tbb(s, lagged);
+
+        if (lagged) {
+            // 全エネルギーの出力と温度の計算
+            Uk_ = Uk;
+            OutputEnergy(ofs, s);
+        }
+
+        MD_iter_++;
+    }
+
+    template <typename T>
+    typename Ar_moleculardynamics<T>::real_type Ar_moleculardynamics<T>::Calc_Kinetic_Energy_Tbb()
+    {
+        // フローグラフでは力の計算と同時に実行されるので、力の計算とは別のaffinity_partitionerを用いる
+        auto const Uk = tbbaffinity_.parallel_reduce(
+            NumAtom_,
+            TbbAffinity::KINETICLOOP,
+            static_cast<real_type>(0),
+            [this](auto const & range, real_type Uk) {
+                for (auto && n = range.begin(); n != range.end(); ++n) {
+                    Uk += norm2(V_[n][0], V_[n][1], V_[n][2]);
+                }
+
+                return Uk;
+            },
+            std::plus<real_type>());
+
+        return 0.5 * Uk;
+    }
+
+    template <typename T>
+    typename Ar_moleculardynamics<T>::real_type Ar_moleculardynamics<T>::Integrate_Tbb(real_type s, bool lagged)
+    {
+        // 最初のステップだけ修正Euler法で時間発展
+        auto const euler = MD_iter_ == 1;
+
+        // 近接リストを使う場合は、構築した時点からの原子の最大変位も同じループで求める
+        auto const checkdisplacement = useverletlist() && !rebuildverletlist_;
+
+        // 時間発展・周期境界条件の処理・次のステップの力の初期化を、各原子について一度に行う
+        // （運動エネルギーの和と最大変位の二乗を同時に求める）
+        auto const result = tbbaffinity_.parallel_reduce(
+            NumAtom_,
+            TbbAffinity::ATOMLOOP,
+            std::make_pair(static_cast<real_type>(0), static_cast<T>(0)),
+            [this, s, lagged, euler, checkdisplacement](auto const & range, std::pair<real_type, T> result) {
+                for (auto && n = range.begin(); n != range.end(); ++n) {
+                    if (euler) {
+                        // update the coordinates by the second order Euler method
+                        r1_.set(n, r_.get(n));
+
+                        // scaling of velocity
+                        V_[n][0] *= s;
+                        V_[n][1] *= s;
+                        V_[n][2] *= s;
+
+                        // update coordinates and velocity
+                        r_[n][0] += Ar_moleculardynamics::DT * V_[n][0] + 0.5 * F_[n][0] * dt2;
+                        r_[n][1] += Ar_moleculardynamics::DT * V_[n][1] + 0.5 * F_[n][1] * dt2;
+                        r_[n][2] += Ar_moleculardynamics::DT * V_[n][2] + 0.5 * F_[n][2] * dt2;
+
+                        V_[n][0] += Ar_moleculardynamics::DT * F_[n][0];
+                        V_[n][1] += Ar_moleculardynamics::DT * F_[n][1];
+                        V_[n][2] += Ar_moleculardynamics::DT * F_[n][2];
+                    }
+                    else {
+                        // update the coordinates by the Verlet method
+                        if (lagged) {
+                            // 更新する前の速度から運動エネルギーを計算
+                            result.first += norm2(V_[n][0], V_[n][1], V_[n][2]);
+                        }
+
+                        auto const rtmp = r_.get(n);
+#ifdef NVE
+                        r_[n][0] = 2.0 * r_[n][0] - r1_[n][0] + F_[n][0] * dt2;
+                        r_[n][1] = 2.0 * r_[n][1] - r1_[n][1] + F_[n][1] * dt2;
+                        r_[n][2] = 2.0 * r_[n][2] - r1_[n][2] + F_[n][2] * dt2;
+#else
+                        // update coordinates and velocity
+                        // Verlet法の座標更新式において速度成分を抜き出し、その部分をスケールする
+                        r_[n][0] += s * (r_[n][0] - r1_[n][0]) + F_[n][0] * dt2;
+                        r_[n][1] += s * (r_[n][1] - r1_[n][1]) + F_[n][1] * dt2;
+                        r_[n][2] += s * (r_[n][2] - r1_[n][2]) + F_[n][2] * dt2;
+#endif
+
+                        V_[n][0] = 0.5 * (r_[n][0] - r1_[n][0]) / Ar_moleculardynamics::DT;
+                        V_[n][1] = 0.5 * (r_[n][1] - r1_[n][1]) / Ar_moleculardynamics::DT;
+                        V_[n][2] = 0.5 * (r_[n][2] - r1_[n][2]) / Ar_moleculardynamics::DT;
+
+                        r1_.set(n, rtmp);
+                    }
+
+                    // consider the periodic boundary condination
+                    // セルの外側に出たら座標をセル内に戻す
+                    for (auto i = 0; i < 3; i++) {
+                        if (r_[n][i] > periodiclen_) {
+                            r_[n][i] -= periodiclen_;
+                            r1_[n][i] -= periodiclen_;
+                        }
+                        else if (r_[n][i] < 0.0) {
+                            r_[n][i] += periodiclen_;
+                            r1_[n][i] += periodiclen_;
+                        }
+                    }
+
+                    if (checkdisplacement) {
+                        result.second = std::max(result.second, verletlist_.displacement2(n, r_[n][0], r_[n][1], r_[n][2]));
+                    }
+
+                    // この原子に働く力はもう使わないので、次のステップのためにゼロにしておく
+                    F_[n][0] = static_cast<T>(0);
+                    F_[n][1] = static_cast<T>(0);
+                    F_[n][2] = static_cast<T>(0);
+                }
+
+                return result;
+            },
+            [](auto const & x, auto const & y) {
+                return std::make_pair(x.first + y.first, std::max(x.second, y.second));
+            });
+
+        forcecleared_ = true;
+
+        if (checkdisplacement) {
+            // 近接リストの再構築が必要かどうかを判定
+            CheckVerletList(result.second);
+        }
+
+        return 0.5 * result.first;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::ReadSlabPartials(bool kinetic)
+    {
+        auto const start = tbb::tick_count::now();
+
+        auto const stride = partialstride();
+        auto Up = static_cast<real_type>(0);
+        auto W = static_cast<real_type>(0);
+        auto Uk = static_cast<real_type>(0);
+
+        for (auto & slab : slabs_) {
+            if (slab.empty()) {
+                continue;
+            }
+
+            // キューは順序通りに実行されるので、読み込みはそのデバイスの全てのカーネルの完了を待つ
+            auto const movegroups = (slab.end - slab.begin) / moveworksize_;
+            auto const last = kinetic ? 2 * stride + movegroups : stride + slab.forcegroups;
+            slab.queue.enqueue_read_buffer(slab.partial.get_buffer(), 0, last * sizeof(real_type), slab.partialhost.data());
+
+            auto const first = slab.partialhost.begin();
+            Up = std::accumulate(first, first + slab.forcegroups, Up);
+            W = std::accumulate(first + stride, first + stride + slab.forcegroups, W);
+            if (kinetic) {
+                Uk = std::accumulate(first + 2 * stride, first + 2 * stride + movegroups, Uk);
+            }
+        }
+
+        hostwaittime_ += (tbb::tick_count::now() - start).seconds();
+
+        Up_ = Up;
+        virial_ = W;
+        if (kinetic) {
+            Uk_ = Uk;
+        }
+    }
+
+    template <typename T>
+    std::string Ar_moleculardynamics<T>::KernelOptions() const
+    {
+        // 浮動小数点数は丸め誤差が出ないように16進数で書く（floatならfを付ける）
+        auto const literal = [](auto value) {
+            std::ostringstream oss;
+            oss << std::hexfloat << value << (std::is_same<decltype(value), float>::value ? "f" : "");
+            return oss.str();
+        };
+
+        // ループの回数や周期境界条件の長さ、カットオフ半径を定数にすると、
+        // コンパイラがループを展開したり、除算を乗算に置き換えたりできる
+        // （PARTICLESTRIDEは、SoAの場合の座標・速度・力の配列のx, y, z成分のブロックの長さ）
+        auto options = (boost::format("-DNCP=%d -DNUMATOM=%d -DPARTIALSTRIDE=%d -DPARTICLESTRIDE=%d -DPERIODICLEN=%s -DRC2=%s -DVRC=%s") %
+            ncp_ %
+            NumAtom_ %
+            partialstride() %
+            globalworksize() %
+            literal(periodiclen_) %
+            literal(rc2_) %
+            literal(Vrc_)).str();
+
+        if (fastmath_) {
+            options += " -cl-fast-relaxed-math -cl-mad-enable";
+        }
+
+        return options;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::RebalanceHybrid(std::int32_t split, double cputime, double devicetime)
+    {
+        hybridatoms_[0] += NumAtom_ - split;
+        hybridatoms_[1] += split;
+        hybridtime_[0] += cputime;
+        hybridtime_[1] += devicetime;
+        hybridtotaltime_[0] += cputime;
+        hybridtotaltime_[1] += devicetime;
+        hybridsteps_++;
+
+        if (++hybridwindow_ < Ar_moleculardynamics::HYBRIDREBALANCEINTERVAL) {
+            return;
+        }
+
+        // 1秒あたりに計算できた原子数の比から、TBBとOpenCLとが同時に終わる分け方を求める
+        // （片方の側が原子を受け持たなかった場合は測れないので、そのままにする）
+        if (hybridtime_[0] > 0.0 && hybridtime_[1] > 0.0 && hybridatoms_[0] > 0 && hybridatoms_[1] > 0) {
+            auto const cpurate = static_cast<double>(hybridatoms_[0]) / hybridtime_[0];
+            auto const devicerate = static_cast<double>(hybridatoms_[1]) / hybridtime_[1];
+
+            // 測定のばらつきで分け方が振動しないように、実際に用いた割合との平均を取る
+            auto const ratio = static_cast<double>(hybridatoms_[1]) / static_cast<double>(hybridatoms_[0] + hybridatoms_[1]);
+            hybridratio_ = 0.5 * (ratio + devicerate / (cpurate + devicerate));
+            hybridrebalances_++;
+        }
+
+        auto const window = static_cast<double>(hybridwindow_);
+        hybridsplitofs_ << boost::format("MD step = %d, TBB : OpenCL = %d : %d 原子 (%.3f ms : %.3f ms), OpenCLの割合 = %.4f\n") %
+            MD_iter_ %
+            (NumAtom_ - split) %
+            split %
+            (hybridtime_[0] / window * 1000.0) %
+            (hybridtime_[1] / window * 1000.0) %
+            hybridratio_;
+
+        hybridatoms_.fill(0);
+        hybridtime_.fill(0.0);
+        hybridwindow_ = 0;
+    }
+
+    template <typename T>  
+    void Ar_moleculardynamics<T>::SetKernel()
+    {
+        using namespace boost::compute;
+
+        // シミュレーションの定数はビルドオプションで埋め込む（プログラムのキャッシュのキーにも含まれる）
+        kerneloptions_ = KernelOptions();
+
+        // 原子の組の計算に用いる型（pair_t）と、座標・速度・力およびエネルギーの足し合わせに用いる型（real_t）
+        auto const real_source = (boost::format(
+            "%1%typedef %2% pair_t;\n"
+            "typedef %2%4 pair4_t;\n"
+            "#define convert_pair4_t convert_%2%4\n"
+            "typedef %3% real_t;\n"
+            "typedef %3%4 real4_t;\n"
+            "#define convert_real4_t convert_%3%4\n") %
+            (Ar_moleculardynamics::usefp64() ? "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n" : "") %
+            DeviceType<T>::name() %
+            DeviceType<real_type>::name()).str();
+
+        // 座標・速度・力の配列の要素の型（particle_t）と、n個目の原子のベクトルを読み書きする関数
+        // （SoAの場合は、x, y, z成分をPARTICLESTRIDEずつ離れたブロックに分けて置き、ワークアイテムが連続した位置を読み書きするようにする）
+        // 後に続くソースの#defineが行頭に来るように、改行で終える
+        auto const particle_source = (DEFAULTPARTICLELAYOUT == ParticleLayout::SoA ?
+            std::string("typedef real_t particle_t;\n") + BOOST_COMPUTE_STRINGIZE_SOURCE(real4_t load_particle(__global __const particle_t a[], int n)
+        {
+            real4_t v;
+            v.x = a[n];
+            v.y = a[PARTICLESTRIDE + n];
+            v.z = a[2 * PARTICLESTRIDE + n];
+            v.w = 0.0f;
+
+            return v;
+        }
+
+        void store_particle(__global particle_t a[], int n, real4_t v)
+        {
+            a[n] = v.x;
+            a[PARTICLESTRIDE + n] = v.y;
+            a[2 * PARTICLESTRIDE + n] = v.z;
+        }) :
+            std::string("typedef real4_t particle_t;\n") + BOOST_COMPUTE_STRINGIZE_SOURCE(real4_t load_particle(__global __const particle_t a[], int n)
+        {
+            return a[n];
+        }
+
+        void store_particle(__global particle_t a[], int n, real4_t v)
+        {
+            a[n] = v;
+        })) + "\n";
+
+        // ワークグループ内の総和（最大値）を求め、ワークグループごとの部分和（最大値）を書き込む（ワークグループの大きさは2の累乗で、LOCALWORKSIZE以下）
+        auto const group_sum_source = (boost::format("#define LOCALWORKSIZE %d\n") % static_cast<std::int32_t>(Ar_moleculardynamics::LOCALWORKSIZE)).str() +
+            BOOST_COMPUTE_STRINGIZE_SOURCE(void group_sum(real_t x, __local real_t * scratch, __global real_t * partial)
+        {
+            int const lid = get_local_id(0);
+
+            scratch[lid] = x;
+            barrier(CLK_LOCAL_MEM_FENCE);
+
+            for (int i = get_local_size(0) / 2; i > 0; i >>= 1) {
+                if (lid < i) {
+                    scratch[lid] += scratch[lid + i];
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+            }
+
+            if (lid == 0) {
+                *partial = scratch[0];
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        }
+
+        void group_max(real_t x, __local real_t * scratch, __global real_t * partial)
+        {
+            int const lid = get_local_id(0);
+
+            scratch[lid] = x;
+            barrier(CLK_LOCAL_MEM_FENCE);
 
-        compute::fill(F_dev_.begin(), F_dev_.end(), compute::float4_(0.0f), queue_);
-        compute::fill(Up_dev_.begin(), Up_dev_.end(), 0.0f, queue_);
-        
-        //// 各原子に働く力とポテンシャルエネルギーを計算
-        auto const event_force = queue_.enqueue_1d_range_kernel(
-            kernel_force_,
-            0,
-            NumAtom_,
-            Ar_moleculardynamics::LOCALWORKSIZE);
-        event_force.wait();
+            for (int i = get_local_size(0) / 2; i > 0; i >>= 1) {
+                if (lid < i) {
+                    scratch[lid] = fmax(scratch[lid], scratch[lid + i]);
+                }
+                barrier(CLK_LOCAL_MEM_FENCE);
+            }
 
-        // ポテンシャルエネルギーを計算
-        Up_ = compute::accumulate(Up_dev_.begin(), Up_dev_.end(), 0.0f, queue_);
-        
-        // デバイス→ホスト
-        compute::copy(F_dev_.begin(), F_dev_.end(), F_.begin(), queue_);
-    }
+            if (lid == 0) {
+                *partial = scratch[0];
+            }
+            barrier(CLK_LOCAL_MEM_FENCE);
+        });
 
-    template <typename T>
-    void Ar_moleculardynamics<T>::Calc_Forces(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Tbb)>)
-    {
-        // 各原子に働く力の初期化
-        for (auto n = 0; n < NumAtom_; n++) {
-            F_[n][0] = static_cast<T>(0);
-            F_[n][1] = static_cast<T>(0);
-            F_[n][2] = static_cast<T>(0);
-        }
+        auto const check_periodic_source = BOOST_COMPUTE_STRINGIZE_SOURCE(kernel void check_periodic(
+            __global particle_t r[],
+            __global particle_t r1[])
+        {
+            int const n = get_global_id(0);
 
-        // ポテンシャルエネルギーの初期化
-        tbb::combinable<T> Up;
+            // グローバルワークサイズはワークグループの大きさの倍数に切り上げてあるので、余った分は何もしない
+            if (n >= NUMATOM) {
+                return;
+            }
 
-        tbb::parallel_for(
-            tbb::blocked_range<std::int32_t>(0, NumAtom_),
-            [this, &Up](auto const & range) {
-                for (auto && n = range.begin(); n != range.end(); ++n) {
-                    for (auto m = 0; m < NumAtom_; m++) {
-
-                        // ±ncp_分のセル内の原子との相互作用を計算
-                        for (auto i = -ncp_; i <= ncp_; i++) {
-                            for (auto j = -ncp_; j <= ncp_; j++) {
-                                for (auto k = -ncp_; k <= ncp_; k++) {
-                                    auto const sx = static_cast<T>(i) * periodiclen_;
-                                    auto const sy = static_cast<T>(j) * periodiclen_;
-                                    auto const sz = static_cast<T>(k) * periodiclen_;
-
-                                    // 自分自身との相互作用を排除
-                                    if (n != m || i != 0 || j != 0 || k != 0) {
-                                        auto const dx = r_[n][0] - (r_[m][0] + sx);
-                                        auto const dy = r_[n][1] - (r_[m][1] + sy);
-                                        auto const dz = r_[n][2] - (r_[m][2] + sz);
-
-                                        auto const r2 = norm2(dx, dy, dz);
-                                        // 打ち切り距離内であれば計算
-                                        if (r2 <= rc2_) {
-                                            auto const r = std::sqrt(r2);
-                                            auto const rm6 = 1.0 / (r2 * r2 * r2);
-                                            auto const rm7 = rm6 / r;
-                                            auto const rm12 = rm6 * rm6;
-                                            auto const rm13 = rm12 / r;
-
-                                            auto const Fr = 48.0 * rm13 - 24.0 * rm7;
-
-                                            F_[n][0] += dx / r * Fr;
-                                            F_[n][1] += dy / r * Fr;
-                                            F_[n][2] += dz / r * Fr;
-
-                                            // エネルギーの計算、ただし二重計算のために0.5をかけておく
-                                            Up.local() += 0.5 * (4.0 * (rm12 - rm6) - Vrc_);
-                                        }
-                                    }
+            real4_t rn = load_particle(r, n);
+            real4_t r1n = load_particle(r1, n);
+
+            if (rn.x > PERIODICLEN) {
+                rn.x -= PERIODICLEN;
+                r1n.x -= PERIODICLEN;
+            }
+            else if (rn.x < 0.0f) {
+                rn.x += PERIODICLEN;
+                r1n.x += PERIODICLEN;
+            }
+
+            if (rn.y > PERIODICLEN) {
+                rn.y -= PERIODICLEN;
+                r1n.y -= PERIODICLEN;
+            }
+            else if (rn.y < 0.0f) {
+                rn.y += PERIODICLEN;
+                r1n.y += PERIODICLEN;
+            }
+
+            if (rn.z > PERIODICLEN) {
+                rn.z -= PERIODICLEN;
+                r1n.z -= PERIODICLEN;
+            }
+            else if (rn.z < 0.0f) {
+                rn.z += PERIODICLEN;
+                r1n.z += PERIODICLEN;
+            }
+
+            store_particle(r, n, rn);
+            store_particle(r1, n, r1n);
+        });
+
+        kernel_check_periodic_ = programcache_.create(real_source + particle_source + check_periodic_source, "check_periodic", kerneloptions_);
+        kernel_check_periodic_.set_args(r_dev_, r1_dev_);
+
+        auto const displacement_source = BOOST_COMPUTE_STRINGIZE_SOURCE(kernel void displacement(
+            __global real_t partial[],
+            __global __const particle_t r[],
+            __global __const particle_t rref[])
+        {
+            __local real_t scratch[LOCALWORKSIZE];
+
+            int const n = get_global_id(0);
+
+            // 最小イメージ規約に従って変位を求める（余ったワークアイテムも、ワークグループ内の最大値を求めるのには加わる）
+            real4_t d = n < NUMATOM ? load_particle(r, n) - load_particle(rref, n) : (real4_t)(0.0f);
+            d -= (real4_t)(PERIODICLEN) * rint(d / (real4_t)(PERIODICLEN));
+            d.w = 0.0f;
+
+            // 変位の二乗のワークグループごとの最大値
+            group_max(dot(d, d), scratch, &partial[3 * PARTIALSTRIDE + get_group_id(0)]);
+        });
+
+        kernel_displacement_ = programcache_.create(real_source + particle_source + group_sum_source + displacement_source, "displacement", kerneloptions_);
+        kernel_displacement_.set_args(partial_dev_, r_dev_, rref_dev_);
+
+        // ホスト側のPairPotentialと同じ方法で、力の大きさを距離で割ったものとポテンシャルエネルギーを求める
+        // potential = 0: 元の式、1: r^2の式、2: スプライン補間（r2min未満はr^2の式）
+        std::string const lj_pair_source = BOOST_COMPUTE_STRINGIZE_SOURCE(pair_t lj_pair(
+            pair_t r2,
+            __global __const pair4_t table[],
+            int potential,
+            pair_t r2min,
+            pair_t invdelta,
+            pair_t * u)
+        {
+            if (potential == 2 && r2 >= r2min) {
+                pair_t const x = (r2 - r2min) * invdelta;
+                int const i = (int)(x);
+                pair_t const t = x - (pair_t)(i);
+                pair4_t const cu = table[2 * i];
+                pair4_t const cf = table[2 * i + 1];
+
+                *u = ((cu.w * t + cu.z) * t + cu.y) * t + cu.x;
+                return ((cf.w * t + cf.z) * t + cf.y) * t + cf.x;
+            }
+            else if (potential != 0) {
+                pair_t const rm2 = 1.0f / r2;
+                pair_t const rm6 = rm2 * rm2 * rm2;
+                pair_t const rm12 = rm6 * rm6;
+
+                *u = 4.0f * (rm12 - rm6) - VRC;
+                return rm2 * (48.0f * rm12 - 24.0f * rm6);
+            }
+            else {
+                pair_t const r = sqrt(r2);
+                pair_t const rm6 = 1.0 / (r2 * r2 * r2);
+                pair_t const rm7 = rm6 / r;
+                pair_t const rm12 = rm6 * rm6;
+                pair_t const rm13 = rm12 / r;
+
+                pair_t const Fr = 48.0 * rm13 - 24.0 * rm7;
+
+                *u = 4.0 * (rm12 - rm6) - VRC;
+                return Fr / r;
+            }
+        });
+
+        auto const force_source = BOOST_COMPUTE_STRINGIZE_SOURCE(kernel void force(
+            __global particle_t f[],
+            __global real_t partial[],
+            __global __const particle_t rv[],
+            __global __const pair4_t table[],
+            __const int potential,
+            __const pair_t r2min,
+            __const pair_t invdelta)
+        {
+            __local real_t scratch[LOCALWORKSIZE];
+
+            int const n = get_global_id(0);
+            real4_t const rn = n < NUMATOM ? load_particle(rv, n) : (real4_t)(0.0f);
+            real_t Upn = 0.0f;
+            real_t Wn = 0.0f;
+
+            // 余ったワークアイテムは、ワークグループ内の総和を求めるのにだけ加わる
+            for (int m = 0; n < NUMATOM && m < NUMATOM; m++) {
+                // 最も近いイメージとの距離（原子の組の計算はpair_tで行う）
+                real4_t d0r = rn - load_particle(rv, m);
+                d0r -= (real4_t)(PERIODICLEN) * rint(d0r / (real4_t)(PERIODICLEN));
+                pair4_t d0 = convert_pair4_t(d0r);
+                d0.w = 0.0f;
+
+                // 最も近いイメージから±ncp分のセル内の原子との相互作用を計算
+                // （NCP = 0のときは最小イメージ規約となる）
+                for (int i = -NCP; i <= NCP; i++) {
+                    for (int j = -NCP; j <= NCP; j++) {
+                        for (int k = -NCP; k <= NCP; k++) {
+                            pair4_t s;
+                            s.x = (pair_t)(i) * PERIODICLEN;
+                            s.y = (pair_t)(j) * PERIODICLEN;
+                            s.z = (pair_t)(k) * PERIODICLEN;
+                            s.w = 0.0f;
+
+                            // 自分自身との相互作用を排除
+                            if (n != m || i != 0 || j != 0 || k != 0) {
+                                pair4_t const d = d0 - s;
+
+                                pair_t const r2 = dot(d, d);
+                                // 打ち切り距離内であれば計算
+                                if (r2 <= RC2) {
+                                    pair_t u;
+                                    pair_t const fr = lj_pair(r2, table, potential, r2min, invdelta, &u);
+
+                                    store_particle(f, n, load_particle(f, n) + convert_real4_t(d * (pair4_t)(fr)));
+                                    Upn += 0.5f * u;
+                                    Wn += 0.5f * fr * r2;
                                 }
                             }
                         }
                     }
                 }
+            }
+
+            // ポテンシャルエネルギーとビリアルのワークグループごとの部分和
+            group_sum(Upn, scratch, &partial[get_group_id(0)]);
+            group_sum(Wn, scratch, &partial[PARTIALSTRIDE + get_group_id(0)]);
         });
 
-        Up_ = Up.combine(std::plus<T>());
-    }
-    
-    template <typename T>
-    void Ar_moleculardynamics<T>::getinfo() const
-    {
-        // OpenCLプラットフォーム及びデバイスの情報を表示する
-        // 参考：https://bitbucket.org/aokomoriuta/simd/src/4d86663bf1c4d7d30d5441feca83115e1c7dcaf3/ocl/ocl/ocl.cpp?fileviewer=file-view-default
-        // by 青子守歌様
+        kernel_force_ = programcache_.create(real_source + particle_source + group_sum_source + lj_pair_source + force_source, "force", kerneloptions_);
+        kernel_force_.set_args(
+            F_dev_,
+            partial_dev_,
+            r_dev_);
+
+        auto const force_tiled_source = BOOST_COMPUTE_STRINGIZE_SOURCE(kernel void force_tiled(
+            __global particle_t f[],
+            __global real_t partial[],
+            __global __const particle_t rv[],
+            __local real4_t tile[],
+            __global __const pair4_t table[],
+            __const int potential,
+            __const pair_t r2min,
+            __const pair_t invdelta)
+        {
+            __local real_t scratch[LOCALWORKSIZE];
 
-        std::cout << "== Platform : " << device_.platform().name() << " ==\n";
-        std::cout <<
-        	"Name    : " << device_.platform().get_info<CL_PLATFORM_NAME>() << '\n' <<
-        	"Vendor  : " << device_.platform().get_info<CL_PLATFORM_VENDOR>() << '\n' <<
-        	"Version : " << device_.platform().get_info<CL_PLATFORM_VERSION>() << '\n' ;
+            int const n = get_global_id(0);
+            int const lid = get_local_id(0);
+            int const lsize = get_local_size(0);
+
+            real4_t const rn = n < NUMATOM ? load_particle(rv, n) : (real4_t)(0.0f);
+            real4_t fn = (real4_t)(0.0f);
+            real_t Upn = 0.0f;
+            real_t Wn = 0.0f;
+
+            for (int base = 0; base < NUMATOM; base += lsize) {
+                // ワークグループ内で協調して、lsize個の原子の座標をローカルメモリに読み込む
+                tile[lid] = base + lid < NUMATOM ? load_particle(rv, base + lid) : (real4_t)(0.0f);
+                barrier(CLK_LOCAL_MEM_FENCE);
+
+                int const count = min(lsize, NUMATOM - base);
+                for (int t = 0; n < NUMATOM && t < count; t++) {
+                    int const m = base + t;
+
+                    // 最も近いイメージとの距離（原子の組の計算はpair_tで行う）
+                    real4_t d0r = rn - tile[t];
+                    d0r -= (real4_t)(PERIODICLEN) * rint(d0r / (real4_t)(PERIODICLEN));
+                    pair4_t d0 = convert_pair4_t(d0r);
+                    d0.w = 0.0f;
+
+                    // 最も近いイメージから±ncp分のセル内の原子との相互作用を計算
+                    for (int i = -NCP; i <= NCP; i++) {
+                        for (int j = -NCP; j <= NCP; j++) {
+                            for (int k = -NCP; k <= NCP; k++) {
+                                // 自分自身との相互作用を排除
+                                if (n != m || i != 0 || j != 0 || k != 0) {
+                                    pair4_t s;
+                                    s.x = (pair_t)(i) * PERIODICLEN;
+                                    s.y = (pair_t)(j) * PERIODICLEN;
+                                    s.z = (pair_t)(k) * PERIODICLEN;
+                                    s.w = 0.0f;
+
+                                    pair4_t const d = d0 - s;
+
+                                    pair_t const r2 = dot(d, d);
+                                    // 打ち切り距離内であれば計算
+                                    if (r2 <= RC2) {
+                                        pair_t u;
+                                        pair_t const fr = lj_pair(r2, table, potential, r2min, invdelta, &u);
+
+                                        // レジスタ上で足し合わせる
+                                        fn += convert_real4_t(d * (pair4_t)(fr));
+                                        Upn += 0.5f * u;
+                                        Wn += 0.5f * fr * r2;
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
 
-        std::cout << "== Device : " << device_.name() << " ==\n";
-        std::cout <<
-        	"Name               : " << device_.get_info<CL_DEVICE_NAME>() << '\n' <<
-        	"Vendor             : " << device_.get_info<CL_DEVICE_VENDOR>() <<
-            " (ID:" << device_.get_info<CL_DEVICE_VENDOR_ID>() << ")\n" <<
-        	"Version            : " << device_.get_info<CL_DEVICE_VERSION>() << '\n' <<
-        	"Driver version     : " << device_.get_info<CL_DRIVER_VERSION>() << '\n' <<
-        	"OpenCL C version   : " << device_.get_info<CL_DEVICE_OPENCL_C_VERSION>() << std::endl;
-    }
+                // 次のタイルを読み込む前に、全てのワークアイテムが読み終わるのを待つ
+                barrier(CLK_LOCAL_MEM_FENCE);
+            }
 
-    template <typename T>
-    void Ar_moleculardynamics<T>::Move_Atoms(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::NoParallel)>)
-    {
-        // 運動エネルギーの初期化
-        Uk_ = 0.0;
+            // グローバルメモリへは最後に一度だけ書き込む
+            if (n < NUMATOM) {
+                store_particle(f, n, fn);
+            }
 
-        // 運動エネルギーの計算
-        for (auto n = 0; n < NumAtom_; n++) {
-            Uk_ += norm2(V_[n][0], V_[n][1], V_[n][2]);
+            // ポテンシャルエネルギーとビリアルのワークグループごとの部分和
+            group_sum(Upn, scratch, &partial[get_group_id(0)]);
+            group_sum(Wn, scratch, &partial[PARTIALSTRIDE + get_group_id(0)]);
+        });
+
+        kernel_force_tiled_ = programcache_.create(real_source + particle_source + group_sum_source + lj_pair_source + force_tiled_source, "force_tiled", kerneloptions_);
+        kernel_force_tiled_.set_args(
+            F_dev_,
+            partial_dev_,
+            r_dev_,
+            compute::local_buffer<real4_type>(forceworksize_[static_cast<std::size_t>(ForceKernelType::AllPairsTiled)]));
+
+        auto const cellindex_source = BOOST_COMPUTE_STRINGIZE_SOURCE(
+        int cellindex1(real_t x, int ncell, real_t invcellsize)
+        {
+            int i = (int)(floor(x * invcellsize)) % ncell;
+            if (i < 0) {
+                i += ncell;
+            }
+
+            return i;
         }
-        Uk_ *= 0.5;
 
-        // 全エネルギー（運動エネルギー+ポテンシャルエネルギー）の計算
-        Utot_ = Uk_ + Up_;
+        kernel void cellindex(
+            __global int atomcell[],
+            __global int sortindex[],
+            __global volatile int cellcount[],
+            __global __const particle_t rv[],
+            __const int ncell,
+            __const real_t invcellsize)
+        {
+            int const n = get_global_id(0);
+            if (n >= NUMATOM) {
+                return;
+            }
 
-        //std::cout << boost::format("MD step = %d, 全エネルギー = %.8f\n") % MD_iter_ % Utot_;
-        ofs_ << boost::format("MD step = %d, 全エネルギー = %.8f\n") % MD_iter_ % Utot_;
+            real4_t const rn = load_particle(rv, n);
 
-        // 温度の計算
-        Tc_ = Uk_ / (1.5 * static_cast<T>(NumAtom_));
+            // n個目の原子が属するセルの番号
+            int const c = (cellindex1(rn.x, ncell, invcellsize) * ncell + cellindex1(rn.y, ncell, invcellsize)) * ncell + cellindex1(rn.z, ncell, invcellsize);
 
-        // calculate temperture
-        auto const s = std::sqrt((Tg_ + Ar_moleculardynamics::ALPHA * (Tc_ - Tg_)) / Tc_);
+            atomcell[n] = c;
+            sortindex[n] = n;
+            atomic_inc(&cellcount[c]);
+        });
 
-        switch (MD_iter_) {
-        case 1:
-            // update the coordinates by the second order Euler method
-            // 最初のステップだけ修正Euler法で時間発展
-            for (auto n = 0; n < NumAtom_; n++) {
-                r1_[n] = r_[n];
+        kernel_cellindex_ = programcache_.create(real_source + particle_source + cellindex_source, "cellindex", kerneloptions_);
+
+        auto const force_linkedcell_source = BOOST_COMPUTE_STRINGIZE_SOURCE(kernel void force_linkedcell(
+            __global particle_t f[],
+            __global real_t partial[],
+            __global __const particle_t rv[],
+            __global __const int atomcell[],
+            __global __const int cellstart[],
+            __global __const int neighborcell[],
+            __global __const pair4_t table[],
+            __const int potential,
+            __const pair_t r2min,
+            __const pair_t invdelta)
+        {
+            __local real_t scratch[LOCALWORKSIZE];
 
-                // scaling of velocity
-                V_[n][0] *= s;
-                V_[n][1] *= s;
-                V_[n][2] *= s;
+            int const n = get_global_id(0);
+            int const c = n < NUMATOM ? atomcell[n] * 27 : 0;
+            real4_t const rn = load_particle(rv, n);
+            real4_t fn = (real4_t)(0.0f);
+            real_t Upn = 0.0f;
+            real_t Wn = 0.0f;
+
+            // 自分自身を含む隣接する27個のセル内の原子との相互作用を計算
+            // （原子はセルの番号順に並んでいるので、セル内の原子は連続した位置にある）
+            for (int i = 0; n < NUMATOM && i < 27; i++) {
+                int const nc = neighborcell[c + i];
+
+                for (int m = cellstart[nc]; m < cellstart[nc + 1]; m++) {
+                    // 自分自身との相互作用を排除
+                    if (n != m) {
+                        // 最も近いイメージとの距離を求める（原子の組の計算はpair_tで行う）
+                        real4_t dr = rn - load_particle(rv, m);
+                        dr -= (real4_t)(PERIODICLEN) * rint(dr / (real4_t)(PERIODICLEN));
+                        pair4_t d = convert_pair4_t(dr);
+                        d.w = 0.0f;
+
+                        pair_t const r2 = dot(d, d);
+                        // 打ち切り距離内であれば計算
+                        if (r2 <= RC2) {
+                            pair_t u;
+                            pair_t const fr = lj_pair(r2, table, potential, r2min, invdelta, &u);
+
+                            fn += convert_real4_t(d * (pair4_t)(fr));
+                            Upn += 0.5f * u;
+                            Wn += 0.5f * fr * r2;
+                        }
+                    }
+                }
+            }
 
-                // update coordinates and velocity
-                r_[n][0] += Ar_moleculardynamics::DT * V_[n][0] + 0.5 * F_[n][0] * dt2;
-                r_[n][1] += Ar_moleculardynamics::DT * V_[n][1] + 0.5 * F_[n][1] * dt2;
-                r_[n][2] += Ar_moleculardynamics::DT * V_[n][2] + 0.5 * F_[n][2] * dt2;
+            store_particle(f, n, fn);
 
-                V_[n][0] += Ar_moleculardynamics::DT * F_[n][0];
-                V_[n][1] += Ar_moleculardynamics::DT * F_[n][1];
-                V_[n][2] += Ar_moleculardynamics::DT * F_[n][2];
+            // ポテンシャルエネルギーとビリアルのワークグループごとの部分和
+            group_sum(Upn, scratch, &partial[get_group_id(0)]);
+            group_sum(Wn, scratch, &partial[PARTIALSTRIDE + get_group_id(0)]);
+        });
+
+        kernel_force_linkedcell_ = programcache_.create(real_source + particle_source + group_sum_source + lj_pair_source + force_linkedcell_source, "force_linkedcell", kerneloptions_);
+
+        auto const force_verletlist_source = BOOST_COMPUTE_STRINGIZE_SOURCE(kernel void force_verletlist(
+            __global particle_t f[],
+            __global real_t partial[],
+            __global __const particle_t rv[],
+            __global __const int neighborstart[],
+            __global __const int neighbor[],
+            __global __const pair4_t table[],
+            __const int potential,
+            __const pair_t r2min,
+            __const pair_t invdelta)
+        {
+            __local real_t scratch[LOCALWORKSIZE];
+
+            int const n = get_global_id(0);
+            real4_t const rn = load_particle(rv, n);
+            real4_t fn = (real4_t)(0.0f);
+            real_t Upn = 0.0f;
+            real_t Wn = 0.0f;
+
+            // 近接リストに含まれる原子との相互作用を計算（余ったワークアイテムの近接リストは空とする）
+            int const first = n < NUMATOM ? neighborstart[n] : 0;
+            int const last = n < NUMATOM ? neighborstart[n + 1] : 0;
+            for (int idx = first; idx < last; idx++) {
+                // 最も近いイメージとの距離を求める（原子の組の計算はpair_tで行う）
+                real4_t dr = rn - load_particle(rv, neighbor[idx]);
+                dr -= (real4_t)(PERIODICLEN) * rint(dr / (real4_t)(PERIODICLEN));
+                pair4_t d = convert_pair4_t(dr);
+                d.w = 0.0f;
+
+                pair_t const r2 = dot(d, d);
+                // 打ち切り距離内であれば計算
+                if (r2 <= RC2) {
+                    pair_t u;
+                    pair_t const fr = lj_pair(r2, table, potential, r2min, invdelta, &u);
+
+                    fn += convert_real4_t(d * (pair4_t)(fr));
+                    Upn += 0.5f * u;
+                    Wn += 0.5f * fr * r2;
+                }
             }
-        break;
 
-        default:
-            // update the coordinates by the Verlet method
-            for (auto n = 0; n < NumAtom_; n++) {
-                auto const rtmp = r_[n];
-#ifdef NVE
-                r_[n][0] = 2.0 * r_[n][0] - r1_[n][0] + F_[n][0] * dt2;
-                r_[n][1] = 2.0 * r_[n][1] - r1_[n][1] + F_[n][1] * dt2;
-                r_[n][2] = 2.0 * r_[n][2] - r1_[n][2] + F_[n][2] * dt2;
-#else
+            store_particle(f, n, fn);
+
+            // ポテンシャルエネルギーとビリアルのワークグループごとの部分和
+            group_sum(Upn, scratch, &partial[get_group_id(0)]);
+            group_sum(Wn, scratch, &partial[PARTIALSTRIDE + get_group_id(0)]);
+        });
+
+        kernel_force_verletlist_ = programcache_.create(real_source + particle_source + group_sum_source + lj_pair_source + force_verletlist_source, "force_verletlist", kerneloptions_);
+
+        if (linkedcell_.usable()) {
+            // 隣接するセルの番号はセルの分割が変わらない限り一定なので、最初に転送しておく
+            auto const & neighborcell = linkedcell_.neighborcell();
+            neighborcell_dev_ = compute::vector<std::int32_t>(neighborcell.begin(), neighborcell.end(), queue_);
+            cellcount_dev_ = compute::vector<std::int32_t>(linkedcell_.getNcell() * linkedcell_.getNcell() * linkedcell_.getNcell() + 1, context_);
+            cellstart_dev_ = compute::vector<std::int32_t>(linkedcell_.getNcell() * linkedcell_.getNcell() * linkedcell_.getNcell() + 1, context_);
+
+            kernel_cellindex_.set_args(
+                atomcell_dev_,
+                sortindex_dev_,
+                cellcount_dev_,
+                r_dev_,
+                linkedcell_.getNcell(),
+                static_cast<real_type>(linkedcell_.getInvCellSize()));
+
+            kernel_force_linkedcell_.set_args(
+                F_dev_,
+                partial_dev_,
+                r_dev_,
+                atomcell_dev_,
+                cellstart_dev_,
+                neighborcell_dev_);
+        }
+
+        auto const move_atoms_source = BOOST_COMPUTE_STRINGIZE_SOURCE(kernel void move_atoms(
+            __global particle_t r[],
+            __global particle_t r1[],
+            __global particle_t V[],
+            __global __const particle_t F[],
+            __const real_t deltat,
+            __const real_t s,
+            __global real_t partial[])
+        {
+            __local real_t scratch[LOCALWORKSIZE];
+
+            int const n = get_global_id(0);
+            real4_t const dt = (real4_t)(deltat);
+            real4_t const dt2 = dt * dt;
+            real4_t v = (real4_t)(0.0f);
+
+            // 余ったワークアイテムは、ワークグループ内の総和を求めるのにだけ加わる
+            if (n < NUMATOM) {
+                real4_t const rtmp = load_particle(r, n);
+                real4_t const r1n = load_particle(r1, n);
+                real4_t rn = rtmp;
+//#ifdef NVE
+//                rn = (real4_t)(2.0f) * rtmp - r1n + load_particle(F, n) * dt2;
+//#else
                 // update coordinates and velocity
                 // Verlet法の座標更新式において速度成分を抜き出し、その部分をスケールする
-                r_[n][0] += s * (r_[n][0] - r1_[n][0]) + F_[n][0] * dt2;
-                r_[n][1] += s * (r_[n][1] - r1_[n][1]) + F_[n][1] * dt2;
-                r_[n][2] += s * (r_[n][2] - r1_[n][2]) + F_[n][2] * dt2;
-#endif
+                rn += (real4_t)(s) * (rtmp - r1n) + load_particle(F, n) * dt2;
+//#endif
+                v = (real4_t)(0.5f) * (rn - r1n) / dt;
 
-                V_[n][0] = 0.5 * (r_[n][0] - r1_[n][0]) / Ar_moleculardynamics::DT;
-                V_[n][1] = 0.5 * (r_[n][1] - r1_[n][1]) / Ar_moleculardynamics::DT;
-                V_[n][2] = 0.5 * (r_[n][2] - r1_[n][2]) / Ar_moleculardynamics::DT;
-                
-                r1_[n] = rtmp;
+                store_particle(r, n, rn);
+                store_particle(V, n, v);
+                store_particle(r1, n, rtmp);
             }
-        break;
-        }
 
-        // consider the periodic boundary condination
-        // セルの外側に出たら座標をセル内に戻す
-        for (auto n = 0; n < NumAtom_; n++) {
-            for (auto i = 0; i < 3; i++) {
-                if (r_[n][i] > periodiclen_) {
-                    r_[n][i] -= periodiclen_;
-                    r1_[n][i] -= periodiclen_;
-                }
-                else if (r_[n][i] < 0.0) {
-                    r_[n][i] += periodiclen_;
-                    r1_[n][i] += periodiclen_;
-                }
-            }
-        }
+            // 次のステップで用いる運動エネルギーのワークグループごとの部分和
+            group_sum(0.5f * (v.x * v.x + v.y * v.y + v.z * v.z), scratch, &partial[2 * PARTIALSTRIDE + get_group_id(0)]);
+        });
 
-        MD_iter_++;
-    }
+        kernel_move_atoms_ = programcache_.create(real_source + particle_source + group_sum_source + move_atoms_source, "move_atoms", kerneloptions_);
 
-    template <typename T>
-    void Ar_moleculardynamics<T>::Move_Atoms(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::OpenCl)>)
-    {
-        // ホスト→デバイス
-        compute::copy(r_.begin(), r_.end(), r_dev_.begin(), queue_ );
-        compute::copy(r1_.begin(), r1_.end(), r1_dev_.begin(), queue_ );
-        compute::copy(V_.begin(), V_.end(), V_dev_.begin(), queue_);
+        auto const move_atoms1_source = BOOST_COMPUTE_STRINGIZE_SOURCE(kernel void move_atoms1(
+            __global particle_t r[],
+            __global particle_t r1[],
+            __global particle_t V[],
+            __global __const particle_t F[],
+            __const real_t deltat,
+            __const real_t s,
+            __global real_t partial[])
+        {
+            __local real_t scratch[LOCALWORKSIZE];
 
-        // 運動エネルギーの計算
-        compute::vector<float> V2_dev_(NumAtom_, context_);
-        compute::transform(V_dev_.begin(), V_dev_.end(), V2_dev_.begin(), *pnorm2_, queue_);
-        Uk_ = compute::accumulate(V2_dev_.begin(), V2_dev_.end(), 0.0f, queue_) * 0.5;
+            int const n = get_global_id(0);
+            real4_t const dt = (real4_t)(deltat);
+            real4_t const dt2 = dt * dt;
+            real4_t v = (real4_t)(0.0f);
 
-        // 全エネルギー（運動エネルギー+ポテンシャルエネルギー）の計算
-        Utot_ = Uk_ + Up_;
-        
-        //std::cout << boost::format("MD step = %d, 全エネルギー = %.8f\n") % MD_iter_ % Utot_;
-        openclofs_ << boost::format("MD step = %d, 全エネルギー = %.8f\n") % MD_iter_ % Utot_;
+            // 余ったワークアイテムは、ワークグループ内の総和を求めるのにだけ加わる
+            if (n < NUMATOM) {
+                real4_t rn = load_particle(r, n);
+                real4_t const fn = load_particle(F, n);
+                store_particle(r1, n, rn);
 
-        // 温度の計算
-        Tc_ = Uk_ / (1.5 * static_cast<T>(NumAtom_));
+                // scaling of velocity
+                v = load_particle(V, n) * (real4_t)(s);
 
-        // calculate temperture
-        auto const s = std::sqrt((Tg_ + Ar_moleculardynamics::ALPHA * (Tc_ - Tg_)) / Tc_);
+                // update coordinates and velocity
+                rn += dt * v + (real4_t)(0.5f) * fn * dt2;
 
-        switch (MD_iter_) {
-        case 1:
-            {
-                // update the coordinates by the second order Euler method
-                // 最初のステップだけ修正Euler法で時間発展
-                kernel_move_atoms1_.set_args(
-                    r_dev_,
-                    r1_dev_,
-                    V_dev_,
-                    F_dev_,
-                    Ar_moleculardynamics::DT,
-                    s);
+                v += dt * fn;
 
-                auto const event_move_atoms1 = queue_.enqueue_1d_range_kernel(
-                    kernel_move_atoms1_,
-                    0,
-                    NumAtom_,
-                    Ar_moleculardynamics::LOCALWORKSIZE);
-                event_move_atoms1.wait();
+                store_particle(r, n, rn);
+                store_particle(V, n, v);
             }
-        break;
 
-        default:
-            {
-                // update the coordinates by the Verlet method
-                kernel_move_atoms_.set_args(
-                    r_dev_,
-                    r1_dev_,
-                    V_dev_,
-                    F_dev_,
-                    Ar_moleculardynamics::DT,
-                    s);
+            // 次のステップで用いる運動エネルギーのワークグループごとの部分和
+            group_sum(0.5f * (v.x * v.x + v.y * v.y + v.z * v.z), scratch, &partial[2 * PARTIALSTRIDE + get_group_id(0)]);
+        });
 
-                auto const event_move_atoms = queue_.enqueue_1d_range_kernel(
-                    kernel_move_atoms_,
-                    0,
-                    NumAtom_,
-                    Ar_moleculardynamics::LOCALWORKSIZE);
-                event_move_atoms.wait();
-            }
-        break;
-        }
+        kernel_move_atoms1_ = programcache_.create(real_source + particle_source + group_sum_source + move_atoms1_source, "move_atoms1", kerneloptions_);
 
-        // 周期境界条件のチェック
-        auto const event_check_periodic = queue_.enqueue_1d_range_kernel(
-            kernel_check_periodic_,
-            0,
-            NumAtom_,
-            Ar_moleculardynamics::LOCALWORKSIZE);
-        event_check_periodic.wait();
+        auto const kinetic_source = BOOST_COMPUTE_STRINGIZE_SOURCE(kernel void kinetic(
+            __global __const particle_t V[],
+            __global real_t partial[])
+        {
+            __local real_t scratch[LOCALWORKSIZE];
 
-        // デバイス→ホスト
-        compute::copy(r_dev_.begin(), r_dev_.end(), r_.begin(), queue_);
-        compute::copy(r1_dev_.begin(), r1_dev_.end(), r1_.begin(), queue_);
-        compute::copy(V_dev_.begin(), V_dev_.end(), V_.begin(), queue_);
+            int const n = get_global_id(0);
+            real4_t const v = n < NUMATOM ? load_particle(V, n) : (real4_t)(0.0f);
 
-        MD_iter_++;
-    }
+            // 運動エネルギーのワークグループごとの部分和
+            group_sum(0.5f * (v.x * v.x + v.y * v.y + v.z * v.z), scratch, &partial[2 * PARTIALSTRIDE + get_group_id(0)]);
+        });
 
-    template <typename T>
-    void Ar_moleculardynamics<T>::Move_Atoms(boost::mpl::int_<static_cast<std::int32_t>(ParallelType::Tbb)>)
-    {
-        // 運動エネルギーの初期化
-        Uk_ = 0.0;
+        kernel_kinetic_ = programcache_.create(real_source + particle_source + group_sum_source + kinetic_source, "kinetic", kerneloptions_);
+        kernel_kinetic_.set_args(V_dev_, partial_dev_);
 
-        // 運動エネルギーの計算
-        for (auto n = 0; n < NumAtom_; n++) {
-            Uk_ += norm2(V_[n][0], V_[n][1], V_[n][2]);
-        }
-        Uk_ *= 0.5;
+        // 複数のデバイスを使う場合は、同じプログラムからデバイスごとにカーネルを作り、そのデバイスの配列を設定する
+        // （プログラムはcontextの全てのデバイス向けにビルドされている）
+        auto const clone = [](compute::kernel const & kernel) {
+            return compute::kernel(kernel.get_program(), kernel.name());
+        };
 
-        // 全エネルギー（運動エネルギー+ポテンシャルエネルギー）の計算
-        Utot_ = Uk_ + Up_;
+        for (auto & slab : slabs_) {
+            slab.check_periodic = clone(kernel_check_periodic_);
+            slab.check_periodic.set_args(slab.r, slab.r1);
 
-        //std::cout << boost::format("MD step = %d, 全エネルギー = %.8f\n") % MD_iter_ % Utot_;
-        tbbofs_ << boost::format("MD step = %d, 全エネルギー = %.8f\n") % MD_iter_ % Utot_;
+            slab.displacement = clone(kernel_displacement_);
+            slab.displacement.set_args(slab.partial, slab.r, slab.rref);
 
-        // 温度の計算
-        Tc_ = Uk_ / (1.5 * static_cast<T>(NumAtom_));
+            slab.force = clone(kernel_force_);
+            slab.force.set_args(slab.F, slab.partial, slab.r);
 
-        // calculate temperture
-        auto const s = std::sqrt((Tg_ + Ar_moleculardynamics::ALPHA * (Tc_ - Tg_)) / Tc_);
+            // タイルの大きさは、カーネルを投入するときに設定する
+            slab.force_tiled = clone(kernel_force_tiled_);
+            slab.force_tiled.set_args(slab.F, slab.partial, slab.r);
 
-        switch (MD_iter_) {
-        case 1:
-            // update the coordinates by the second order Euler method
-            // 最初のステップだけ修正Euler法で時間発展
-            tbb::parallel_for(
-                tbb::blocked_range<std::int32_t>(0, NumAtom_),
-                [this, s](auto const & range) {
-                    for (auto && n = range.begin(); n != range.end(); ++n) {
-                        r1_[n] = r_[n];
+            // 近接リストを用いるカーネルの引数は、近接リストを転送するときに設定する
+            slab.force_verletlist = clone(kernel_force_verletlist_);
 
-                        // scaling of velocity
-                        V_[n][0] *= s;
-                        V_[n][1] *= s;
-                        V_[n][2] *= s;
+            slab.kinetic = clone(kernel_kinetic_);
+            slab.kinetic.set_args(slab.V, slab.partial);
 
-                        // update coordinates and velocity
-                        r_[n][0] += Ar_moleculardynamics::DT * V_[n][0] + 0.5 * F_[n][0] * dt2;
-                        r_[n][1] += Ar_moleculardynamics::DT * V_[n][1] + 0.5 * F_[n][1] * dt2;
-                        r_[n][2] += Ar_moleculardynamics::DT * V_[n][2] + 0.5 * F_[n][2] * dt2;
+            // 時間発展のカーネルの引数は、温度のスケーリングの係数と合わせて投入するときに設定する
+            slab.move_atoms = clone(kernel_move_atoms_);
+            slab.move_atoms1 = clone(kernel_move_atoms1_);
+        }
 
-                        V_[n][0] += Ar_moleculardynamics::DT * F_[n][0];
-                        V_[n][1] += Ar_moleculardynamics::DT * F_[n][1];
-                        V_[n][2] += Ar_moleculardynamics::DT * F_[n][2];
-                    }
-            });
-            break;
+        SetPairPotentialArgs();
+    }
 
-        default:
-            // update the coordinates by the Verlet method
-            tbb::parallel_for(
-                tbb::blocked_range<std::int32_t>(0, NumAtom_),
-                [this, s](auto const & range) {
-                    for (auto && n = range.begin(); n != range.end(); ++n) {
-                        auto const rtmp = r_[n];
-#ifdef NVE
-                        r_[n][0] = 2.0 * r_[n][0] - r1_[n][0] + F_[n][0] * dt2;
-                        r_[n][1] = 2.0 * r_[n][1] - r1_[n][1] + F_[n][1] * dt2;
-                        r_[n][2] = 2.0 * r_[n][2] - r1_[n][2] + F_[n][2] * dt2;
-#else
-                        // update coordinates and velocity
-                        // Verlet法の座標更新式において速度成分を抜き出し、その部分をスケールする
-                        r_[n][0] += s * (r_[n][0] - r1_[n][0]) + F_[n][0] * dt2;
-                        r_[n][1] += s * (r_[n][1] - r1_[n][1]) + F_[n][1] * dt2;
-                        r_[n][2] += s * (r_[n][2] - r1_[n][2]) + F_[n][2] * dt2;
+    template <typename T>
+    std::string Ar_moleculardynamics<T>::ResultFileName(std::string const & filename)
+    {
+#ifdef USE_MPI
+        // 最初のプロセス以外がファイルを開くと、同じファイルを切り詰めてしまう
+        if (boost::mpi::communicator().rank() != 0) {
+            return std::string();
+        }
 #endif
 
-                        V_[n][0] = 0.5 * (r_[n][0] - r1_[n][0]) / Ar_moleculardynamics::DT;
-                        V_[n][1] = 0.5 * (r_[n][1] - r1_[n][1]) / Ar_moleculardynamics::DT;
-                        V_[n][2] = 0.5 * (r_[n][2] - r1_[n][2]) / Ar_moleculardynamics::DT;
+        return filename;
+    }
 
-                        r1_[n] = rtmp;
-                    }
-            });
-            break;
+    template <typename T>
+    void Ar_moleculardynamics<T>::SetPairPotentialArgs()
+    {
+        // 区間ごとに、ポテンシャルエネルギーと力の係数を一つずつのfloat4に詰める
+        auto const & table = pairpotential_.table();
+        std::vector<pair4_type> tabletmp(table.size() / 4);
+        for (auto i = 0U; i < tabletmp.size(); i++) {
+            tabletmp[i] = pair4_type(table[4 * i], table[4 * i + 1], table[4 * i + 2], table[4 * i + 3]);
         }
 
-        // consider the periodic boundary condination
-        // セルの外側に出たら座標をセル内に戻す
-        tbb::parallel_for(
-            tbb::blocked_range<std::int32_t>(0, NumAtom_),
-            [this, s](auto const & range) {
-                for (auto && n = range.begin(); n != range.end(); ++n) {
-                    for (auto i = 0; i < 3; i++) {
-                        if (r_[n][i] > periodiclen_) {
-                            r_[n][i] -= periodiclen_;
-                            r1_[n][i] -= periodiclen_;
-                        }
-                        else if (r_[n][i] < 0.0) {
-                            r_[n][i] += periodiclen_;
-                            r1_[n][i] += periodiclen_;
-                        }
-                    }
-                }
-        });
-        
+        // ホスト→デバイス
+        pairtable_dev_ = compute::vector<pair4_type>(tabletmp.begin(), tabletmp.end(), queue_);
+
+        auto const potential = static_cast<std::int32_t>(pairpotential_.type());
+        auto const r2min = PairPotential<T>::R2MIN;
+        auto const invdelta = pairpotential_.getInvDelta();
+
+        // 力を計算する各カーネルの、原子の組の計算に用いる配列の後ろの引数
+        auto const setargs = [&](compute::kernel & kernel, std::int32_t first) {
+            kernel.set_arg(first, pairtable_dev_);
+            kernel.set_arg(first + 1, potential);
+            kernel.set_arg(first + 2, r2min);
+            kernel.set_arg(first + 3, invdelta);
+        };
 
-        MD_iter_++;
+        setargs(kernel_force_, 3);
+        setargs(kernel_force_tiled_, 4);
+        setargs(kernel_force_linkedcell_, 6);
+        setargs(kernel_force_verletlist_, 5);
+
+        for (auto & slab : slabs_) {
+            setargs(slab.force, 3);
+            setargs(slab.force_tiled, 4);
+            setargs(slab.force_verletlist, 5);
+        }
     }
 
     template <typename T>
-    void Ar_moleculardynamics<T>::reset()
+    void Ar_moleculardynamics<T>::UpdateKernel()
     {
-        MD_iter_ = 1;
-        
-        r_.assign(r_clone_.begin(), r_clone_.end());
-        V_.assign(V_clone_.begin(), V_clone_.end());
+        if (KernelOptions() != kerneloptions_) {
+            SetKernel();
+
+            // 近接リストを用いるカーネルの引数は、近接リストを再構築するときに設定する
+            rebuildverletlist_ = true;
+        }
     }
 
-    // #endregion publicメンバ関数
+    template <typename T>
+    template <typename Function>
+    std::pair<std::int32_t, double> Ar_moleculardynamics<T>::TuneKernel(std::string const & name, compute::kernel & kernel, std::int32_t repeat, Function const & prepare)
+    {
+        // 使用できる大きさが無ければ、既定の大きさのままにする
+        auto best = std::make_pair(static_cast<std::int32_t>(Ar_moleculardynamics::LOCALWORKSIZE), std::numeric_limits<double>::max());
+
+        for (auto const localworksize : LocalWorkSizes(kernel)) {
+            // 1回目は時間に含めない
+            prepare(localworksize);
+            EnqueueKernel(kernel, localworksize);
+            lastevent_.wait();
+
+            auto const start = tbb::tick_count::now();
+            for (auto i = 0; i < repeat; i++) {
+                prepare(localworksize);
+                EnqueueKernel(kernel, localworksize);
+            }
+            lastevent_.wait();
+            auto const time = (tbb::tick_count::now() - start).seconds() / static_cast<double>(repeat);
 
-    // #region privateメンバ関数
+            autotuneresults_.push_back(std::make_tuple(name, localworksize, time));
+            if (time < best.second) {
+                best = std::make_pair(localworksize, time);
+            }
+        }
+
+        return best;
+    }
 
     template <typename T>
-    void Ar_moleculardynamics<T>::MD_initPos()
+    std::string Ar_moleculardynamics<T>::TuningPath() const
     {
-        T sx, sy, sz;
-        auto n = 0;
+        // 最適なワークグループの大きさは、デバイスと原子数と精度によって変わる
+        auto const key = (boost::format("autotune %d %s %s") %
+            NumAtom_ %
+            DeviceType<T>::name() %
+            DeviceType<real_type>::name()).str();
 
-        for (auto i = 0; i < Nc_; i++) {
-            for (auto j = 0; j < Nc_; j++) {
-                for (auto k = 0; k < Nc_; k++) {
-                    // 基本セルをコピーする
-                    sx = static_cast<T>(i) * lat_;
-                    sy = static_cast<T>(j) * lat_;
-                    sz = static_cast<T>(k) * lat_;
+        return programcache_.getPath(key, ".tune");
+    }
 
-                    // 基本セル内には4つの原子がある
-                    r_[n][0] = sx;
-                    r_[n][1] = sy;
-                    r_[n][2] = sz;
-                    n++;
+    template <typename T>
+    void Ar_moleculardynamics<T>::OutputEnergy(std::ofstream & ofs, real_type s)
+    {
+        WriteEnergy(ofs, UpdateEnergy(s));
+    }
 
-                    r_[n][0] = 0.5 * lat_ + sx;
-                    r_[n][1] = 0.5 * lat_ + sy;
-                    r_[n][2] = sz;
-                    n++;
+    template <typename T>
+    StepSnapshot<typename Ar_moleculardynamics<T>::real_type> Ar_moleculardynamics<T>::UpdateEnergy(real_type s)
+    {
+        // 全エネルギー（運動エネルギー+ポテンシャルエネルギー）の計算
+        Utot_ = Uk_ + Up_;
 
-                    r_[n][0] = sx;
-                    r_[n][1] = 0.5 * lat_ + sy;
-                    r_[n][2] = 0.5 * lat_ + sz;
-                    n++;
+        // 温度の計算
+        Tc_ = Uk_ / (1.5 * static_cast<T>(NumAtom_));
 
-                    r_[n][0] = 0.5 * lat_ + sx;
-                    r_[n][1] = sy;
-                    r_[n][2] = 0.5 * lat_ + sz;
-                    n++;
-                }
-            }
-        }
+        // 出力は後で行うこともあるので、このステップの値を写しておく
+        StepSnapshot<real_type> snapshot;
+        snapshot.step = MD_iter_;
+        snapshot.lagged = uselaggedthermostat();
+        snapshot.Utot = Utot_;
+        snapshot.s = s;
+        snapshot.sexact = thermostatscale();
 
-        NumAtom_ = n;
+        return snapshot;
+    }
 
-        // move the center of mass to the origin
-        // 系の重心を座標系の原点とする
-        sx = 0.0;
-        sy = 0.0;
-        sz = 0.0;
+    template <typename T>
+    void Ar_moleculardynamics<T>::WriteEnergy(std::ofstream & ofs, StepSnapshot<real_type> const & snapshot)
+    {
+        //std::cout << boost::format("MD step = %d, 全エネルギー = %.8f\n") % snapshot.step % snapshot.Utot;
+        ofs << boost::format("MD step = %d, 全エネルギー = %.8f\n") % snapshot.step % snapshot.Utot;
+
+        auto const step = static_cast<std::size_t>(snapshot.step - 1);
+        if (!snapshot.lagged) {
+            // Exactの全エネルギーを記録しておく
+            if (exacttrace_.size() <= step) {
+                exacttrace_.resize(step + 1);
+            }
+            exacttrace_[step] = static_cast<double>(snapshot.Utot);
 
-        for (auto n = 0; n < NumAtom_; n++) {
-            sx += r_[n][0];
-            sy += r_[n][1];
-            sz += r_[n][2];
+            return;
         }
 
-        sx /= static_cast<T>(NumAtom_);
-        sy /= static_cast<T>(NumAtom_);
-        sz /= static_cast<T>(NumAtom_);
+        // 一つ前のステップの温度から求めた係数と、このステップの温度から求めた係数とを比較
+        laggedsteps_++;
+        laggedmaxscalediff_ = std::max(laggedmaxscalediff_, static_cast<double>(std::fabs(snapshot.s - snapshot.sexact)));
 
-        for (auto n = 0; n < NumAtom_; n++) {
-            r_[n][0] -= sx;
-            r_[n][1] -= sy;
-            r_[n][2] -= sz;
+        // Exactで計算した同じステップの全エネルギーと比較
+        if (step < exacttrace_.size()) {
+            laggedcompared_++;
+            laggedmaxenergydiff_ = std::max(laggedmaxenergydiff_, std::fabs(static_cast<double>(snapshot.Utot) - exacttrace_[step]));
         }
-
-        // 原子座標を複製
-        r_clone_.assign(r_.begin(), r_.end());
     }
 
     template <typename T>
-    void Ar_moleculardynamics<T>::MD_initVel()
+    void Ar_moleculardynamics<T>::UnbinAtoms()
     {
-        auto const v = std::sqrt(3.0 * Tg_);
-
-        myrandom::MyRand mr(-1.0, 1.0);
+        // 座標・1ステップ前の座標・速度・力を元の原子の番号順に戻す（SoAの場合はx, y, z成分のブロックごと）
+        for (auto dev : { &r_dev_, &r1_dev_, &V_dev_, &F_dev_ }) {
+            for (auto b = 0; b < ParticleStore<real_type>::DEVICEBLOCKS; b++) {
+                auto const offset = b * globalworksize();
+                compute::gather(perminv_dev_.begin(), perminv_dev_.begin() + NumAtom_, dev->begin() + offset, particletmp_dev_.begin() + offset, queue_);
+                compute::copy(particletmp_dev_.begin() + offset, particletmp_dev_.begin() + offset + NumAtom_, dev->begin() + offset, queue_);
+            }
+        }
 
-        auto const generator4 = [this, &mr, v]() {
-            T rndX = mr.myrand();
-            T rndY = mr.myrand();
-            T rndZ = mr.myrand();
-            T const tmp = 1.0 / std::sqrt(norm2(rndX, rndY, rndZ));
-            rndX *= tmp;
-            rndY *= tmp;
-            rndZ *= tmp;
-            
-            // 方向はランダムに与える
-            return compute::float4_(v * rndX, v * rndY, v * rndZ, 0.0f);
-        };
+        binned_ = false;
+    }
 
-        boost::generate(V_, generator4);
+    template <typename T>
+    void Ar_moleculardynamics<T>::UploadVerletList()
+    {
+        // 近接リストはホスト側で構築するので、座標だけをホスト側に戻す
+        if (!hostcurrent_) {
+            CopyFromDevice(r_dev_, r_);
+        }
 
-        auto sx = 0.0;
-        auto sy = 0.0;
-        auto sz = 0.0;
+        verletlist_.build(r_, NumAtom_, periodiclen_, rc_ + skin_);
 
-        for (auto n = 0; n < NumAtom_; n++) {
-            sx += V_[n][0];
-            sy += V_[n][1];
-            sz += V_[n][2];
+        // 近接リストが大きくなった場合はデバイス側のメモリを確保し直す
+        auto const & neighbor = verletlist_.neighbor();
+        if (neighbor.size() > neighbor_dev_.size()) {
+            neighbor_dev_ = compute::vector<std::int32_t>(neighbor.size(), context_);
         }
 
-        sx /= static_cast<T>(NumAtom_);
-        sy /= static_cast<T>(NumAtom_);
-        sz /= static_cast<T>(NumAtom_);
+        // ホスト→デバイス
+        compute::copy(neighbor.begin(), neighbor.end(), neighbor_dev_.begin(), queue_);
+        compute::copy(verletlist_.neighborstart().begin(), verletlist_.neighborstart().end(), neighborstart_dev_.begin(), queue_);
+        uploadbytes_ += static_cast<std::int64_t>((neighbor.size() + verletlist_.neighborstart().size()) * sizeof(std::int32_t));
 
-        // 重心の並進運動を避けるために、速度の和がゼロになるように補正
-        for (auto n = 0; n < NumAtom_; n++) {
-            V_[n][0] -= sx;
-            V_[n][1] -= sy;
-            V_[n][2] -= sz;
-        }
+        // 近接リストを構築したときの座標を保存
+        compute::copy(r_dev_.begin(), r_dev_.end(), rref_dev_.begin(), queue_);
+
+        kernel_force_verletlist_.set_args(
+            F_dev_,
+            partial_dev_,
+            r_dev_,
+            neighborstart_dev_,
+            neighbor_dev_);
 
-        // 速度の可変長配列を複製
-        V_clone_.assign(V_.begin(), V_.end());
+        rebuildverletlist_ = false;
     }
 
-    template <typename T>  
-    void Ar_moleculardynamics<T>::SetKernel()
+    template <typename T>
+    void Ar_moleculardynamics<T>::UploadVerletListSlabs()
     {
-        using namespace boost::compute;
+        // 近接リストはホスト側で構築するので、座標だけをホスト側に戻す（どのデバイスも全ての原子の座標を持つ）
+        if (!hostcurrent_) {
+            auto & front = slabs_.front();
+            r_.copy_from_device(front.r, front.queue);
+            downloadbytes_ += static_cast<std::int64_t>(NumAtom_) * ParticleStore<real_type>::DEVICEBYTES;
+        }
 
-        auto const check_periodic_source = BOOST_COMPUTE_STRINGIZE_SOURCE(kernel void check_periodic(
-            __global float4 r[],
-            __global float4 r1[],
-            __const float periodiclen)
-        {
-            int const n = get_global_id(0);
+        verletlist_.build(r_, NumAtom_, periodiclen_, rc_ + skin_);
 
-            if (r[n].x > periodiclen) {
-                r[n].x -= periodiclen;
-                r1[n].x -= periodiclen;
-            }
-            else if (r[n].x < 0.0f) {
-                r[n].x += periodiclen;
-                r1[n].x += periodiclen;
-            }
+        auto const & neighbor = verletlist_.neighbor();
+        auto const & neighborstart = verletlist_.neighborstart();
 
-            if (r[n].y > periodiclen) {
-                r[n].y -= periodiclen;
-                r1[n].y -= periodiclen;
-            }
-            else if (r[n].y < 0.0f) {
-                r[n].y += periodiclen;
-                r1[n].y += periodiclen;
+        for (auto & slab : slabs_) {
+            if (slab.empty()) {
+                continue;
             }
 
-            if (r[n].z > periodiclen) {
-                r[n].z -= periodiclen;
-                r1[n].z -= periodiclen;
-            }
-            else if (r[n].z < 0.0f) {
-                r[n].z += periodiclen;
-                r1[n].z += periodiclen;
+            // 近接リストが大きくなった場合はデバイス側のメモリを確保し直す
+            if (neighbor.size() > slab.neighbor.size()) {
+                slab.neighbor = compute::vector<std::int32_t>(neighbor.size(), context_);
             }
-        });
 
-        kernel_check_periodic_ = kernel::create_with_source(check_periodic_source, "check_periodic", context_);
-        kernel_check_periodic_.set_args(r_dev_, r1_dev_, periodiclen_);
+            // ホスト→デバイス（各デバイスは受け持つ原子の近接リストだけを読む）
+            compute::copy(neighbor.begin(), neighbor.end(), slab.neighbor.begin(), slab.queue);
+            compute::copy(neighborstart.begin(), neighborstart.end(), slab.neighborstart.begin(), slab.queue);
+            uploadbytes_ += static_cast<std::int64_t>((neighbor.size() + neighborstart.size()) * sizeof(std::int32_t));
 
-        auto const force_source = BOOST_COMPUTE_STRINGIZE_SOURCE(kernel void force(
-            __global float4 f[],
-            __global float Up[],
-            __global __const float4 rv[],
-            __const int ncp,
-            __const int numatom,
-            __const float periodiclen,
-            __const float rc2,
-            __const float Vrc)
-        {
-            int const n = get_global_id(0);
+            // 近接リストを構築したときの座標を保存
+            compute::copy(slab.r.begin(), slab.r.end(), slab.rref.begin(), slab.queue);
 
-            for (int m = 0; m < numatom; m++) {
+            slab.force_verletlist.set_args(
+                slab.F,
+                slab.partial,
+                slab.r,
+                slab.neighborstart,
+                slab.neighbor);
+        }
 
-                // ±ncp分のセル内の原子との相互作用を計算
-                for (int i = -ncp; i <= ncp; i++) {
-                    for (int j = -ncp; j <= ncp; j++) {
-                        for (int k = -ncp; k <= ncp; k++) {
-                            float4 s;
-                            s.x = (float)(i) * periodiclen;
-                            s.y = (float)(j) * periodiclen;
-                            s.z = (float)(k) * periodiclen;
-                            s.w = 0.0f;
+        rebuildverletlist_ = false;
+    }
 
-                            // 自分自身との相互作用を排除
-                            if (n != m || i != 0 || j != 0 || k != 0) {
-                                float4 const d = rv[n] - (rv[m] + s);
+    template <typename T>
+    void Ar_moleculardynamics<T>::UseDeviceState()
+    {
+        // 複数のデバイスで計算した値は、ホスト側を経由して転送する
+        if (slabcurrent_) {
+            UseHostState();
+        }
 
-                                float const r2 = dot(d, d);
-                                // 打ち切り距離内であれば計算
-                                if (r2 <= rc2) {
-                                    float const r = sqrt(r2);
-                                    float const rm6 = 1.0 / (r2 * r2 * r2);
-                                    float const rm7 = rm6 / r;
-                                    float const rm12 = rm6 * rm6;
-                                    float const rm13 = rm12 / r;
+#ifdef USE_MPI
+        // MPIの各プロセスで計算した値も、ホスト側に集めてから転送する
+        if (mpicurrent_) {
+            UseHostState();
+        }
+#endif
 
-                                    float const Fr = 48.0 * rm13 - 24.0 * rm7;
+        if (!devicecurrent_) {
+            // ホスト→デバイス
+            CopyToDevice(r_, r_dev_);
+            CopyToDevice(r1_, r1_dev_);
+            CopyToDevice(V_, V_dev_);
+            CopyToDevice(F_, F_dev_);
 
-                                    f[n] += d / (float4)(r) * (float4)(Fr);
-                                    Up[n] += 0.5 * (4.0 * (rm12 - rm6) - Vrc);
-                                }
-                            }
-                        }
-                    }
+            devicecurrent_ = true;
+            ukcurrent_ = false;
+        }
+
+        hostcurrent_ = false;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::UseHostState()
+    {
+#ifdef USE_MPI
+        if (mpicurrent_) {
+            // MPIの全てのプロセスが受け持つ原子を集める（全てのプロセスで呼び出される）
+            mpidomain_.gather(r_, r1_, V_, F_);
+            mpicurrent_ = false;
+            forcecleared_ = false;
+        }
+#endif
+
+        // OpenCLで求めた値のうち、まだ読み込んでいないものを読み込む
+        CheckVerletListDevice();
+        ReadPartials(false);
+
+        if (slabcurrent_) {
+            // 座標は全てのデバイスが全ての原子の分を持っているので最初のデバイスから、
+            // 1ステップ前の座標・速度・力は各デバイスが受け持つ範囲を読み込む
+            auto & front = slabs_.front();
+            r_.copy_from_device(front.r, front.queue);
+
+            for (auto & slab : slabs_) {
+                if (slab.empty()) {
+                    continue;
                 }
+
+                auto const last = slab.last(NumAtom_);
+                r1_.copy_from_device(slab.r1, slab.queue, slab.begin, last);
+                V_.copy_from_device(slab.V, slab.queue, slab.begin, last);
+                F_.copy_from_device(slab.F, slab.queue, slab.begin, last);
             }
-        });
 
-        kernel_force_ = kernel::create_with_source(force_source, "force", context_);
-        kernel_force_.set_args(
-            F_dev_,
-            Up_dev_,
-            r_dev_,
-            ncp_,
-            NumAtom_,
-            periodiclen_,
-            rc2_,
-            Vrc_);
+            downloadbytes_ += 4 * static_cast<std::int64_t>(NumAtom_) * ParticleStore<real_type>::DEVICEBYTES;
 
-        auto const move_atoms_source = BOOST_COMPUTE_STRINGIZE_SOURCE(kernel void move_atoms(
-            __global float4 r[],
-            __global float4 r1[],
-            __global float4 V[],
-            __global __const float4 F[],
-            __const float deltat,
-            __const float s)
-        {
-            int const n = get_global_id(0);
-            float4 const dt = (float4)(deltat);
-            float4 const dt2 = dt * dt;
-            float4 const rtmp = r[n];
-//#ifdef NVE
-//            r[n] = (float4)(2.0f) * r[n] - r1[n] + F[n] * dt2;
-//#else
-            // update coordinates and velocity
-            // Verlet法の座標更新式において速度成分を抜き出し、その部分をスケールする
-            r[n] += (float4)(s) * (r[n] - r1[n]) + F[n] * dt2;
-//#endif
-            V[n] = (float4)(0.5f) * (r[n] - r1[n]) / dt;
+            slabcurrent_ = false;
+            hostcurrent_ = true;
+            forcecleared_ = false;
+        }
 
-            r1[n] = rtmp;
-        });
+        if (!hostcurrent_) {
+            // デバイス→ホスト
+            CopyFromDevice(r_dev_, r_);
+            CopyFromDevice(r1_dev_, r1_);
+            CopyFromDevice(V_dev_, V_);
+            CopyFromDevice(F_dev_, F_);
 
-        kernel_move_atoms_ = kernel::create_with_source(move_atoms_source, "move_atoms", context_);
+            hostcurrent_ = true;
+            forcecleared_ = false;
+        }
 
-        auto const move_atoms1_source = BOOST_COMPUTE_STRINGIZE_SOURCE(kernel void move_atoms1(
-            __global float4 r[],
-            __global float4 r1[],
-            __global float4 V[],
-            __global __const float4 F[],
-            __const float deltat,
-            __const float s)
-        {
-            int const n = get_global_id(0);
-            float4 const dt = (float4)(deltat);
-            float4 const dt2 = dt * dt;
+        devicecurrent_ = false;
+    }
+
+    template <typename T>
+    void Ar_moleculardynamics<T>::UseSlabState()
+    {
+        if (slabcurrent_) {
+            return;
+        }
 
-            r1[n] = r[n];
+        // 最新の値をホスト側に戻してから、全てのデバイスに転送する
+        UseHostState();
 
-            // scaling of velocity
-            V[n] *= (float4)(s);
+        for (auto & slab : slabs_) {
+            if (slab.empty()) {
+                continue;
+            }
 
-            // update coordinates and velocity
-            r[n] += dt * V[n] + (float4)(0.5f) * F[n] * dt2;
+            // ホスト→デバイス
+            r_.copy_to_device(slab.r, slab.queue);
+            r1_.copy_to_device(slab.r1, slab.queue);
+            V_.copy_to_device(slab.V, slab.queue);
+            F_.copy_to_device(slab.F, slab.queue);
+            uploadbytes_ += 4 * static_cast<std::int64_t>(NumAtom_) * ParticleStore<real_type>::DEVICEBYTES;
 
-            V[n] += (float4)(dt) * F[n];
-        });
+            slab.sends.clear();
+        }
 
-        kernel_move_atoms1_ = kernel::create_with_source(move_atoms1_source, "move_atoms1", context_);
+        slabcurrent_ = true;
+        hostcurrent_ = false;
+        ukcurrent_ = false;
 
-        pnorm2_ = boost::in_place(make_function_from_source<float(float4_)>(
-            "norm2",
-            "float norm2(float4 v) { return v.x * v.x + v.y * v.y + v.z * v.z; }"));
+        // 各デバイスには近接リストを構築したときの座標がないので、近接リストを構築し直す
+        rebuildverletlist_ = true;
     }
 
     // #endregion privateメンバ関数
@@ -0,0 +1,239 @@
+﻿/*! \file deviceselector.h
+    \brief 使用するOpenCLデバイスを名前や種類で選び、必要であればサブデバイスに分割するクラスの宣言と実装
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _DEVICESELECTOR_H_
+#define _DEVICESELECTOR_H_
+
+#pragma once
+
+#include <algorithm>                                // for std::all_of, std::min, std::transform
+#include <cctype>                                   // for std::isdigit, std::tolower
+#include <cstddef>                                  // for std::size_t
+#include <cstdint>                                  // for std::int32_t
+#include <stdexcept>                                // for std::invalid_argument, std::out_of_range, std::runtime_error
+#include <string>                                   // for std::stoi, std::string
+#include <vector>                                   // for std::vector
+#include <boost/compute/device.hpp>                 // for boost::compute::device
+#include <boost/compute/platform.hpp>               // for boost::compute::platform
+#include <boost/compute/system.hpp>                 // for boost::compute::system
+
+namespace moleculardynamics {
+    namespace compute = boost::compute;
+
+    //! A class.
+    /*!
+        使用するOpenCLデバイスを名前や種類で選び、必要であればサブデバイスに分割する（device fission）クラス
+        指定の書式は"名前または種類[:分割数]"で、一つのcontextに入れられるように同じプラットフォームのデバイスだけを選ぶ
+        - 空文字列 : compute::system::default_device()（BOOST_COMPUTE_DEFAULT_DEVICEなどの環境変数に従う）
+        - "cpu"、"gpu"、"accelerator"、"all" : その種類のデバイスが最も多いプラットフォームの、その種類の全てのデバイス
+        - それ以外 : 名前にその文字列を含むデバイス（最初に見つかったプラットフォームのもの）
+        - ":N" : 最初のデバイスを、計算ユニットの数がほぼ等しいN個のサブデバイスに分割する（Nは計算ユニットの数以下）
+        - ":numa" : 最初のデバイスを、NUMAノードごとのサブデバイスに分割する
+        （最後の':'より後ろが数字の列でも"numa"でもなければ、':'を含む全体をデバイスの名前とみなす）
+    */
+    class DeviceSelector final {
+        // #region publicメンバ関数
+
+    public:
+        //! A public static member function.
+        /*!
+            指定に合うOpenCLデバイスを選ぶ
+            \param spec デバイスの指定
+            \return 選んだデバイス（一つ以上）
+        */
+        static std::vector<compute::device> select(std::string const & spec);
+
+        // #endregion publicメンバ関数
+
+        // #region privateメンバ関数
+
+    private:
+        //! A private static member function.
+        /*!
+            デバイスをサブデバイスに分割する
+            \param device 分割するデバイス
+            \param fission 分割の指定（"numa"または分割数）
+            \return サブデバイス
+        */
+        static std::vector<compute::device> partition(compute::device const & device, std::string const & fission);
+
+        //! A private static member function.
+        /*!
+            デバイスの種類の名前を、OpenCLのデバイスの種類に変換する
+            \param name デバイスの種類の名前（小文字）
+            \param type OpenCLのデバイスの種類
+            \return デバイスの種類の名前であればtrue
+        */
+        static bool devicetype(std::string const & name, cl_device_type & type);
+
+        //! A private static member function.
+        /*!
+            文字列がサブデバイスへの分割の指定の書式かどうかを調べる
+            \param suffix 最後の':'より後ろの文字列
+            \return 空でない数字の列か"numa"であればtrue
+        */
+        static bool isfission(std::string const & suffix);
+
+        // #endregion privateメンバ関数
+
+        // #region 禁止されたコンストラクタ・メンバ関数
+
+        //! A private constructor (deleted).
+        /*!
+            デフォルトコンストラクタ（禁止）
+        */
+        DeviceSelector() = delete;
+
+        //! A private copy constructor (deleted).
+        /*!
+            コピーコンストラクタ（禁止）
+        */
+        DeviceSelector(DeviceSelector const &) = delete;
+
+        //! A private member function (deleted).
+        /*!
+            operator=()の宣言（禁止）
+            \param コピー元のオブジェクト（未使用）
+            \return コピー元のオブジェクト
+        */
+        DeviceSelector & operator=(DeviceSelector const &) = delete;
+
+        // #endregion 禁止されたコンストラクタ・メンバ関数
+    };
+
+    // #region publicメンバ関数
+
+    inline std::vector<compute::device> DeviceSelector::select(std::string const & spec)
+    {
+        // 最後の':'より後ろが数字の列か"numa"であれば、サブデバイスへの分割の指定（それ以外は名前の一部）
+        auto colon = spec.rfind(':');
+        if (colon != std::string::npos && !DeviceSelector::isfission(spec.substr(colon + 1))) {
+            colon = std::string::npos;
+        }
+
+        auto const name = spec.substr(0, colon);
+        auto const fission = colon == std::string::npos ? std::string() : spec.substr(colon + 1);
+
+        std::vector<compute::device> devices;
+
+        auto lower = name;
+        std::transform(lower.begin(), lower.end(), lower.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+
+        cl_device_type type;
+        if (name.empty()) {
+            devices.push_back(compute::system::default_device());
+        }
+        else if (DeviceSelector::devicetype(lower, type)) {
+            // その種類のデバイスが最も多いプラットフォームを選ぶ
+            for (auto const & platform : compute::system::platforms()) {
+                auto const candidates = platform.device_count(type) > 0 ? platform.devices(type) : std::vector<compute::device>();
+                if (candidates.size() > devices.size()) {
+                    devices = candidates;
+                }
+            }
+        }
+        else {
+            // 名前にnameを含むデバイスが見つかった最初のプラットフォームを選ぶ
+            for (auto const & platform : compute::system::platforms()) {
+                for (auto const & device : platform.devices()) {
+                    if (device.name().find(name) != std::string::npos) {
+                        devices.push_back(device);
+                    }
+                }
+
+                if (!devices.empty()) {
+                    break;
+                }
+            }
+        }
+
+        if (devices.empty()) {
+            throw std::runtime_error("No OpenCL device matches \"" + spec + "\".");
+        }
+
+        if (!fission.empty()) {
+            return DeviceSelector::partition(devices.front(), fission);
+        }
+
+        return devices;
+    }
+
+    // #endregion publicメンバ関数
+
+    // #region privateメンバ関数
+
+    inline std::vector<compute::device> DeviceSelector::partition(compute::device const & device, std::string const & fission)
+    {
+        // サブデバイスに分割するにはOpenCL 1.2以降が必要
+        if (!device.check_version(1, 2) || device.get_info<cl_uint>(CL_DEVICE_PARTITION_MAX_SUB_DEVICES) < 2) {
+            throw std::runtime_error("The OpenCL device \"" + device.name() + "\" cannot be partitioned into sub-devices.");
+        }
+
+        if (fission == "numa") {
+            return device.partition_by_affinity_domain(CL_DEVICE_AFFINITY_DOMAIN_NUMA);
+        }
+
+        // 分割数は、1以上で計算ユニットの数（とサブデバイスの最大数）以下の整数でなければならない
+        auto const computeunits = static_cast<std::int32_t>(device.compute_units());
+        auto const maxcount = std::min(computeunits, static_cast<std::int32_t>(device.get_info<cl_uint>(CL_DEVICE_PARTITION_MAX_SUB_DEVICES)));
+        auto count = 0;
+        try {
+            std::size_t pos;
+            count = std::stoi(fission, &pos);
+            if (pos != fission.size()) {
+                count = 0;
+            }
+        }
+        catch (std::invalid_argument const &) {
+        }
+        catch (std::out_of_range const &) {
+        }
+
+        if (count < 1 || count > maxcount) {
+            throw std::runtime_error("Invalid number of OpenCL sub-devices: " + fission);
+        }
+
+        // 計算ユニットをちょうど分割数個のサブデバイスに分ける（割り切れない分は前のサブデバイスに一つずつ割り当てる）
+        std::vector<std::size_t> counts(count, static_cast<std::size_t>(computeunits / count));
+        for (auto i = 0; i < computeunits % count; i++) {
+            counts[i]++;
+        }
+
+        return device.partition_by_counts(counts);
+    }
+
+    inline bool DeviceSelector::devicetype(std::string const & name, cl_device_type & type)
+    {
+        if (name == "cpu") {
+            type = CL_DEVICE_TYPE_CPU;
+        }
+        else if (name == "gpu") {
+            type = CL_DEVICE_TYPE_GPU;
+        }
+        else if (name == "accelerator") {
+            type = CL_DEVICE_TYPE_ACCELERATOR;
+        }
+        else if (name == "all") {
+            type = CL_DEVICE_TYPE_ALL;
+        }
+        else {
+            return false;
+        }
+
+        return true;
+    }
+
+    inline bool DeviceSelector::isfission(std::string const & suffix)
+    {
+        return suffix == "numa" ||
+            (!suffix.empty() && std::all_of(suffix.begin(), suffix.end(), [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; }));
+    }
+
+    // #endregion privateメンバ関数
+}
+
+#endif  // _DEVICESELECTOR_H_
@@ -0,0 +1,223 @@
+﻿/*! \file deviceslab.h
+    \brief 複数のOpenCLデバイスで原子を分割して計算する場合の、一つのデバイスが受け持つ範囲と資源を表す構造体の宣言と実装
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _DEVICESLAB_H_
+#define _DEVICESLAB_H_
+
+#pragma once
+
+#include "particlestore.h"
+#include <algorithm>                                // for std::min
+#include <cstdint>                                  // for std::int32_t
+#include <vector>                                   // for std::vector
+#include <boost/compute/command_queue.hpp>          // for boost::compute::command_queue
+#include <boost/compute/container/vector.hpp>       // for boost::compute::vector
+#include <boost/compute/context.hpp>                // for boost::compute::context
+#include <boost/compute/device.hpp>                 // for boost::compute::device
+#include <boost/compute/event.hpp>                  // for boost::compute::event
+#include <boost/compute/kernel.hpp>                 // for boost::compute::kernel
+
+namespace moleculardynamics {
+    namespace compute = boost::compute;
+
+    //! A template struct.
+    /*!
+        複数のOpenCLデバイスで原子を分割して計算する場合の、一つのデバイスが受け持つ原子の範囲（スラブ）と、
+        そのデバイスのキュー・配列・カーネル
+        座標の配列は全ての原子の分を持ち、他の配列は受け持つ範囲だけを用いる
+        \tparam T 力とエネルギーの足し合わせ、および座標・速度の時間発展に用いる型
+    */
+    template <typename T>
+    struct DeviceSlab {
+        //! A typedef.
+        /*!
+            デバイス側の座標・速度・力の配列の要素の型（メモリ配置はParticleStoreと同じ）
+        */
+        using particle_type = typename ParticleStore<T>::device_type;
+
+        //! A constructor.
+        /*!
+            コンストラクタ
+            \param context 全てのデバイスを含むOpenCL context
+            \param device このスラブを受け持つデバイス
+        */
+        DeviceSlab(compute::context const & context, compute::device const & device)
+            :
+            queue(context, device),
+            F(context),
+            neighbor(context),
+            neighborstart(context),
+            partial(context),
+            r(context),
+            r1(context),
+            rref(context),
+            V(context)
+        {
+        }
+
+        //! A public member function (constant).
+        /*!
+            受け持つ原子が無いかどうか
+            \return 受け持つ原子が無ければtrue
+        */
+        bool empty() const
+        {
+            return begin == end;
+        }
+
+        //! A public member function (constant).
+        /*!
+            受け持つ原子の番号の最後の次を返す
+            \param numatom 原子数
+            \return 受け持つ原子の番号の最後の次（グローバルワークサイズの余りを除く）
+        */
+        std::int32_t last(std::int32_t numatom) const
+        {
+            return std::min(end, numatom);
+        }
+
+        //! A public member variable.
+        /*!
+            このデバイスのOpenCLのキュー
+        */
+        compute::command_queue queue;
+
+        //! A public member variable.
+        /*!
+            受け持つ最初の原子の番号（グローバルワークオフセット、ワークグループの大きさの最大値の倍数）
+        */
+        std::int32_t begin = 0;
+
+        //! A public member variable.
+        /*!
+            受け持つ最後の原子の番号の次（グローバルワークサイズの終わり、ワークグループの大きさの最大値の倍数）
+        */
+        std::int32_t end = 0;
+
+        //! A public member variable.
+        /*!
+            最後に投入した力を計算するカーネルのワークグループの個数
+        */
+        std::int32_t forcegroups = 0;
+
+        //! A public member variable.
+        /*!
+            最後に投入したコマンドのイベント
+        */
+        compute::event lastevent;
+
+        //! A public member variable.
+        /*!
+            このデバイスの座標を他のデバイスに送るコピーのイベント（完了するまで座標を書き換えない）
+        */
+        std::vector<compute::event> sends;
+
+        //! A public member variable.
+        /*!
+            n個目の原子に働く力
+        */
+        compute::vector<particle_type> F;
+
+        //! A public member variable.
+        /*!
+            近接リストに含まれる原子の番号
+        */
+        compute::vector<std::int32_t> neighbor;
+
+        //! A public member variable.
+        /*!
+            各原子の近接リストの先頭の位置
+        */
+        compute::vector<std::int32_t> neighborstart;
+
+        //! A public member variable.
+        /*!
+            ワークグループごとの部分和（ポテンシャルエネルギー・ビリアル・運動エネルギー・変位の二乗の最大値の順に並べる）
+        */
+        compute::vector<T> partial;
+
+        //! A public member variable.
+        /*!
+            ワークグループごとの部分和（ホスト側）
+        */
+        std::vector<T> partialhost;
+
+        //! A public member variable.
+        /*!
+            n個目の原子の座標（全ての原子の分）
+        */
+        compute::vector<particle_type> r;
+
+        //! A public member variable.
+        /*!
+            n個目の原子の1ステップ前の座標
+        */
+        compute::vector<particle_type> r1;
+
+        //! A public member variable.
+        /*!
+            近接リストを構築したときの原子の座標
+        */
+        compute::vector<particle_type> rref;
+
+        //! A public member variable.
+        /*!
+            n個目の原子の速度
+        */
+        compute::vector<particle_type> V;
+
+        //! A public member variable.
+        /*!
+            周期境界条件をチェックするカーネル
+        */
+        compute::kernel check_periodic;
+
+        //! A public member variable.
+        /*!
+            近接リストを構築した時点からの変位を計算するカーネル
+        */
+        compute::kernel displacement;
+
+        //! A public member variable.
+        /*!
+            全ての原子の組を計算して、各原子に働く力を求めるカーネル
+        */
+        compute::kernel force;
+
+        //! A public member variable.
+        /*!
+            原子の座標をローカルメモリにタイル単位で読み込んで、各原子に働く力を求めるカーネル
+        */
+        compute::kernel force_tiled;
+
+        //! A public member variable.
+        /*!
+            近接リストを用いて各原子に働く力を求めるカーネル
+        */
+        compute::kernel force_verletlist;
+
+        //! A public member variable.
+        /*!
+            運動エネルギーのワークグループごとの部分和を求めるカーネル
+        */
+        compute::kernel kinetic;
+
+        //! A public member variable.
+        /*!
+            Verlet法で時間発展するカーネル
+        */
+        compute::kernel move_atoms;
+
+        //! A public member variable.
+        /*!
+            修正Euler法で時間発展するカーネル
+        */
+        compute::kernel move_atoms1;
+    };
+}
+
+#endif  // _DEVICESLAB_H_
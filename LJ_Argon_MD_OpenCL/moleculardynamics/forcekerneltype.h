@@ -0,0 +1,24 @@
+﻿/*! \file forcekerneltype.h
+    \brief OpenCLで力を計算するカーネルの種類を表す列挙型の宣言
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _FORCEKERNELTYPE_H_
+#define _FORCEKERNELTYPE_H_
+
+#pragma once
+
+#include <cstdint>  // for std::int32_t
+
+namespace moleculardynamics {
+    enum class ForceKernelType : std::int32_t {
+        AllPairs = 0,
+        AllPairsTiled = 1,
+        LinkedCell = 2,
+        VerletList = 3
+    };
+}
+
+#endif  // _FORCEKERNELTYPE_H_
@@ -0,0 +1,304 @@
+﻿/*! \file linkedcell.h
+    \brief 周期境界条件の下で、セルリスト（linked-cell）法により近接原子を探索するクラスの宣言と実装
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _LINKEDCELL_H_
+#define _LINKEDCELL_H_
+
+#pragma once
+
+#include <cmath>        // for std::floor
+#include <cstdint>      // for std::int32_t
+#include <vector>       // for std::vector
+
+namespace moleculardynamics {
+    //! A template class.
+    /*!
+        周期境界条件の下で、セルリスト（linked-cell）法により近接原子を探索するクラス
+        \tparam T 座標の型
+    */
+    template <typename T>
+    class LinkedCell final {
+        // #region コンストラクタ・デストラクタ
+
+    public:
+        //! A constructor.
+        /*!
+            デフォルトコンストラクタ
+        */
+        LinkedCell() = default;
+
+        //! A destructor.
+        /*!
+            デフォルトデストラクタ
+        */
+        ~LinkedCell() = default;
+
+        // #endregion コンストラクタ・デストラクタ
+
+        // #region publicメンバ関数
+
+        //! A public member function (constant).
+        /*!
+            各原子が属するセルの番号の配列を返す
+            \return 各原子が属するセルの番号の配列
+        */
+        std::vector<std::int32_t> const & atomcell() const
+        {
+            return atomcell_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            n個目の原子が属するセルの番号を返す
+            \param n 原子の番号
+            \return n個目の原子が属するセルの番号
+        */
+        std::int32_t atomcell(std::int32_t n) const
+        {
+            return atomcell_[n];
+        }
+
+        //! A public member function.
+        /*!
+            原子の座標からセルリストを構築する
+            \param r 原子の座標
+            \param numatom 原子数
+        */
+        template <typename Container>
+        void build(Container const & r, std::int32_t numatom);
+
+        //! A public member function (constant).
+        /*!
+            セルに属する原子の番号を、セルの番号順に並べた配列を返す
+            \return セルに属する原子の番号の配列
+        */
+        std::vector<std::int32_t> const & cellatom() const
+        {
+            return cellatom_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            各セルに属する原子がcellatom()の何番目から始まるかを表す配列を返す
+            \return 各セルの先頭の位置の配列（要素数はセルの総数 + 1）
+        */
+        std::vector<std::int32_t> const & cellstart() const
+        {
+            return cellstart_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            セルの一辺の長さの逆数を返す
+            \return セルの一辺の長さの逆数
+        */
+        T getInvCellSize() const
+        {
+            return invcellsize_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            一辺あたりのセルの個数を返す
+            \return 一辺あたりのセルの個数
+        */
+        std::int32_t getNcell() const
+        {
+            return ncell_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            各セルについて、自分自身を含む隣接する27個のセルの番号を並べた配列を返す
+            \return 隣接するセルの番号の配列（要素数はセルの総数 × 27）
+        */
+        std::vector<std::int32_t> const & neighborcell() const
+        {
+            return neighborcell_;
+        }
+
+        //! A public member function.
+        /*!
+            周期境界条件の長さとカットオフ半径からセルの分割を決める
+            \param periodiclen 周期境界条件の長さ
+            \param rc カットオフ半径
+        */
+        void setup(T periodiclen, T rc);
+
+        //! A public member function (constant).
+        /*!
+            セルリスト法が使用可能かどうかを返す
+            \return 一辺あたりのセルが3個以上あればtrue
+        */
+        bool usable() const
+        {
+            return ncell_ >= LinkedCell::MINNCELL;
+        }
+
+        // #endregion publicメンバ関数
+
+        // #region privateメンバ関数
+
+    private:
+        //! A private member function (constant).
+        /*!
+            座標からその座標が属するセルの一次元の番号を求める
+            \param x 座標
+            \return セルの一次元の番号
+        */
+        std::int32_t cellindex(T x) const
+        {
+            auto i = static_cast<std::int32_t>(std::floor(x * invcellsize_)) % ncell_;
+            if (i < 0) {
+                i += ncell_;
+            }
+
+            return i;
+        }
+
+        // #endregion privateメンバ関数
+
+        // #region メンバ変数
+
+    public:
+        //! A public member variable (constant).
+        /*!
+            隣接するセルの個数（自分自身を含む）
+        */
+        static auto constexpr NEIGHBORCELLNUM = 27;
+
+    private:
+        //! A private member variable (constant).
+        /*!
+            セルリスト法が使用可能な一辺あたりのセルの最小個数
+        */
+        static auto constexpr MINNCELL = 3;
+
+        //! A private member variable.
+        /*!
+            n個目の原子が属するセルの番号
+        */
+        std::vector<std::int32_t> atomcell_;
+
+        //! A private member variable.
+        /*!
+            セルに属する原子の番号を、セルの番号順に並べた配列
+        */
+        std::vector<std::int32_t> cellatom_;
+
+        //! A private member variable.
+        /*!
+            各セルの先頭の位置
+        */
+        std::vector<std::int32_t> cellstart_;
+
+        //! A private member variable.
+        /*!
+            セルの一辺の長さの逆数
+        */
+        T invcellsize_ = 0;
+
+        //! A private member variable.
+        /*!
+            一辺あたりのセルの個数
+        */
+        std::int32_t ncell_ = 0;
+
+        //! A private member variable.
+        /*!
+            各セルに隣接する27個のセルの番号
+        */
+        std::vector<std::int32_t> neighborcell_;
+
+        // #endregion メンバ変数
+
+        // #region 禁止されたコンストラクタ・メンバ関数
+
+        //! A private copy constructor (deleted).
+        /*!
+            コピーコンストラクタ（禁止）
+        */
+        LinkedCell(LinkedCell const &) = delete;
+
+        //! A private member function (deleted).
+        /*!
+            operator=()の宣言（禁止）
+            \param コピー元のオブジェクト（未使用）
+            \return コピー元のオブジェクト
+        */
+        LinkedCell & operator=(LinkedCell const &) = delete;
+
+        // #endregion 禁止されたコンストラクタ・メンバ関数
+    };
+
+    // #region publicメンバ関数
+
+    template <typename T>
+    template <typename Container>
+    void LinkedCell<T>::build(Container const & r, std::int32_t numatom)
+    {
+        auto const ncellall = ncell_ * ncell_ * ncell_;
+
+        atomcell_.resize(numatom);
+        cellatom_.resize(numatom);
+        cellstart_.assign(ncellall + 1, 0);
+
+        // 各原子が属するセルを求め、各セルに属する原子の個数を数える
+        for (auto n = 0; n < numatom; n++) {
+            auto const c = (cellindex(r[n][0]) * ncell_ + cellindex(r[n][1])) * ncell_ + cellindex(r[n][2]);
+            atomcell_[n] = c;
+            cellstart_[c + 1]++;
+        }
+
+        // 原子の個数の累積和から各セルの先頭の位置を求める
+        for (auto c = 0; c < ncellall; c++) {
+            cellstart_[c + 1] += cellstart_[c];
+        }
+
+        // 原子の番号をセルの番号順に並べる（計数ソート）
+        std::vector<std::int32_t> pos(cellstart_.begin(), cellstart_.end() - 1);
+        for (auto n = 0; n < numatom; n++) {
+            cellatom_[pos[atomcell_[n]]++] = n;
+        }
+    }
+
+    template <typename T>
+    void LinkedCell<T>::setup(T periodiclen, T rc)
+    {
+        // セルの一辺の長さがカットオフ半径以上になるように分割する
+        ncell_ = static_cast<std::int32_t>(std::floor(periodiclen / rc));
+        if (!usable()) {
+            neighborcell_.clear();
+            return;
+        }
+
+        invcellsize_ = static_cast<T>(ncell_) / periodiclen;
+
+        auto const wrap = [this](std::int32_t i) { return (i + ncell_) % ncell_; };
+
+        // 周期境界条件を考慮して、隣接するセルの番号を求めておく
+        neighborcell_.resize(ncell_ * ncell_ * ncell_ * LinkedCell::NEIGHBORCELLNUM);
+        auto itr = neighborcell_.begin();
+        for (auto i = 0; i < ncell_; i++) {
+            for (auto j = 0; j < ncell_; j++) {
+                for (auto k = 0; k < ncell_; k++) {
+                    for (auto di = -1; di <= 1; di++) {
+                        for (auto dj = -1; dj <= 1; dj++) {
+                            for (auto dk = -1; dk <= 1; dk++) {
+                                *itr++ = (wrap(i + di) * ncell_ + wrap(j + dj)) * ncell_ + wrap(k + dk);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // #endregion publicメンバ関数
+}
+
+#endif  // _LINKEDCELL_H_
@@ -0,0 +1,791 @@
+﻿/*! \file ljkernel.h
+    \brief 原子と、その近接原子との間に働くLennard-Jones力を、SIMD命令を用いて計算するクラスの宣言と実装
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _LJKERNEL_H_
+#define _LJKERNEL_H_
+
+#pragma once
+
+#include "simdtype.h"
+#include <algorithm>                        // for std::min
+#include <array>                            // for std::array
+#include <cmath>                            // for std::nearbyint
+#include <cstdint>                          // for std::int32_t
+#include <vector>                           // for std::vector
+#include <tbb/cache_aligned_allocator.h>    // for tbb::cache_aligned_allocator
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define LJKERNEL_X86
+    #ifdef _MSC_VER
+        #include <intrin.h>                 // for __cpuid, __cpuidex
+    #endif
+    #include <immintrin.h>                  // for SSE4.2, AVX2, AVX-512 intrinsics
+#endif
+
+// GCCとClangでは、命令セットごとに関数単位でコード生成を許可する（MSVCでは不要）
+#if defined(LJKERNEL_X86) && defined(__GNUC__)
+    #define LJKERNEL_TARGET(isa) __attribute__((target(isa)))
+#else
+    #define LJKERNEL_TARGET(isa)
+#endif
+
+namespace moleculardynamics {
+    //! A template class.
+    /*!
+        原子nの近接原子の番号と座標を、SIMD命令で読み込めるように連続した配列に詰め込むクラス
+        \tparam T 座標の型
+    */
+    template <typename T>
+    class NeighborPack final {
+        // #region 型エイリアス
+
+        using array_type = std::vector<T, tbb::cache_aligned_allocator<T>>;
+
+        // #endregion 型エイリアス
+
+        // #region コンストラクタ・デストラクタ
+
+    public:
+        //! A constructor.
+        /*!
+            デフォルトコンストラクタ
+        */
+        NeighborPack() = default;
+
+        //! A destructor.
+        /*!
+            デフォルトデストラクタ
+        */
+        ~NeighborPack() = default;
+
+        // #endregion コンストラクタ・デストラクタ
+
+        // #region publicメンバ関数
+
+        //! A public member function.
+        /*!
+            詰め込んだ原子を全て取り除く
+        */
+        void clear()
+        {
+            size_ = 0;
+        }
+
+        //! A public member function.
+        /*!
+            詰め込んだ原子に働く力のi番目の成分の配列の先頭へのポインタを返す
+            \param i 成分の番号
+            \return i番目の成分の配列の先頭へのポインタ
+        */
+        T * f(std::int32_t i)
+        {
+            return f_[i].data();
+        }
+
+        //! A public member function (constant).
+        /*!
+            k番目に詰め込んだ原子の番号を返す
+            \param k 詰め込んだ順番
+            \return 原子の番号
+        */
+        std::int32_t index(std::int32_t k) const
+        {
+            return index_[k];
+        }
+
+        //! A public member function.
+        /*!
+            原子を詰め込む
+            \param m 原子の番号
+            \param x 原子のx座標
+            \param y 原子のy座標
+            \param z 原子のz座標
+        */
+        void push_back(std::int32_t m, T x, T y, T z)
+        {
+            if (size_ + NeighborPack::PADDING > static_cast<std::int32_t>(index_.size())) {
+                grow();
+            }
+
+            index_[size_] = m;
+            r_[0][size_] = x;
+            r_[1][size_] = y;
+            r_[2][size_] = z;
+            size_++;
+        }
+
+        //! A public member function (constant).
+        /*!
+            詰め込んだ原子の座標のi番目の成分の配列の先頭へのポインタを返す
+            \param i 成分の番号
+            \return i番目の成分の配列の先頭へのポインタ（キャッシュラインの境界に揃っている）
+        */
+        T const * r(std::int32_t i) const
+        {
+            return r_[i].data();
+        }
+
+        //! A public member function (constant).
+        /*!
+            詰め込んだ原子の個数を返す
+            \return 詰め込んだ原子の個数
+        */
+        std::int32_t size() const
+        {
+            return size_;
+        }
+
+        // #endregion publicメンバ関数
+
+        // #region privateメンバ関数
+
+    private:
+        //! A private member function.
+        /*!
+            配列を拡張する（SIMD命令で末尾をまとめて読み込めるように、常にPADDING個の余裕を持たせる）
+        */
+        void grow()
+        {
+            auto const newsize = index_.empty() ? NeighborPack::INITIALSIZE : 2 * static_cast<std::int32_t>(index_.size());
+
+            index_.resize(newsize);
+            for (auto i = 0; i < 3; i++) {
+                r_[i].resize(newsize);
+                f_[i].resize(newsize);
+            }
+        }
+
+        // #endregion privateメンバ関数
+
+        // #region メンバ変数
+
+    public:
+        //! A public member variable (constant).
+        /*!
+            SIMDレジスタの最大の幅（AVX-512のfloat 16個分）
+        */
+        static auto constexpr PADDING = 16;
+
+    private:
+        //! A private member variable (constant).
+        /*!
+            配列の初期の大きさ
+        */
+        static auto constexpr INITIALSIZE = 256;
+
+        //! A private member variable.
+        /*!
+            詰め込んだ原子に働く力のx, y, z成分の配列
+        */
+        std::array<array_type, 3> f_;
+
+        //! A private member variable.
+        /*!
+            詰め込んだ原子の番号
+        */
+        std::vector<std::int32_t> index_;
+
+        //! A private member variable.
+        /*!
+            詰め込んだ原子の座標のx, y, z成分の配列
+        */
+        std::array<array_type, 3> r_;
+
+        //! A private member variable.
+        /*!
+            詰め込んだ原子の個数
+        */
+        std::int32_t size_ = 0;
+
+        // #endregion メンバ変数
+    };
+
+    //! A template struct.
+    /*!
+        LJKernelの内側のループの実装（一般の型ではスカラー版のみ）
+        \tparam T 座標の型
+    */
+    template <typename T>
+    struct LJKernelImpl {
+        //! A typedef.
+        /*!
+            内側のループの関数ポインタの型
+        */
+        using kernel_type = T (*)(T periodiclen, T rc2, T Vrc, std::array<T, 3> const & ri, NeighborPack<T> & pack, bool reaction, std::array<T, 3> & fi, T & wi);
+
+        //! A public static member function.
+        /*!
+            指定されたSIMD命令セットに対応する内側のループを返す
+            \return 対応するものがなければnullptr
+        */
+        static kernel_type get(SimdType)
+        {
+            return nullptr;
+        }
+
+        //! A public static member variable (constant).
+        /*!
+            SIMD命令を用いた実装があるかどうか
+        */
+        static auto constexpr HASSIMD = false;
+    };
+
+#ifdef LJKERNEL_X86
+    //! A struct.
+    /*!
+        LJKernelの内側のループのfloat版の実装（SSE4.2, AVX2, AVX-512）
+    */
+    template <>
+    struct LJKernelImpl<float> {
+        //! A typedef.
+        /*!
+            内側のループの関数ポインタの型
+        */
+        using kernel_type = float (*)(float periodiclen, float rc2, float Vrc, std::array<float, 3> const & ri, NeighborPack<float> & pack, bool reaction, std::array<float, 3> & fi, float & wi);
+
+        //! A public static member function.
+        /*!
+            指定されたSIMD命令セットに対応する内側のループを返す
+            \param simdtype SIMD命令セット
+            \return 対応するものがなければnullptr
+        */
+        static kernel_type get(SimdType simdtype)
+        {
+            switch (simdtype) {
+            case SimdType::Sse42:
+                return &LJKernelImpl::sse42;
+
+            case SimdType::Avx2:
+                return &LJKernelImpl::avx2;
+
+            case SimdType::Avx512:
+                return &LJKernelImpl::avx512;
+
+            default:
+                return nullptr;
+            }
+        }
+
+        //! A public static member function.
+        /*!
+            SSE4.2（4原子ずつ）で内側のループを計算する
+        */
+        LJKERNEL_TARGET("sse4.2")
+        static float sse42(float periodiclen, float rc2, float Vrc, std::array<float, 3> const & ri, NeighborPack<float> & pack, bool reaction, std::array<float, 3> & fi, float & wi)
+        {
+            auto const len = _mm_set1_ps(periodiclen);
+            auto const invlen = _mm_set1_ps(1.0f / periodiclen);
+            auto const vrc2 = _mm_set1_ps(rc2);
+            auto const vVrc = _mm_set1_ps(Vrc);
+            auto const one = _mm_set1_ps(1.0f);
+            auto const c4 = _mm_set1_ps(4.0f);
+            auto const c24 = _mm_set1_ps(24.0f);
+            auto const c48 = _mm_set1_ps(48.0f);
+            auto const lane = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+            auto const num = _mm_set1_ps(static_cast<float>(pack.size()));
+
+            __m128 xi[3], fsum[3];
+            for (auto i = 0; i < 3; i++) {
+                xi[i] = _mm_set1_ps(ri[i]);
+                fsum[i] = _mm_setzero_ps();
+            }
+            auto usum = _mm_setzero_ps();
+            auto wsum = _mm_setzero_ps();
+
+            for (auto k = 0; k < pack.size(); k += 4) {
+                // 最小イメージ規約に従って距離を求める
+                __m128 d[3];
+                for (auto i = 0; i < 3; i++) {
+                    d[i] = _mm_sub_ps(xi[i], _mm_load_ps(pack.r(i) + k));
+                    d[i] = _mm_sub_ps(d[i], _mm_mul_ps(len, _mm_round_ps(_mm_mul_ps(d[i], invlen), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC)));
+                }
+
+                auto const r2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], d[0]), _mm_mul_ps(d[1], d[1])), _mm_mul_ps(d[2], d[2]));
+
+                // 末尾の余りと、打ち切り距離の外にある原子を除くマスク
+                auto const mask = _mm_and_ps(
+                    _mm_cmplt_ps(_mm_add_ps(lane, _mm_set1_ps(static_cast<float>(k))), num),
+                    _mm_cmple_ps(r2, vrc2));
+
+                auto const rm2 = _mm_div_ps(one, _mm_blendv_ps(one, r2, mask));
+                auto const rm6 = _mm_mul_ps(_mm_mul_ps(rm2, rm2), rm2);
+                auto const rm12 = _mm_mul_ps(rm6, rm6);
+
+                // 力の大きさを距離で割ったもの
+                auto const fr = _mm_and_ps(mask, _mm_mul_ps(rm2, _mm_sub_ps(_mm_mul_ps(c48, rm12), _mm_mul_ps(c24, rm6))));
+                usum = _mm_add_ps(usum, _mm_and_ps(mask, _mm_sub_ps(_mm_mul_ps(c4, _mm_sub_ps(rm12, rm6)), vVrc)));
+                wsum = _mm_add_ps(wsum, _mm_mul_ps(fr, r2));
+
+                for (auto i = 0; i < 3; i++) {
+                    auto const f = _mm_mul_ps(d[i], fr);
+                    fsum[i] = _mm_add_ps(fsum[i], f);
+
+                    if (reaction) {
+                        _mm_store_ps(pack.f(i) + k, f);
+                    }
+                }
+            }
+
+            alignas(16) float buf[4];
+            for (auto i = 0; i < 3; i++) {
+                _mm_store_ps(buf, fsum[i]);
+                fi[i] = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+            }
+
+            _mm_store_ps(buf, wsum);
+            wi = (buf[0] + buf[1]) + (buf[2] + buf[3]);
+
+            _mm_store_ps(buf, usum);
+            return (buf[0] + buf[1]) + (buf[2] + buf[3]);
+        }
+
+        //! A public static member function.
+        /*!
+            AVX2（8原子ずつ）で内側のループを計算する
+        */
+        LJKERNEL_TARGET("avx2,fma")
+        static float avx2(float periodiclen, float rc2, float Vrc, std::array<float, 3> const & ri, NeighborPack<float> & pack, bool reaction, std::array<float, 3> & fi, float & wi)
+        {
+            auto const len = _mm256_set1_ps(periodiclen);
+            auto const invlen = _mm256_set1_ps(1.0f / periodiclen);
+            auto const vrc2 = _mm256_set1_ps(rc2);
+            auto const vVrc = _mm256_set1_ps(Vrc);
+            auto const one = _mm256_set1_ps(1.0f);
+            auto const c4 = _mm256_set1_ps(4.0f);
+            auto const c24 = _mm256_set1_ps(24.0f);
+            auto const c48 = _mm256_set1_ps(48.0f);
+            auto const lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+            auto const num = _mm256_set1_epi32(pack.size());
+
+            __m256 xi[3], fsum[3];
+            for (auto i = 0; i < 3; i++) {
+                xi[i] = _mm256_set1_ps(ri[i]);
+                fsum[i] = _mm256_setzero_ps();
+            }
+            auto usum = _mm256_setzero_ps();
+            auto wsum = _mm256_setzero_ps();
+
+            for (auto k = 0; k < pack.size(); k += 8) {
+                // 最小イメージ規約に従って距離を求める
+                __m256 d[3];
+                for (auto i = 0; i < 3; i++) {
+                    d[i] = _mm256_sub_ps(xi[i], _mm256_load_ps(pack.r(i) + k));
+                    d[i] = _mm256_fnmadd_ps(len, _mm256_round_ps(_mm256_mul_ps(d[i], invlen), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC), d[i]);
+                }
+
+                auto const r2 = _mm256_fmadd_ps(d[2], d[2], _mm256_fmadd_ps(d[1], d[1], _mm256_mul_ps(d[0], d[0])));
+
+                // 末尾の余りと、打ち切り距離の外にある原子を除くマスク
+                auto const valid = _mm256_castsi256_ps(_mm256_cmpgt_epi32(num, _mm256_add_epi32(lane, _mm256_set1_epi32(k))));
+                auto const mask = _mm256_and_ps(valid, _mm256_cmp_ps(r2, vrc2, _CMP_LE_OQ));
+
+                auto const rm2 = _mm256_div_ps(one, _mm256_blendv_ps(one, r2, mask));
+                auto const rm6 = _mm256_mul_ps(_mm256_mul_ps(rm2, rm2), rm2);
+                auto const rm12 = _mm256_mul_ps(rm6, rm6);
+
+                // 力の大きさを距離で割ったもの
+                auto const fr = _mm256_and_ps(mask, _mm256_mul_ps(rm2, _mm256_fmsub_ps(c48, rm12, _mm256_mul_ps(c24, rm6))));
+                usum = _mm256_add_ps(usum, _mm256_and_ps(mask, _mm256_fmsub_ps(c4, _mm256_sub_ps(rm12, rm6), vVrc)));
+                wsum = _mm256_fmadd_ps(fr, r2, wsum);
+
+                for (auto i = 0; i < 3; i++) {
+                    auto const f = _mm256_mul_ps(d[i], fr);
+                    fsum[i] = _mm256_add_ps(fsum[i], f);
+
+                    if (reaction) {
+                        _mm256_store_ps(pack.f(i) + k, f);
+                    }
+                }
+            }
+
+            alignas(32) float buf[8];
+            for (auto i = 0; i < 3; i++) {
+                _mm256_store_ps(buf, fsum[i]);
+                fi[i] = ((buf[0] + buf[1]) + (buf[2] + buf[3])) + ((buf[4] + buf[5]) + (buf[6] + buf[7]));
+            }
+
+            _mm256_store_ps(buf, wsum);
+            wi = ((buf[0] + buf[1]) + (buf[2] + buf[3])) + ((buf[4] + buf[5]) + (buf[6] + buf[7]));
+
+            _mm256_store_ps(buf, usum);
+            return ((buf[0] + buf[1]) + (buf[2] + buf[3])) + ((buf[4] + buf[5]) + (buf[6] + buf[7]));
+        }
+
+        //! A public static member function.
+        /*!
+            AVX-512（16原子ずつ）で内側のループを計算する
+        */
+        LJKERNEL_TARGET("avx512f")
+        static float avx512(float periodiclen, float rc2, float Vrc, std::array<float, 3> const & ri, NeighborPack<float> & pack, bool reaction, std::array<float, 3> & fi, float & wi)
+        {
+            auto const len = _mm512_set1_ps(periodiclen);
+            auto const invlen = _mm512_set1_ps(1.0f / periodiclen);
+            auto const vrc2 = _mm512_set1_ps(rc2);
+            auto const vVrc = _mm512_set1_ps(Vrc);
+            auto const one = _mm512_set1_ps(1.0f);
+            auto const c4 = _mm512_set1_ps(4.0f);
+            auto const c24 = _mm512_set1_ps(24.0f);
+            auto const c48 = _mm512_set1_ps(48.0f);
+
+            __m512 xi[3], fsum[3];
+            for (auto i = 0; i < 3; i++) {
+                xi[i] = _mm512_set1_ps(ri[i]);
+                fsum[i] = _mm512_setzero_ps();
+            }
+            auto usum = _mm512_setzero_ps();
+            auto wsum = _mm512_setzero_ps();
+
+            for (auto k = 0; k < pack.size(); k += 16) {
+                // 末尾の余りを除くマスク
+                auto const rest = pack.size() - k;
+                auto const valid = rest >= 16 ? static_cast<__mmask16>(0xFFFF) : static_cast<__mmask16>((1 << rest) - 1);
+
+                // 最小イメージ規約に従って距離を求める
+                // （_mm512_roundscale_psは中の_mm512_undefined_psがGCCで-Wmaybe-uninitializedの警告を出すので、全てのレーンのマスク付きのものを使う）
+                __m512 d[3];
+                for (auto i = 0; i < 3; i++) {
+                    d[i] = _mm512_sub_ps(xi[i], _mm512_load_ps(pack.r(i) + k));
+                    d[i] = _mm512_fnmadd_ps(len, _mm512_maskz_roundscale_ps(static_cast<__mmask16>(0xFFFF), _mm512_mul_ps(d[i], invlen), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC), d[i]);
+                }
+
+                auto const r2 = _mm512_fmadd_ps(d[2], d[2], _mm512_fmadd_ps(d[1], d[1], _mm512_mul_ps(d[0], d[0])));
+
+                // 打ち切り距離の外にある原子を除くマスク
+                auto const mask = _mm512_mask_cmp_ps_mask(valid, r2, vrc2, _CMP_LE_OQ);
+
+                auto const rm2 = _mm512_div_ps(one, _mm512_mask_blend_ps(mask, one, r2));
+                auto const rm6 = _mm512_mul_ps(_mm512_mul_ps(rm2, rm2), rm2);
+                auto const rm12 = _mm512_mul_ps(rm6, rm6);
+
+                // 力の大きさを距離で割ったもの
+                auto const fr = _mm512_maskz_mov_ps(mask, _mm512_mul_ps(rm2, _mm512_fmsub_ps(c48, rm12, _mm512_mul_ps(c24, rm6))));
+                usum = _mm512_mask_add_ps(usum, mask, usum, _mm512_fmsub_ps(c4, _mm512_sub_ps(rm12, rm6), vVrc));
+                wsum = _mm512_fmadd_ps(fr, r2, wsum);
+
+                for (auto i = 0; i < 3; i++) {
+                    auto const f = _mm512_mul_ps(d[i], fr);
+                    fsum[i] = _mm512_add_ps(fsum[i], f);
+
+                    if (reaction) {
+                        _mm512_store_ps(pack.f(i) + k, f);
+                    }
+                }
+            }
+
+            for (auto i = 0; i < 3; i++) {
+                fi[i] = hsum512(fsum[i]);
+            }
+
+            wi = hsum512(wsum);
+
+            return hsum512(usum);
+        }
+
+        //! A public static member function.
+        /*!
+            AVX-512のベクトルの16個の成分の和を求める
+            （GCCでは_mm512_reduce_add_psの中の_mm256_undefined_pdが-Wuninitializedの警告を出すので、配列に書き出して足す）
+            \param v ベクトル
+            \return 成分の和
+        */
+        LJKERNEL_TARGET("avx512f")
+        static float hsum512(__m512 v)
+        {
+            alignas(64) float buf[16];
+            _mm512_store_ps(buf, v);
+
+            return (((buf[0] + buf[1]) + (buf[2] + buf[3])) + ((buf[4] + buf[5]) + (buf[6] + buf[7]))) +
+                (((buf[8] + buf[9]) + (buf[10] + buf[11])) + ((buf[12] + buf[13]) + (buf[14] + buf[15])));
+        }
+
+        //! A public static member variable (constant).
+        /*!
+            SIMD命令を用いた実装があるかどうか
+        */
+        static auto constexpr HASSIMD = true;
+    };
+#endif
+
+    //! A template class.
+    /*!
+        原子と、その近接原子との間に働くLennard-Jones力を、実行時に選択したSIMD命令を用いて計算するクラス
+        \tparam T 座標の型
+    */
+    template <typename T>
+    class LJKernel final {
+        // #region コンストラクタ・デストラクタ
+
+    public:
+        //! A constructor.
+        /*!
+            デフォルトコンストラクタ
+        */
+        LJKernel() = default;
+
+        //! A destructor.
+        /*!
+            デフォルトデストラクタ
+        */
+        ~LJKernel() = default;
+
+        // #endregion コンストラクタ・デストラクタ
+
+        // #region publicメンバ関数
+
+        //! A public member function (constant).
+        /*!
+            原子と、詰め込まれた近接原子との間に働く力とポテンシャルエネルギーを計算する
+            \param ri 原子の座標
+            \param pack 詰め込まれた近接原子（reactionがtrueなら、各近接原子に働く力が書き込まれる）
+            \param reaction 各近接原子に働く力を書き込むならtrue
+            \param fi 原子に働く力
+            \param wi ビリアルの和（二重計算の補正はしない）
+            \return ポテンシャルエネルギーの和（二重計算の補正はしない）
+        */
+        T operator()(std::array<T, 3> const & ri, NeighborPack<T> & pack, bool reaction, std::array<T, 3> & fi, T & wi) const
+        {
+            return kernel_(periodiclen_, rc2_, Vrc_, ri, pack, reaction, fi, wi);
+        }
+
+        //! A public member function.
+        /*!
+            使用するSIMD命令セットと、ポテンシャルのパラメータを設定する
+            \param simdtype 使用するSIMD命令セット（CPUが対応していなければ、対応する中で最も新しいもの）
+            \param periodiclen 周期境界条件の長さ
+            \param rc2 カットオフ半径の二乗
+            \param Vrc ポテンシャルエネルギーの打ち切り
+        */
+        void setup(SimdType simdtype, T periodiclen, T rc2, T Vrc)
+        {
+            periodiclen_ = periodiclen;
+            rc2_ = rc2;
+            Vrc_ = Vrc;
+
+            simdtype_ = std::min(simdtype, LJKernel::detect());
+            auto const kernel = LJKernelImpl<T>::get(simdtype_);
+            if (kernel) {
+                kernel_ = kernel;
+            }
+            else {
+                simdtype_ = SimdType::Scalar;
+                kernel_ = &LJKernel::scalar;
+            }
+        }
+
+        //! A public member function (constant).
+        /*!
+            使用しているSIMD命令セットを返す
+            \return 使用しているSIMD命令セット
+        */
+        SimdType simdtype() const
+        {
+            return simdtype_;
+        }
+
+        //! A public static member function.
+        /*!
+            CPUと、このクラスの実装が対応する最も新しいSIMD命令セットを調べる
+            \return 対応する最も新しいSIMD命令セット
+        */
+        static SimdType detect();
+
+        //! A public static member function.
+        /*!
+            SIMD命令セットの名前を返す
+            \param simdtype SIMD命令セット
+            \return SIMD命令セットの名前
+        */
+        static char const * name(SimdType simdtype)
+        {
+            switch (simdtype) {
+            case SimdType::Sse42:
+                return "SSE4.2 (4 atoms per instruction)";
+
+            case SimdType::Avx2:
+                return "AVX2 (8 atoms per instruction)";
+
+            case SimdType::Avx512:
+                return "AVX-512 (16 atoms per instruction)";
+
+            default:
+                return "Scalar";
+            }
+        }
+
+        // #endregion publicメンバ関数
+
+        // #region privateメンバ関数
+
+    private:
+        //! A private static member function.
+        /*!
+            スカラー命令で内側のループを計算する
+        */
+        static T scalar(T periodiclen, T rc2, T Vrc, std::array<T, 3> const & ri, NeighborPack<T> & pack, bool reaction, std::array<T, 3> & fi, T & wi);
+
+        // #endregion privateメンバ関数
+
+        // #region メンバ変数
+
+        //! A private member variable.
+        /*!
+            内側のループの関数へのポインタ
+        */
+        typename LJKernelImpl<T>::kernel_type kernel_ = &LJKernel::scalar;
+
+        //! A private member variable.
+        /*!
+            周期境界条件の長さ
+        */
+        T periodiclen_ = 0;
+
+        //! A private member variable.
+        /*!
+            カットオフ半径の二乗
+        */
+        T rc2_ = 0;
+
+        //! A private member variable.
+        /*!
+            使用しているSIMD命令セット
+        */
+        SimdType simdtype_ = SimdType::Scalar;
+
+        //! A private member variable.
+        /*!
+            ポテンシャルエネルギーの打ち切り
+        */
+        T Vrc_ = 0;
+
+        // #endregion メンバ変数
+
+        // #region 禁止されたコンストラクタ・メンバ関数
+
+        //! A private copy constructor (deleted).
+        /*!
+            コピーコンストラクタ（禁止）
+        */
+        LJKernel(LJKernel const &) = delete;
+
+        //! A private member function (deleted).
+        /*!
+            operator=()の宣言（禁止）
+            \param コピー元のオブジェクト（未使用）
+            \return コピー元のオブジェクト
+        */
+        LJKernel & operator=(LJKernel const &) = delete;
+
+        // #endregion 禁止されたコンストラクタ・メンバ関数
+    };
+
+    // #region publicメンバ関数
+
+    template <typename T>
+    SimdType LJKernel<T>::detect()
+    {
+        if (!LJKernelImpl<T>::HASSIMD) {
+            return SimdType::Scalar;
+        }
+
+#if defined(LJKERNEL_X86) && defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        auto const nids = info[0];
+
+        __cpuid(info, 1);
+        auto const sse42 = (info[2] & (1 << 20)) != 0;
+        auto const fma = (info[2] & (1 << 12)) != 0;
+        auto const osxsave = (info[2] & (1 << 27)) != 0;
+
+        // OSがYMM/ZMMレジスタを保存するかどうか
+        auto const xcr0 = osxsave ? _xgetbv(0) : 0;
+        auto const ymm = (xcr0 & 0x6) == 0x6;
+        auto const zmm = (xcr0 & 0xE6) == 0xE6;
+
+        auto avx2 = false;
+        auto avx512f = false;
+        if (nids >= 7) {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+            avx512f = (info[1] & (1 << 16)) != 0;
+        }
+
+        if (avx512f && zmm) {
+            return SimdType::Avx512;
+        }
+        else if (avx2 && fma && ymm) {
+            return SimdType::Avx2;
+        }
+        else if (sse42) {
+            return SimdType::Sse42;
+        }
+#elif defined(LJKERNEL_X86) && defined(__GNUC__)
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx512f")) {
+            return SimdType::Avx512;
+        }
+        else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            return SimdType::Avx2;
+        }
+        else if (__builtin_cpu_supports("sse4.2")) {
+            return SimdType::Sse42;
+        }
+#endif
+
+        return SimdType::Scalar;
+    }
+
+    // #endregion publicメンバ関数
+
+    // #region privateメンバ関数
+
+    template <typename T>
+    T LJKernel<T>::scalar(T periodiclen, T rc2, T Vrc, std::array<T, 3> const & ri, NeighborPack<T> & pack, bool reaction, std::array<T, 3> & fi, T & wi)
+    {
+        auto Up = static_cast<T>(0);
+        fi = { { static_cast<T>(0), static_cast<T>(0), static_cast<T>(0) } };
+        wi = static_cast<T>(0);
+
+        for (auto k = 0; k < pack.size(); k++) {
+            // 最小イメージ規約に従って距離を求める
+            std::array<T, 3> d;
+            for (auto i = 0; i < 3; i++) {
+                d[i] = ri[i] - pack.r(i)[k];
+                d[i] -= periodiclen * std::nearbyint(d[i] / periodiclen);
+            }
+
+            auto const r2 = d[0] * d[0] + d[1] * d[1] + d[2] * d[2];
+
+            auto fr = static_cast<T>(0);
+            // 打ち切り距離内であれば計算
+            if (r2 <= rc2) {
+                auto const rm2 = 1.0 / r2;
+                auto const rm6 = rm2 * rm2 * rm2;
+                auto const rm12 = rm6 * rm6;
+
+                fr = rm2 * (48.0 * rm12 - 24.0 * rm6);
+                Up += 4.0 * (rm12 - rm6) - Vrc;
+                wi += fr * r2;
+            }
+
+            for (auto i = 0; i < 3; i++) {
+                fi[i] += d[i] * fr;
+
+                if (reaction) {
+                    pack.f(i)[k] = d[i] * fr;
+                }
+            }
+        }
+
+        return Up;
+    }
+
+    // #endregion privateメンバ関数
+}
+
+#endif  // _LJKERNEL_H_
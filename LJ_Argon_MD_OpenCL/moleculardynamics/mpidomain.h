@@ -0,0 +1,863 @@
+﻿/*! \file mpidomain.h
+    \brief MPIで周期境界条件の箱を空間分割し、各プロセスが受け持つ原子とゴースト原子を管理するクラスの宣言と実装
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _MPIDOMAIN_H_
+#define _MPIDOMAIN_H_
+
+#pragma once
+
+#include "particlestore.h"
+#include <algorithm>                                // for std::max, std::min
+#include <array>                                    // for std::array
+#include <cmath>                                    // for std::floor
+#include <cstdint>                                  // for std::int32_t, std::int64_t
+#include <functional>                               // for std::plus
+#include <stdexcept>                                // for std::runtime_error
+#include <vector>                                   // for std::vector
+#include <boost/mpi/cartesian_communicator.hpp>     // for boost::mpi::cartesian_dimensions
+#include <boost/mpi/collectives/all_gather.hpp>     // for boost::mpi::all_gather
+#include <boost/mpi/collectives/all_gatherv.hpp>    // for boost::mpi::all_gatherv
+#include <boost/mpi/collectives/all_reduce.hpp>     // for boost::mpi::all_reduce
+#include <boost/mpi/collectives/broadcast.hpp>      // for boost::mpi::broadcast
+#include <boost/mpi/communicator.hpp>               // for boost::mpi::communicator
+#include <boost/mpi/nonblocking.hpp>                // for boost::mpi::wait_all
+#include <boost/mpi/request.hpp>                    // for boost::mpi::request
+#include <tbb/tick_count.h>                         // for tbb::tick_count
+
+namespace moleculardynamics {
+    //! A template class.
+    /*!
+        MPIで周期境界条件の箱をプロセスの個数だけの直方体（部分領域）に分け、
+        各プロセスが受け持つ原子と、部分領域の境界からカットオフ半径以内にある他の部分領域の原子（ゴースト原子）を管理するクラス
+        \tparam T 座標の型
+    */
+    template <typename T>
+    class MpiDomain final {
+        // #region コンストラクタ・デストラクタ
+
+    public:
+        //! A constructor.
+        /*!
+            デフォルトコンストラクタ（MPI_COMM_WORLDの全てのプロセスで分割する）
+        */
+        MpiDomain() = default;
+
+        //! A destructor.
+        /*!
+            デフォルトデストラクタ
+        */
+        ~MpiDomain() = default;
+
+        // #endregion コンストラクタ・デストラクタ
+
+        // #region publicメンバ関数
+
+        //! A public member function.
+        /*!
+            隣の部分領域とゴースト原子を交換し、受け持つ原子とゴースト原子のセルリストを構築する
+            （x, y, zの順に交換し、前の方向で受け取ったゴースト原子も送るので、角や辺の向こうの原子も届く）
+        */
+        void exchangeGhosts();
+
+        //! A public member function (constant).
+        /*!
+            n個目の原子が属するセルとそれに隣接するセルにある、n個目以外の全ての原子（ゴースト原子を含む）について関数を呼び出す
+            \param n 受け持つ原子の番号
+            \param f 原子の番号を引数として呼び出す関数
+        */
+        template <typename Function>
+        void forEachNeighbor(std::int32_t n, Function const & f) const;
+
+        //! A public member function.
+        /*!
+            全てのプロセスが受け持つ原子を集めて、元の原子の番号の位置に書き込む（全てのプロセスで呼び出す）
+            \param r 原子の座標
+            \param r1 1ステップ前の原子の座標
+            \param V 原子の速度
+            \param F 原子に働く力
+        */
+        void gather(ParticleStore<T> & r, ParticleStore<T> & r1, ParticleStore<T> & V, ParticleStore<T> & F) const;
+
+        //! A public member function (constant).
+        /*!
+            各方向の部分領域の個数を返す
+            \return 各方向の部分領域の個数
+        */
+        std::array<std::int32_t, 3> const & getDims() const
+        {
+            return dims_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            ゴースト原子を交換した回数を返す
+            \return ゴースト原子を交換した回数
+        */
+        std::int64_t getExchangeCount() const
+        {
+            return exchangecount_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            ゴースト原子の交換と原子の移動にかかった時間の合計を返す
+            \return ゴースト原子の交換と原子の移動にかかった時間の合計（秒）
+        */
+        double getExchangeTime() const
+        {
+            return exchangetime_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            ゴースト原子を交換したときに受け取ったゴースト原子の個数の合計を返す
+            \return ゴースト原子の個数の合計
+        */
+        std::int64_t getGhostCount() const
+        {
+            return ghostcount_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            他のプロセスに移した原子の個数の合計を返す
+            \return 他のプロセスに移した原子の個数の合計
+        */
+        std::int64_t getMigrationCount() const
+        {
+            return migrationcount_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            ゴースト原子を交換したときに受け持っていた原子の個数の合計を返す
+            \return 受け持っていた原子の個数の合計
+        */
+        std::int64_t getOwnedCount() const
+        {
+            return ownedcount_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            受け持つ原子の元の原子の番号の配列を返す
+            \return 受け持つ原子の元の原子の番号の配列
+        */
+        std::vector<std::int32_t> const & id() const
+        {
+            return id_;
+        }
+
+        //! A public member function.
+        /*!
+            時間発展で部分領域の外に出た原子を、その原子を含む部分領域のプロセスに移す（全てのプロセスで呼び出す）
+        */
+        void migrate();
+
+        //! A public member function (constant).
+        /*!
+            受け持つ原子の個数を返す
+            \return 受け持つ原子の個数
+        */
+        std::int32_t nlocal() const
+        {
+            return nlocal_;
+        }
+
+        //! A public member function.
+        /*!
+            受け持つ原子の座標の配列を返す（受け持つ原子の後ろにゴースト原子が続く）
+            \return 座標の配列
+        */
+        ParticleStore<T> & r()
+        {
+            return r_;
+        }
+
+        //! A public member function.
+        /*!
+            受け持つ原子の1ステップ前の座標の配列を返す
+            \return 1ステップ前の座標の配列
+        */
+        ParticleStore<T> & r1()
+        {
+            return r1_;
+        }
+
+        //! A public member function.
+        /*!
+            受け持つ原子に働く力の配列を返す
+            \return 力の配列
+        */
+        ParticleStore<T> & F()
+        {
+            return F_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            このプロセスの番号を返す
+            \return このプロセスの番号
+        */
+        std::int32_t rank() const
+        {
+            return world_.rank();
+        }
+
+        //! A public member function.
+        /*!
+            最初のプロセスの全ての原子の値を全てのプロセスに配り、そのうちこのプロセスの部分領域にあるものを受け持つ原子として選ぶ
+            （初期速度は乱数で決めるので、プロセスごとに異なる）
+            \param r 原子の座標
+            \param r1 1ステップ前の原子の座標
+            \param V 原子の速度
+            \param F 原子に働く力
+            \param numatom 原子数
+        */
+        void scatter(ParticleStore<T> & r, ParticleStore<T> & r1, ParticleStore<T> & V, ParticleStore<T> & F, std::int32_t numatom);
+
+        //! A public member function.
+        /*!
+            プロセスの個数と周期境界条件の長さから、部分領域への分割とセルの分割を決める
+            \param periodiclen 周期境界条件の長さ
+            \param rc カットオフ半径
+            \throw std::runtime_error 部分領域の幅がカットオフ半径より短いか、周期境界条件の長さがカットオフ半径の2倍より短い場合
+        */
+        void setup(T periodiclen, T rc);
+
+        //! A public member function (constant).
+        /*!
+            プロセスの個数を返す
+            \return プロセスの個数
+        */
+        std::int32_t size() const
+        {
+            return world_.size();
+        }
+
+        //! A public member function (constant).
+        /*!
+            全てのプロセスの値の和を返す（全てのプロセスで呼び出す）
+            \param value このプロセスの値
+            \return 全てのプロセスの値の和
+        */
+        T sum(T value) const
+        {
+            return boost::mpi::all_reduce(world_, value, std::plus<T>());
+        }
+
+        //! A public member function.
+        /*!
+            受け持つ原子の速度の配列を返す
+            \return 速度の配列
+        */
+        ParticleStore<T> & V()
+        {
+            return V_;
+        }
+
+        // #endregion publicメンバ関数
+
+        // #region privateメンバ関数
+
+    private:
+        //! A private member function.
+        /*!
+            受け持つ原子とゴースト原子を、それぞれが属するセルの番号順に並べる
+        */
+        void BuildCells();
+
+        //! A private member function (constant).
+        /*!
+            座標からその座標が属するセルのd方向の番号を求める
+            （セルは部分領域の両側にカットオフ半径だけ広げた範囲を分割する）
+            \param x 座標のd方向の成分
+            \param d 方向
+            \return セルのd方向の番号
+        */
+        std::int32_t cellindex(T x, std::int32_t d) const
+        {
+            auto const i = static_cast<std::int32_t>(std::floor((x - lo_[d] + rc_) * invcellsize_[d]));
+            return std::min(std::max(i, 0), ncell_[d] - 1);
+        }
+
+        //! A private member function (constant).
+        /*!
+            d方向のdir側（0なら下、1なら上）の隣のプロセスに送り、反対側の隣のプロセスから受け取る
+            \param d 方向
+            \param dir 送る側（0なら下、1なら上）
+            \param send 送る配列
+            \param recv 受け取る配列
+        */
+        template <typename U>
+        void Exchange(std::int32_t d, std::int32_t dir, std::vector<U> const & send, std::vector<U> & recv) const;
+
+        //! A private member function (constant).
+        /*!
+            座標のd方向の成分から、その座標を含む部分領域のd方向の番号を求める
+            \param x 座標のd方向の成分
+            \param d 方向
+            \return 部分領域のd方向の番号
+        */
+        std::int32_t owner(T x, std::int32_t d) const
+        {
+            auto const c = static_cast<std::int32_t>(std::floor(x / width_[d]));
+            return std::min(std::max(c, 0), dims_[d] - 1);
+        }
+
+        // #endregion privateメンバ関数
+
+        // #region メンバ変数
+
+        //! A private member variable (constant).
+        /*!
+            原子を移すときに、1個の原子について送る座標・1ステップ前の座標・速度の成分の個数
+        */
+        static auto constexpr MIGRATESIZE = 9;
+
+        //! A private member variable (constant).
+        /*!
+            プロセスの間で配る・集めるときに、1個の原子について送る座標・1ステップ前の座標・速度・力の成分の個数
+        */
+        static auto constexpr STATESIZE = 12;
+
+        //! A private member variable.
+        /*!
+            セルに属する原子の番号を、セルの番号順に並べた配列
+        */
+        std::vector<std::int32_t> cellatom_;
+
+        //! A private member variable.
+        /*!
+            各セルの先頭の位置
+        */
+        std::vector<std::int32_t> cellstart_;
+
+        //! A private member variable.
+        /*!
+            n個目の原子（ゴースト原子を含む）が属するセルの番号
+        */
+        std::vector<std::int32_t> atomcell_;
+
+        //! A private member variable.
+        /*!
+            このプロセスの部分領域の各方向の番号
+        */
+        std::array<std::int32_t, 3> coords_ = { { 0, 0, 0 } };
+
+        //! A private member variable.
+        /*!
+            各方向の部分領域の個数
+        */
+        std::array<std::int32_t, 3> dims_ = { { 1, 1, 1 } };
+
+        //! A private member variable.
+        /*!
+            ゴースト原子を交換した回数
+        */
+        std::int64_t exchangecount_ = 0;
+
+        //! A private member variable.
+        /*!
+            ゴースト原子の交換と原子の移動にかかった時間の合計（秒）
+        */
+        double exchangetime_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            受け持つ原子に働く力
+        */
+        ParticleStore<T> F_;
+
+        //! A private member variable.
+        /*!
+            受け取ったゴースト原子の個数の合計
+        */
+        std::int64_t ghostcount_ = 0;
+
+        //! A private member variable.
+        /*!
+            部分領域の各方向の上の境界
+        */
+        std::array<T, 3> hi_ = { { 0, 0, 0 } };
+
+        //! A private member variable.
+        /*!
+            受け持つ原子の元の原子の番号
+        */
+        std::vector<std::int32_t> id_;
+
+        //! A private member variable.
+        /*!
+            セルの各方向の一辺の長さの逆数
+        */
+        std::array<T, 3> invcellsize_ = { { 0, 0, 0 } };
+
+        //! A private member variable.
+        /*!
+            部分領域の各方向の下の境界
+        */
+        std::array<T, 3> lo_ = { { 0, 0, 0 } };
+
+        //! A private member variable.
+        /*!
+            他のプロセスに移した原子の個数の合計
+        */
+        std::int64_t migrationcount_ = 0;
+
+        //! A private member variable.
+        /*!
+            各方向の下（0）と上（1）の隣のプロセスの番号
+        */
+        std::array<std::array<std::int32_t, 2>, 3> neighbor_ = { { { { 0, 0 } }, { { 0, 0 } }, { { 0, 0 } } } };
+
+        //! A private member variable.
+        /*!
+            セルの各方向の個数
+        */
+        std::array<std::int32_t, 3> ncell_ = { { 1, 1, 1 } };
+
+        //! A private member variable.
+        /*!
+            受け持つ原子の個数
+        */
+        std::int32_t nlocal_ = 0;
+
+        //! A private member variable.
+        /*!
+            ゴースト原子を交換したときに受け持っていた原子の個数の合計
+        */
+        std::int64_t ownedcount_ = 0;
+
+        //! A private member variable.
+        /*!
+            周期境界条件の長さ
+        */
+        T periodiclen_ = 0;
+
+        //! A private member variable.
+        /*!
+            受け持つ原子の座標（後ろにゴースト原子の座標が続く）
+        */
+        ParticleStore<T> r_;
+
+        //! A private member variable.
+        /*!
+            受け持つ原子の1ステップ前の座標
+        */
+        ParticleStore<T> r1_;
+
+        //! A private member variable.
+        /*!
+            カットオフ半径
+        */
+        T rc_ = 0;
+
+        //! A private member variable.
+        /*!
+            受け持つ原子の速度
+        */
+        ParticleStore<T> V_;
+
+        //! A private member variable.
+        /*!
+            部分領域の各方向の幅
+        */
+        std::array<T, 3> width_ = { { 0, 0, 0 } };
+
+        //! A private member variable.
+        /*!
+            全てのプロセスのコミュニケータ
+        */
+        boost::mpi::communicator world_;
+
+        // #endregion メンバ変数
+
+        // #region 禁止されたコンストラクタ・メンバ関数
+
+        //! A private copy constructor (deleted).
+        /*!
+            コピーコンストラクタ（禁止）
+        */
+        MpiDomain(MpiDomain const &) = delete;
+
+        //! A private member function (deleted).
+        /*!
+            operator=()の宣言（禁止）
+            \param コピー元のオブジェクト（未使用）
+            \return コピー元のオブジェクト
+        */
+        MpiDomain & operator=(MpiDomain const &) = delete;
+
+        // #endregion 禁止されたコンストラクタ・メンバ関数
+    };
+
+    // #region publicメンバ関数
+
+    template <typename T>
+    void MpiDomain<T>::exchangeGhosts()
+    {
+        auto const start = tbb::tick_count::now();
+
+        // 前のステップのゴースト原子を捨てる
+        r_.resize(nlocal_);
+
+        std::vector<T> send, recv;
+        for (auto d = 0; d < 3; d++) {
+            // この方向で受け取ったゴースト原子は、同じ方向には送り返さない
+            auto const ncandidate = r_.size();
+
+            for (auto dir = 0; dir < 2; dir++) {
+                // 箱の端を越えて送る場合は、受け取る側から見た周期境界条件のイメージの座標にする
+                auto shift = static_cast<T>(0);
+                if (dir == 0 && coords_[d] == 0) {
+                    shift = periodiclen_;
+                }
+                else if (dir == 1 && coords_[d] == dims_[d] - 1) {
+                    shift = -periodiclen_;
+                }
+
+                // 下の隣には下の境界から、上の隣には上の境界からカットオフ半径以内の原子を送る
+                send.clear();
+                for (auto n = 0; n < ncandidate; n++) {
+                    auto const x = r_[n][d];
+                    if (dir == 0 ? x < lo_[d] + rc_ : x >= hi_[d] - rc_) {
+                        for (auto i = 0; i < 3; i++) {
+                            send.push_back(i == d ? r_[n][i] + shift : r_[n][i]);
+                        }
+                    }
+                }
+
+                Exchange(d, dir, send, recv);
+
+                auto const first = r_.size();
+                auto const count = static_cast<std::int32_t>(recv.size() / 3);
+                r_.resize(first + count);
+                for (auto n = 0; n < count; n++) {
+                    r_.set(first + n, { { recv[3 * n], recv[3 * n + 1], recv[3 * n + 2] } });
+                }
+            }
+        }
+
+        BuildCells();
+
+        exchangecount_++;
+        ghostcount_ += r_.size() - nlocal_;
+        ownedcount_ += nlocal_;
+        exchangetime_ += (tbb::tick_count::now() - start).seconds();
+    }
+
+    template <typename T>
+    template <typename Function>
+    void MpiDomain<T>::forEachNeighbor(std::int32_t n, Function const & f) const
+    {
+        auto const c = atomcell_[n];
+        auto const ci = c / (ncell_[1] * ncell_[2]);
+        auto const cj = (c / ncell_[2]) % ncell_[1];
+        auto const ck = c % ncell_[2];
+
+        // セルは周期的ではない（箱の端の向こうはゴースト原子が埋めている）ので、範囲の外のセルは調べない
+        for (auto i = std::max(ci - 1, 0); i <= std::min(ci + 1, ncell_[0] - 1); i++) {
+            for (auto j = std::max(cj - 1, 0); j <= std::min(cj + 1, ncell_[1] - 1); j++) {
+                for (auto k = std::max(ck - 1, 0); k <= std::min(ck + 1, ncell_[2] - 1); k++) {
+                    auto const cell = (i * ncell_[1] + j) * ncell_[2] + k;
+                    for (auto p = cellstart_[cell]; p < cellstart_[cell + 1]; p++) {
+                        auto const m = cellatom_[p];
+                        if (m != n) {
+                            f(m);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename T>
+    void MpiDomain<T>::gather(ParticleStore<T> & r, ParticleStore<T> & r1, ParticleStore<T> & V, ParticleStore<T> & F) const
+    {
+        // 各プロセスが受け持つ原子の個数
+        std::vector<std::int32_t> sizes;
+        boost::mpi::all_gather(world_, nlocal_, sizes);
+
+        std::vector<std::int32_t> ids;
+        boost::mpi::all_gatherv(world_, id_, ids, sizes);
+
+        // 座標・1ステップ前の座標・速度・力をまとめて送る
+        std::vector<T> data;
+        data.reserve(MpiDomain::STATESIZE * nlocal_);
+        for (auto n = 0; n < nlocal_; n++) {
+            for (auto store : { &r_, &r1_, &V_, &F_ }) {
+                for (auto i = 0; i < 3; i++) {
+                    data.push_back((*store)[n][i]);
+                }
+            }
+        }
+
+        for (auto & size : sizes) {
+            size *= MpiDomain::STATESIZE;
+        }
+
+        std::vector<T> all;
+        boost::mpi::all_gatherv(world_, data, all, sizes);
+
+        for (auto k = 0U; k < ids.size(); k++) {
+            auto const n = ids[k];
+            auto const p = all.data() + MpiDomain::STATESIZE * k;
+            r.set(n, { { p[0], p[1], p[2] } });
+            r1.set(n, { { p[3], p[4], p[5] } });
+            V.set(n, { { p[6], p[7], p[8] } });
+            F.set(n, { { p[9], p[10], p[11] } });
+        }
+    }
+
+    template <typename T>
+    void MpiDomain<T>::migrate()
+    {
+        auto const start = tbb::tick_count::now();
+
+        // ゴースト原子を捨てる
+        r_.resize(nlocal_);
+
+        std::array<std::vector<std::int32_t>, 2> sendid;
+        std::array<std::vector<T>, 2> senddata;
+        std::vector<std::int32_t> recvid;
+        std::vector<T> recvdata;
+
+        for (auto d = 0; d < 3; d++) {
+            // この方向に分割していなければ、外に出る原子は無い
+            if (dims_[d] == 1) {
+                continue;
+            }
+
+            for (auto dir = 0; dir < 2; dir++) {
+                sendid[dir].clear();
+                senddata[dir].clear();
+            }
+
+            // 部分領域の外に出た原子を取り出し、抜けた所に最後の原子を詰める
+            // （1ステップで隣の部分領域より遠くに動くことはない）
+            for (auto n = nlocal_ - 1; n >= 0; n--) {
+                auto const c = owner(r_[n][d], d);
+                if (c == coords_[d]) {
+                    continue;
+                }
+
+                auto const dir = c == (coords_[d] + 1) % dims_[d] ? 1 : 0;
+                sendid[dir].push_back(id_[n]);
+                for (auto store : { &r_, &r1_, &V_ }) {
+                    for (auto i = 0; i < 3; i++) {
+                        senddata[dir].push_back((*store)[n][i]);
+                    }
+                }
+
+                auto const last = nlocal_ - 1;
+                id_[n] = id_[last];
+                r_.set(n, r_.get(last));
+                r1_.set(n, r1_.get(last));
+                V_.set(n, V_.get(last));
+                nlocal_--;
+
+                migrationcount_++;
+            }
+
+            id_.resize(nlocal_);
+
+            for (auto dir = 0; dir < 2; dir++) {
+                Exchange(d, dir, sendid[dir], recvid);
+                Exchange(d, dir, senddata[dir], recvdata);
+
+                // 受け取った原子を受け持つ原子の後ろに加える
+                auto const first = nlocal_;
+                auto const count = static_cast<std::int32_t>(recvid.size());
+                nlocal_ += count;
+                r_.resize(nlocal_);
+                r1_.resize(nlocal_);
+                V_.resize(nlocal_);
+
+                for (auto n = 0; n < count; n++) {
+                    auto const p = recvdata.data() + MpiDomain::MIGRATESIZE * n;
+                    id_.push_back(recvid[n]);
+                    r_.set(first + n, { { p[0], p[1], p[2] } });
+                    r1_.set(first + n, { { p[3], p[4], p[5] } });
+                    V_.set(first + n, { { p[6], p[7], p[8] } });
+                }
+            }
+        }
+
+        // 力は次のステップで求め直す
+        r1_.resize(nlocal_);
+        V_.resize(nlocal_);
+        F_.resize(nlocal_);
+
+        exchangetime_ += (tbb::tick_count::now() - start).seconds();
+    }
+
+    template <typename T>
+    void MpiDomain<T>::scatter(ParticleStore<T> & r, ParticleStore<T> & r1, ParticleStore<T> & V, ParticleStore<T> & F, std::int32_t numatom)
+    {
+        // 座標・1ステップ前の座標・速度・力をまとめて、最初のプロセスから配る
+        std::vector<T> data(MpiDomain::STATESIZE * numatom);
+        if (world_.rank() == 0) {
+            for (auto n = 0; n < numatom; n++) {
+                auto p = data.data() + MpiDomain::STATESIZE * n;
+                for (auto store : { &r, &r1, &V, &F }) {
+                    for (auto i = 0; i < 3; i++) {
+                        *p++ = (*store)[n][i];
+                    }
+                }
+            }
+        }
+
+        boost::mpi::broadcast(world_, data.data(), static_cast<std::int32_t>(data.size()), 0);
+
+        if (world_.rank() != 0) {
+            for (auto n = 0; n < numatom; n++) {
+                auto const p = data.data() + MpiDomain::STATESIZE * n;
+                r.set(n, { { p[0], p[1], p[2] } });
+                r1.set(n, { { p[3], p[4], p[5] } });
+                V.set(n, { { p[6], p[7], p[8] } });
+                F.set(n, { { p[9], p[10], p[11] } });
+            }
+        }
+
+        // 初期配置の座標は箱の中心が原点になっているので、[0, 周期境界条件の長さ)に移してから受け持つ原子を選ぶ
+        // （1ステップ前の座標も同じだけずらす）
+        id_.clear();
+        r_.resize(numatom);
+        r1_.resize(numatom);
+        for (auto n = 0; n < numatom; n++) {
+            std::array<T, 3> rn, r1n;
+            auto own = true;
+            for (auto i = 0; i < 3; i++) {
+                auto const shift = periodiclen_ * std::floor(r[n][i] / periodiclen_);
+                rn[i] = r[n][i] - shift;
+                r1n[i] = r1[n][i] - shift;
+                own = own && owner(rn[i], i) == coords_[i];
+            }
+
+            if (own) {
+                auto const k = static_cast<std::int32_t>(id_.size());
+                r_.set(k, rn);
+                r1_.set(k, r1n);
+                id_.push_back(n);
+            }
+        }
+
+        nlocal_ = static_cast<std::int32_t>(id_.size());
+        r_.resize(nlocal_);
+        r1_.resize(nlocal_);
+        V_.resize(nlocal_);
+        F_.resize(nlocal_);
+
+        for (auto k = 0; k < nlocal_; k++) {
+            auto const n = id_[k];
+            V_.set(k, V.get(n));
+            F_.set(k, F.get(n));
+        }
+    }
+
+    template <typename T>
+    void MpiDomain<T>::setup(T periodiclen, T rc)
+    {
+        periodiclen_ = periodiclen;
+        rc_ = rc;
+
+        // ゴースト原子は周期境界条件の最も近いイメージだけを考える
+        if (periodiclen < 2 * rc) {
+            throw std::runtime_error("The periodic box is shorter than twice the cutoff radius, so it cannot be decomposed over MPI.");
+        }
+
+        // 部分領域がなるべく立方体に近くなるように、プロセスの個数を3方向に分ける
+        std::vector<int> dims(3, 0);
+        boost::mpi::cartesian_dimensions(world_.size(), dims);
+
+        dims_ = { { dims[0], dims[1], dims[2] } };
+
+        auto const rank = world_.rank();
+        coords_ = { { rank / (dims_[1] * dims_[2]), (rank / dims_[2]) % dims_[1], rank % dims_[2] } };
+
+        for (auto d = 0; d < 3; d++) {
+            width_[d] = periodiclen / static_cast<T>(dims_[d]);
+            lo_[d] = static_cast<T>(coords_[d]) * width_[d];
+            hi_[d] = lo_[d] + width_[d];
+
+            // ゴースト原子は隣の部分領域からだけ受け取るので、部分領域の幅はカットオフ半径以上でなければならない
+            if (width_[d] < rc) {
+                throw std::runtime_error("The MPI subdomain is narrower than the cutoff radius; use fewer processes or a larger system.");
+            }
+
+            // 周期境界条件を考慮して、隣のプロセスの番号を求める
+            for (auto dir = 0; dir < 2; dir++) {
+                auto coords = coords_;
+                coords[d] = (coords_[d] + (dir == 0 ? dims_[d] - 1 : 1)) % dims_[d];
+                neighbor_[d][dir] = (coords[0] * dims_[1] + coords[1]) * dims_[2] + coords[2];
+            }
+
+            // 部分領域の両側にカットオフ半径だけ広げた範囲を、一辺がカットオフ半径以上のセルに分ける
+            auto const extent = width_[d] + 2 * rc;
+            ncell_[d] = std::max(static_cast<std::int32_t>(std::floor(extent / rc)), 1);
+            invcellsize_[d] = static_cast<T>(ncell_[d]) / extent;
+        }
+    }
+
+    // #endregion publicメンバ関数
+
+    // #region privateメンバ関数
+
+    template <typename T>
+    void MpiDomain<T>::BuildCells()
+    {
+        auto const numatom = r_.size();
+        auto const ncellall = ncell_[0] * ncell_[1] * ncell_[2];
+
+        atomcell_.resize(numatom);
+        cellatom_.resize(numatom);
+        cellstart_.assign(ncellall + 1, 0);
+
+        // 各原子が属するセルを求め、各セルに属する原子の個数を数える
+        for (auto n = 0; n < numatom; n++) {
+            auto const c = (cellindex(r_[n][0], 0) * ncell_[1] + cellindex(r_[n][1], 1)) * ncell_[2] + cellindex(r_[n][2], 2);
+            atomcell_[n] = c;
+            cellstart_[c + 1]++;
+        }
+
+        // 原子の個数の累積和から各セルの先頭の位置を求める
+        for (auto c = 0; c < ncellall; c++) {
+            cellstart_[c + 1] += cellstart_[c];
+        }
+
+        // 原子の番号をセルの番号順に並べる（計数ソート）
+        std::vector<std::int32_t> pos(cellstart_.begin(), cellstart_.end() - 1);
+        for (auto n = 0; n < numatom; n++) {
+            cellatom_[pos[atomcell_[n]]++] = n;
+        }
+    }
+
+    template <typename T>
+    template <typename U>
+    void MpiDomain<T>::Exchange(std::int32_t d, std::int32_t dir, std::vector<U> const & send, std::vector<U> & recv) const
+    {
+        auto const dest = neighbor_[d][dir];
+        auto const source = neighbor_[d][1 - dir];
+        auto const tag = 2 * d + dir;
+
+        // 先に個数を交換してから、受け取る配列を確保する
+        auto const sendsize = static_cast<std::int32_t>(send.size());
+        auto recvsize = 0;
+        world_.sendrecv(dest, tag, sendsize, source, tag, recvsize);
+        recv.resize(recvsize);
+
+        std::array<boost::mpi::request, 2> requests = { {
+            world_.irecv(source, tag, recv.data(), recvsize),
+            world_.isend(dest, tag, send.data(), sendsize) } };
+        boost::mpi::wait_all(requests.begin(), requests.end());
+    }
+
+    // #endregion privateメンバ関数
+}
+
+#endif  // _MPIDOMAIN_H_
@@ -0,0 +1,23 @@
+﻿/*! \file neighborsearchtype.h
+    \brief 相互作用する原子の組を探索する手法を表す列挙型の宣言
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _NEIGHBORSEARCHTYPE_H_
+#define _NEIGHBORSEARCHTYPE_H_
+
+#pragma once
+
+#include <cstdint>  // for std::int32_t
+
+namespace moleculardynamics {
+    enum class NeighborSearchType : std::int32_t {
+        AllPairs = 0,
+        LinkedCell = 1,
+        VerletList = 2
+    };
+}
+
+#endif  // _NEIGHBORSEARCHTYPE_H_
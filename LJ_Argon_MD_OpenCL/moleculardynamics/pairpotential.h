@@ -0,0 +1,359 @@
+﻿/*! \file pairpotential.h
+    \brief Lennard-Jonesポテンシャルと力を、原子間の距離の二乗から求めるクラスの宣言と実装
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _PAIRPOTENTIAL_H_
+#define _PAIRPOTENTIAL_H_
+
+#pragma once
+
+#include "pairpotentialtype.h"
+#include <algorithm>    // for std::max
+#include <cmath>        // for std::fabs, std::sqrt
+#include <cstdint>      // for std::int32_t
+#include <vector>       // for std::vector
+
+namespace moleculardynamics {
+    //! A template class.
+    /*!
+        Lennard-Jonesポテンシャルと力を、原子間の距離の二乗から求めるクラス
+        スプライン補間の場合は、距離の二乗について等間隔な三次Hermiteスプラインの表を用いる
+        \tparam T 座標の型
+    */
+    template <typename T>
+    class PairPotential final {
+        // #region コンストラクタ・デストラクタ
+
+    public:
+        //! A constructor.
+        /*!
+            デフォルトコンストラクタ
+        */
+        PairPotential() = default;
+
+        //! A destructor.
+        /*!
+            デフォルトデストラクタ
+        */
+        ~PairPotential() = default;
+
+        // #endregion コンストラクタ・デストラクタ
+
+        // #region publicメンバ関数
+
+        //! A public member function (constant).
+        /*!
+            原子間の距離の二乗から、力の大きさを距離で割ったものとポテンシャルエネルギーを求める
+            \param r2 原子間の距離の二乗（カットオフ半径の二乗以下）
+            \param U ポテンシャルエネルギー（打ち切りの補正を含む）
+            \return 力の大きさを距離で割ったもの
+        */
+        T operator()(T r2, T & U) const
+        {
+            switch (type_) {
+            case PairPotentialType::Spline:
+                if (r2 >= PairPotential::R2MIN) {
+                    return spline(r2, U);
+                }
+                // 表の範囲外（近距離）はr^2の式で計算する
+                return r2form(r2, U);
+
+            case PairPotentialType::R2:
+                return r2form(r2, U);
+
+            default:
+                return analytic(r2, U);
+            }
+        }
+
+        //! A public member function (constant).
+        /*!
+            評価方法を返す
+            \return 評価方法
+        */
+        PairPotentialType type() const
+        {
+            return type_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            力の誤差の最大値を返す
+            \return 解析的な式（倍精度）に対する力の大きさの誤差の最大値
+        */
+        double getMaxForceError() const
+        {
+            return maxforceerror_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            ポテンシャルエネルギーの誤差の最大値を返す
+            \return 解析的な式（倍精度）に対するポテンシャルエネルギーの誤差の最大値
+        */
+        double getMaxEnergyError() const
+        {
+            return maxenergyerror_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            スプライン補間の表の間隔の逆数を返す
+            \return 表の間隔の逆数
+        */
+        T getInvDelta() const
+        {
+            return invdelta_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            スプライン補間の表の区間の個数を返す
+            \return 表の区間の個数
+        */
+        std::int32_t getTableSize() const
+        {
+            return tablesize_;
+        }
+
+        //! A public member function.
+        /*!
+            評価方法を設定し、スプライン補間の表を構築して、解析的な式に対する誤差を求める
+            \param type 評価方法
+            \param tablesize スプライン補間の表の区間の個数
+            \param rc2 カットオフ半径の二乗
+            \param Vrc ポテンシャルエネルギーの打ち切り
+        */
+        void setup(PairPotentialType type, std::int32_t tablesize, T rc2, T Vrc);
+
+        //! A public member function (constant).
+        /*!
+            スプライン補間の表を返す
+            区間iについて、8i～8i+3番目がポテンシャルエネルギー、8i+4～8i+7番目が力の大きさを距離で割ったものの多項式の係数
+            \return スプライン補間の表
+        */
+        std::vector<T> const & table() const
+        {
+            return table_;
+        }
+
+        //! A public static member function.
+        /*!
+            評価方法の名前を返す
+            \param type 評価方法
+            \return 評価方法の名前
+        */
+        static char const * name(PairPotentialType type)
+        {
+            switch (type) {
+            case PairPotentialType::R2:
+                return "r^2 form (no sqrt)";
+
+            case PairPotentialType::Spline:
+                return "Cubic spline table in r^2";
+
+            default:
+                return "Analytic";
+            }
+        }
+
+        // #endregion publicメンバ関数
+
+        // #region privateメンバ関数
+
+    private:
+        //! A private member function (constant).
+        /*!
+            sqrtを用いる元の式で求める
+            \param r2 原子間の距離の二乗
+            \param U ポテンシャルエネルギー
+            \return 力の大きさを距離で割ったもの
+        */
+        T analytic(T r2, T & U) const
+        {
+            auto const r = std::sqrt(r2);
+            auto const rm6 = 1.0 / (r2 * r2 * r2);
+            auto const rm7 = rm6 / r;
+            auto const rm12 = rm6 * rm6;
+            auto const rm13 = rm12 / r;
+
+            auto const Fr = 48.0 * rm13 - 24.0 * rm7;
+
+            U = 4.0 * (rm12 - rm6) - Vrc_;
+            return Fr / r;
+        }
+
+        //! A private member function (constant).
+        /*!
+            sqrtを用いず、一度の除算だけで求める
+            \param r2 原子間の距離の二乗
+            \param U ポテンシャルエネルギー
+            \return 力の大きさを距離で割ったもの
+        */
+        T r2form(T r2, T & U) const
+        {
+            auto const rm2 = static_cast<T>(1) / r2;
+            auto const rm6 = rm2 * rm2 * rm2;
+            auto const rm12 = rm6 * rm6;
+
+            U = static_cast<T>(4) * (rm12 - rm6) - Vrc_;
+            return rm2 * (static_cast<T>(48) * rm12 - static_cast<T>(24) * rm6);
+        }
+
+        //! A private member function (constant).
+        /*!
+            スプライン補間の表から求める
+            \param r2 原子間の距離の二乗（R2MIN以上、カットオフ半径の二乗以下）
+            \param U ポテンシャルエネルギー
+            \return 力の大きさを距離で割ったもの
+        */
+        T spline(T r2, T & U) const
+        {
+            auto const x = (r2 - PairPotential::R2MIN) * invdelta_;
+            auto const i = static_cast<std::int32_t>(x);
+            auto const t = x - static_cast<T>(i);
+            auto const c = table_.data() + 8 * i;
+
+            U = ((c[3] * t + c[2]) * t + c[1]) * t + c[0];
+            return ((c[7] * t + c[6]) * t + c[5]) * t + c[4];
+        }
+
+        // #endregion privateメンバ関数
+
+        // #region メンバ変数
+
+    public:
+        //! A public member variable (constant).
+        /*!
+            スプライン補間の表の区間の個数の既定値
+        */
+        static auto constexpr DEFAULTTABLESIZE = 1024;
+
+        //! A public member variable (constant).
+        /*!
+            スプライン補間の表の最小の距離の二乗（r = 0.8）
+        */
+        static T const R2MIN;
+
+    private:
+        //! A private member variable (constant).
+        /*!
+            誤差を求めるときの標本点の個数
+        */
+        static auto constexpr NSAMPLE = 100000;
+
+        //! A private member variable.
+        /*!
+            表の間隔の逆数
+        */
+        T invdelta_ = 0;
+
+        //! A private member variable.
+        /*!
+            解析的な式（倍精度）に対するポテンシャルエネルギーの誤差の最大値
+        */
+        double maxenergyerror_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            解析的な式（倍精度）に対する力の大きさの誤差の最大値
+        */
+        double maxforceerror_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            スプライン補間の表
+        */
+        std::vector<T> table_;
+
+        //! A private member variable.
+        /*!
+            表の区間の個数
+        */
+        std::int32_t tablesize_ = 0;
+
+        //! A private member variable.
+        /*!
+            評価方法
+        */
+        PairPotentialType type_ = PairPotentialType::Analytic;
+
+        //! A private member variable.
+        /*!
+            ポテンシャルエネルギーの打ち切り
+        */
+        T Vrc_ = 0;
+    };
+
+    template <typename T>
+    T const PairPotential<T>::R2MIN = 0.64;
+
+    // #region publicメンバ関数
+
+    template <typename T>
+    void PairPotential<T>::setup(PairPotentialType type, std::int32_t tablesize, T rc2, T Vrc)
+    {
+        type_ = type;
+        tablesize_ = std::max(tablesize, 1);
+        Vrc_ = Vrc;
+
+        // 距離の二乗sの関数として、ポテンシャルエネルギーU(s)と力の大きさを距離で割ったものG(s)、およびその導関数を倍精度で求める
+        auto const exact = [Vrc](double s, double & U, double & dU, double & G, double & dG) {
+            auto const sm3 = 1.0 / (s * s * s);
+            auto const sm6 = sm3 * sm3;
+
+            U = 4.0 * (sm6 - sm3) - static_cast<double>(Vrc);
+            dU = (-24.0 * sm6 + 12.0 * sm3) / s;
+            G = (48.0 * sm6 - 24.0 * sm3) / s;
+            dG = (-336.0 * sm6 + 96.0 * sm3) / (s * s);
+        };
+
+        auto const r2min = static_cast<double>(PairPotential::R2MIN);
+        auto const delta = (static_cast<double>(rc2) - r2min) / static_cast<double>(tablesize_);
+        invdelta_ = static_cast<T>(1.0 / delta);
+
+        // s = rc2ちょうどのときに範囲外を参照しないように、区間を一つ余分に作る
+        table_.resize(8 * (tablesize_ + 1));
+        for (auto i = 0; i <= tablesize_; i++) {
+            double U0, dU0, G0, dG0, U1, dU1, G1, dG1;
+            exact(r2min + delta * static_cast<double>(i), U0, dU0, G0, dG0);
+            exact(r2min + delta * static_cast<double>(i + 1), U1, dU1, G1, dG1);
+
+            // 区間内の局所座標t ∈ [0, 1]についての三次Hermite多項式の係数
+            auto const hermite = [delta](T * c, double y0, double d0, double y1, double d1) {
+                c[0] = static_cast<T>(y0);
+                c[1] = static_cast<T>(delta * d0);
+                c[2] = static_cast<T>(3.0 * (y1 - y0) - delta * (2.0 * d0 + d1));
+                c[3] = static_cast<T>(2.0 * (y0 - y1) + delta * (d0 + d1));
+            };
+
+            hermite(table_.data() + 8 * i, U0, dU0, U1, dU1);
+            hermite(table_.data() + 8 * i + 4, G0, dG0, G1, dG1);
+        }
+
+        // 表の範囲内の標本点で、解析的な式（倍精度）と比較する
+        maxenergyerror_ = 0.0;
+        maxforceerror_ = 0.0;
+        for (auto i = 0; i <= PairPotential::NSAMPLE; i++) {
+            auto const s = static_cast<T>(r2min + (static_cast<double>(rc2) - r2min) * static_cast<double>(i) / static_cast<double>(PairPotential::NSAMPLE));
+
+            T U;
+            auto const G = (*this)(s, U);
+
+            double Uexact, dU, Gexact, dG;
+            exact(static_cast<double>(s), Uexact, dU, Gexact, dG);
+
+            // 力の大きさはG(s)に距離をかけたもの
+            auto const r = std::sqrt(static_cast<double>(s));
+            maxenergyerror_ = std::max(maxenergyerror_, std::fabs(static_cast<double>(U) - Uexact));
+            maxforceerror_ = std::max(maxforceerror_, std::fabs(static_cast<double>(G) - Gexact) * r);
+        }
+    }
+
+    // #endregion publicメンバ関数
+}
+
+#endif  // _PAIRPOTENTIAL_H_
@@ -0,0 +1,23 @@
+﻿/*! \file pairpotentialtype.h
+    \brief Lennard-Jonesポテンシャルの評価方法を表す列挙型の宣言
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _PAIRPOTENTIALTYPE_H_
+#define _PAIRPOTENTIALTYPE_H_
+
+#pragma once
+
+#include <cstdint>  // for std::int32_t
+
+namespace moleculardynamics {
+    enum class PairPotentialType : std::int32_t {
+        Analytic = 0,
+        R2 = 1,
+        Spline = 2
+    };
+}
+
+#endif  // _PAIRPOTENTIALTYPE_H_
@@ -16,7 +16,9 @@ namespace moleculardynamics {
     enum class ParallelType : std::int32_t {
         NoParallel = 0,
         OpenCl = 1,
-        Tbb = 2
+        Tbb = 2,
+        Hybrid = 3,
+        Mpi = 4
     };
 }
 
@@ -0,0 +1,22 @@
+﻿/*! \file particlelayout.h
+    \brief 原子の座標・速度・力を格納するメモリ配置を表す列挙型の宣言
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _PARTICLELAYOUT_H_
+#define _PARTICLELAYOUT_H_
+
+#pragma once
+
+#include <cstdint>  // for std::int32_t
+
+namespace moleculardynamics {
+    enum class ParticleLayout : std::int32_t {
+        AoS = 0,
+        SoA = 1
+    };
+}
+
+#endif  // _PARTICLELAYOUT_H_
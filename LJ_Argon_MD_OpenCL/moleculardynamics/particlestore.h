@@ -0,0 +1,686 @@
+﻿/*! \file particlestore.h
+    \brief 原子の座標・速度・力などの3次元ベクトルの配列を格納するクラスの宣言と実装
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _PARTICLESTORE_H_
+#define _PARTICLESTORE_H_
+
+#pragma once
+
+#include "particlelayout.h"
+#include "precision.h"
+#include <algorithm>                                // for std::copy
+#include <array>                                    // for std::array
+#include <cstdint>                                  // for std::int32_t
+#include <new>                                      // for placement new
+#include <utility>                                  // for std::forward
+#include <vector>                                   // for std::vector
+#include <boost/compute/algorithm/copy.hpp>         // for boost::compute::copy
+#include <boost/compute/command_queue.hpp>          // for boost::compute::command_queue
+#include <boost/compute/container/vector.hpp>       // for boost::compute::vector
+#include <tbb/blocked_range.h>                      // for tbb::blocked_range
+#include <tbb/cache_aligned_allocator.h>            // for tbb::cache_aligned_allocator
+#include <tbb/parallel_for.h>                       // for tbb::parallel_for
+
+namespace moleculardynamics {
+    namespace compute = boost::compute;
+
+    //! A global variable (constant).
+    /*!
+        既定のメモリ配置（PARTICLE_AOSが定義されていればAoS、そうでなければSoA）
+    */
+#ifdef PARTICLE_AOS
+    static auto constexpr DEFAULTPARTICLELAYOUT = ParticleLayout::AoS;
+#else
+    static auto constexpr DEFAULTPARTICLELAYOUT = ParticleLayout::SoA;
+#endif
+
+    //! A template class.
+    /*!
+        引数なしで要素を構築する場合に、値初期化ではなくデフォルト初期化するアロケータ
+        確保しただけのメモリには書き込まないので、最初に書き込んだスレッドのNUMAノードにページが置かれる
+        \tparam T 要素の型
+    */
+    template <typename T>
+    class DefaultInitAllocator : public tbb::cache_aligned_allocator<T> {
+    public:
+        //! A template struct.
+        /*!
+            別の型の要素に対するアロケータ
+            \tparam U 要素の型
+        */
+        template <typename U>
+        struct rebind {
+            using other = DefaultInitAllocator<U>;
+        };
+
+        //! A constructor.
+        /*!
+            デフォルトコンストラクタ
+        */
+        DefaultInitAllocator() = default;
+
+        //! A constructor.
+        /*!
+            別の型の要素に対するアロケータからのコンストラクタ
+        */
+        template <typename U>
+        DefaultInitAllocator(DefaultInitAllocator<U> const &)
+        {
+        }
+
+        //! A public member function.
+        /*!
+            要素をデフォルト初期化する
+            \param p 要素のアドレス
+        */
+        template <typename U>
+        void construct(U * p)
+        {
+            ::new (static_cast<void *>(p)) U;
+        }
+
+        //! A public member function.
+        /*!
+            引数から要素を構築する
+            \param p 要素のアドレス
+            \param args コンストラクタの引数
+        */
+        template <typename U, typename... Args>
+        void construct(U * p, Args &&... args)
+        {
+            ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+        }
+    };
+
+    //! A template class.
+    /*!
+        原子の座標・速度・力などの3次元ベクトルの配列を格納するクラス
+        \tparam T ベクトルの成分の型
+        \tparam L メモリ配置
+    */
+    template <typename T, ParticleLayout L = DEFAULTPARTICLELAYOUT>
+    class ParticleStore;
+
+    //! A template class.
+    /*!
+        3次元ベクトルの配列を、x, y, z成分ごとの配列（structure of arrays）として格納するクラス
+        \tparam T ベクトルの成分の型
+    */
+    template <typename T>
+    class ParticleStore<T, ParticleLayout::SoA> final {
+        // #region 型エイリアス
+
+    public:
+        using device_type = T;
+
+        using value_type = std::array<T, 3>;
+
+    private:
+        using component_type = std::vector<T, DefaultInitAllocator<T>>;
+
+        // #endregion 型エイリアス
+
+        // #region static public 定数
+
+    public:
+        //! A public static member variable (constant).
+        /*!
+            デバイス側の配列を分けるブロックの個数（x, y, z成分ごとのブロックを、長さdev.size() / 3ずつ順に並べる）
+        */
+        static auto constexpr DEVICEBLOCKS = 3;
+
+        //! A public static member variable (constant).
+        /*!
+            デバイス側の配列で、1個のベクトルが占めるバイト数
+        */
+        static auto constexpr DEVICEBYTES = DEVICEBLOCKS * sizeof(device_type);
+
+        // #endregion static public 定数
+
+        // #region 内部クラス
+
+    public:
+        //! A class.
+        /*!
+            n個目のベクトルへの参照を表すクラス（r[n][i]の形でi番目の成分にアクセスする）
+        */
+        class reference final {
+        public:
+            //! A constructor.
+            /*!
+                コンストラクタ
+                \param data x, y, z成分の配列
+                \param n ベクトルの番号
+            */
+            reference(std::array<component_type, 3> & data, std::int32_t n)
+                : data_(data), n_(n)
+            {
+            }
+
+            //! A public member function (constant).
+            /*!
+                i番目の成分を返す
+                \param i 成分の番号
+                \return i番目の成分への参照
+            */
+            T & operator[](std::int32_t i) const
+            {
+                return data_[i][n_];
+            }
+
+        private:
+            //! A private member variable.
+            /*!
+                x, y, z成分の配列
+            */
+            std::array<component_type, 3> & data_;
+
+            //! A private member variable (constant).
+            /*!
+                ベクトルの番号
+            */
+            std::int32_t const n_;
+        };
+
+        //! A class.
+        /*!
+            n個目のベクトルへのconst参照を表すクラス
+        */
+        class const_reference final {
+        public:
+            //! A constructor.
+            /*!
+                コンストラクタ
+                \param data x, y, z成分の配列
+                \param n ベクトルの番号
+            */
+            const_reference(std::array<component_type, 3> const & data, std::int32_t n)
+                : data_(data), n_(n)
+            {
+            }
+
+            //! A public member function (constant).
+            /*!
+                i番目の成分を返す
+                \param i 成分の番号
+                \return i番目の成分
+            */
+            T operator[](std::int32_t i) const
+            {
+                return data_[i][n_];
+            }
+
+        private:
+            //! A private member variable.
+            /*!
+                x, y, z成分の配列
+            */
+            std::array<component_type, 3> const & data_;
+
+            //! A private member variable (constant).
+            /*!
+                ベクトルの番号
+            */
+            std::int32_t const n_;
+        };
+
+        // #endregion 内部クラス
+
+        // #region コンストラクタ・デストラクタ
+
+        //! A constructor.
+        /*!
+            デフォルトコンストラクタ
+        */
+        ParticleStore() = default;
+
+        //! A constructor.
+        /*!
+            コンストラクタ（全ての成分をゼロで初期化する）
+            \param size ベクトルの個数
+        */
+        explicit ParticleStore(std::int32_t size)
+            : data_({ { component_type(size, T()), component_type(size, T()), component_type(size, T()) } })
+        {
+        }
+
+        //! A destructor.
+        /*!
+            デフォルトデストラクタ
+        */
+        ~ParticleStore() = default;
+
+        // #endregion コンストラクタ・デストラクタ
+
+        // #region publicメンバ関数
+
+        //! A public member function.
+        /*!
+            n個目のベクトルへの参照を返す
+            \param n ベクトルの番号
+            \return n個目のベクトルへの参照
+        */
+        reference operator[](std::int32_t n)
+        {
+            return reference(data_, n);
+        }
+
+        //! A public member function (constant).
+        /*!
+            n個目のベクトルへのconst参照を返す
+            \param n ベクトルの番号
+            \return n個目のベクトルへのconst参照
+        */
+        const_reference operator[](std::int32_t n) const
+        {
+            return const_reference(data_, n);
+        }
+
+        //! A public member function.
+        /*!
+            ホスト側の配列をデバイス側のx, y, z成分のブロックに転送する
+            \param dev デバイス側の配列
+            \param queue OpenCLのキュー
+        */
+        void copy_to_device(compute::vector<device_type> & dev, compute::command_queue & queue) const
+        {
+            // デバイス側も成分ごとに分かれているので、詰め替えずに成分ごとの配列をそのまま転送する
+            auto const stride = static_cast<std::int32_t>(dev.size() / DEVICEBLOCKS);
+            for (auto i = 0; i < 3; i++) {
+                compute::copy(data_[i].data(), data_[i].data() + size(), dev.begin() + i * stride, queue);
+            }
+        }
+
+        //! A public member function.
+        /*!
+            デバイス側のx, y, z成分のブロックをホスト側の配列に転送する
+            \param dev デバイス側の配列
+            \param queue OpenCLのキュー
+        */
+        void copy_from_device(compute::vector<device_type> const & dev, compute::command_queue & queue)
+        {
+            copy_from_device(dev, queue, 0, size());
+        }
+
+        //! A public member function.
+        /*!
+            デバイス側のx, y, z成分のブロックの[first, last)番目を、ホスト側の配列の同じ位置に転送する
+            \param dev デバイス側の配列
+            \param queue OpenCLのキュー
+            \param first 最初のベクトルの番号
+            \param last 最後のベクトルの番号の次
+        */
+        void copy_from_device(compute::vector<device_type> const & dev, compute::command_queue & queue, std::int32_t first, std::int32_t last)
+        {
+            auto const stride = static_cast<std::int32_t>(dev.size() / DEVICEBLOCKS);
+            for (auto i = 0; i < 3; i++) {
+                compute::copy(dev.begin() + i * stride + first, dev.begin() + i * stride + last, data_[i].data() + first, queue);
+            }
+        }
+
+        //! A public member function.
+        /*!
+            別の配列の[first, last)番目のベクトルを、この配列の同じ位置にコピーする
+            \param other コピー元の配列
+            \param first 最初のベクトルの番号
+            \param last 最後のベクトルの番号の次
+        */
+        void copy_range(ParticleStore const & other, std::int32_t first, std::int32_t last)
+        {
+            for (auto i = 0; i < 3; i++) {
+                std::copy(other.data_[i].begin() + first, other.data_[i].begin() + last, data_[i].begin() + first);
+            }
+        }
+
+        //! A public member function.
+        /*!
+            i番目の成分の配列の先頭へのポインタを返す
+            \param i 成分の番号
+            \return i番目の成分の配列の先頭へのポインタ（キャッシュラインの境界に揃っている）
+        */
+        T * data(std::int32_t i)
+        {
+            return data_[i].data();
+        }
+
+        //! A public member function (constant).
+        /*!
+            i番目の成分の配列の先頭へのconstポインタを返す
+            \param i 成分の番号
+            \return i番目の成分の配列の先頭へのconstポインタ（キャッシュラインの境界に揃っている）
+        */
+        T const * data(std::int32_t i) const
+        {
+            return data_[i].data();
+        }
+
+        //! A public member function (constant).
+        /*!
+            n個目のベクトルの値を返す
+            \param n ベクトルの番号
+            \return n個目のベクトルの値
+        */
+        value_type get(std::int32_t n) const
+        {
+            return { { data_[0][n], data_[1][n], data_[2][n] } };
+        }
+
+        //! A public member function.
+        /*!
+            ベクトルの個数を変更する（増えた分の成分はゼロで初期化し、容量が足りていれば確保し直さない）
+            \param size ベクトルの個数
+        */
+        void resize(std::int32_t size)
+        {
+            for (auto & component : data_) {
+                component.resize(size, T());
+            }
+        }
+
+        //! A public member function.
+        /*!
+            ベクトルの個数を変更する（増えた分の成分は初期化しないので、メモリに最初に書き込むスレッドを呼び出し側で選べる）
+            \param size ベクトルの個数
+        */
+        void resize_uninitialized(std::int32_t size)
+        {
+            for (auto & component : data_) {
+                component.resize(size);
+            }
+        }
+
+        //! A public member function.
+        /*!
+            n個目のベクトルに値を設定する
+            \param n ベクトルの番号
+            \param v 設定する値
+        */
+        void set(std::int32_t n, value_type const & v)
+        {
+            data_[0][n] = v[0];
+            data_[1][n] = v[1];
+            data_[2][n] = v[2];
+        }
+
+        //! A public member function (constant).
+        /*!
+            ベクトルの個数を返す
+            \return ベクトルの個数
+        */
+        std::int32_t size() const
+        {
+            return static_cast<std::int32_t>(data_[0].size());
+        }
+
+        //! A public member function.
+        /*!
+            メモリ配置の名前を返す
+            \return メモリ配置の名前
+        */
+        static char const * name()
+        {
+            return "SoA (x, y, z arrays, cache-line aligned)";
+        }
+
+        // #endregion publicメンバ関数
+
+        // #region メンバ変数
+
+    private:
+        //! A private member variable.
+        /*!
+            x, y, z成分の配列
+        */
+        std::array<component_type, 3> data_;
+
+        // #endregion メンバ変数
+    };
+
+    //! A template class.
+    /*!
+        3次元ベクトルの配列を、4成分のベクトルの配列（array of structures）として格納するクラス
+        \tparam T ベクトルの成分の型
+    */
+    template <typename T>
+    class ParticleStore<T, ParticleLayout::AoS> final {
+        // #region 型エイリアス
+
+    public:
+        using device_type = typename DeviceType<T>::vector4_type;
+
+        using value_type = std::array<T, 3>;
+
+        using reference = std::array<T, 4> &;
+
+        using const_reference = std::array<T, 4> const &;
+
+        // #endregion 型エイリアス
+
+        // #region static public 定数
+
+        //! A public static member variable (constant).
+        /*!
+            デバイス側の配列を分けるブロックの個数（4成分のベクトルの配列一つ）
+        */
+        static auto constexpr DEVICEBLOCKS = 1;
+
+        //! A public static member variable (constant).
+        /*!
+            デバイス側の配列で、1個のベクトルが占めるバイト数
+        */
+        static auto constexpr DEVICEBYTES = DEVICEBLOCKS * sizeof(device_type);
+
+        // #endregion static public 定数
+
+        // #region コンストラクタ・デストラクタ
+
+        //! A constructor.
+        /*!
+            デフォルトコンストラクタ
+        */
+        ParticleStore() = default;
+
+        //! A constructor.
+        /*!
+            コンストラクタ（全ての成分をゼロで初期化する）
+            \param size ベクトルの個数
+        */
+        explicit ParticleStore(std::int32_t size)
+            : data_(size, std::array<T, 4>())
+        {
+        }
+
+        //! A destructor.
+        /*!
+            デフォルトデストラクタ
+        */
+        ~ParticleStore() = default;
+
+        // #endregion コンストラクタ・デストラクタ
+
+        // #region publicメンバ関数
+
+        //! A public member function.
+        /*!
+            n個目のベクトルへの参照を返す
+            \param n ベクトルの番号
+            \return n個目のベクトルへの参照
+        */
+        reference operator[](std::int32_t n)
+        {
+            return data_[n];
+        }
+
+        //! A public member function (constant).
+        /*!
+            n個目のベクトルへのconst参照を返す
+            \param n ベクトルの番号
+            \return n個目のベクトルへのconst参照
+        */
+        const_reference operator[](std::int32_t n) const
+        {
+            return data_[n];
+        }
+
+        //! A public member function.
+        /*!
+            ホスト側の配列をデバイス側の4成分のベクトルの配列に転送する
+            \param dev デバイス側の配列
+            \param queue OpenCLのキュー
+        */
+        void copy_to_device(compute::vector<device_type> & dev, compute::command_queue & queue) const
+        {
+            auto const n = size();
+            staging_.resize(n);
+
+            // デバイス側も4成分のベクトルの配列なので、4番目の成分を埋めながら詰め替え、スレッドで分担する
+            tbb::parallel_for(
+                tbb::blocked_range<std::int32_t>(0, n),
+                [this](auto const & range) {
+                    for (auto i = range.begin(); i != range.end(); ++i) {
+                        staging_[i] = device_type(data_[i][0], data_[i][1], data_[i][2], static_cast<T>(0));
+                    }
+            });
+
+            compute::copy(staging_.begin(), staging_.end(), dev.begin(), queue);
+        }
+
+        //! A public member function.
+        /*!
+            デバイス側の4成分のベクトルの配列をホスト側の配列に転送する
+            \param dev デバイス側の配列
+            \param queue OpenCLのキュー
+        */
+        void copy_from_device(compute::vector<device_type> const & dev, compute::command_queue & queue)
+        {
+            copy_from_device(dev, queue, 0, size());
+        }
+
+        //! A public member function.
+        /*!
+            デバイス側の4成分のベクトルの配列の[first, last)番目を、ホスト側の配列の同じ位置に転送する
+            \param dev デバイス側の配列
+            \param queue OpenCLのキュー
+            \param first 最初のベクトルの番号
+            \param last 最後のベクトルの番号の次
+        */
+        void copy_from_device(compute::vector<device_type> const & dev, compute::command_queue & queue, std::int32_t first, std::int32_t last)
+        {
+            auto const n = last - first;
+            staging_.resize(n);
+
+            compute::copy(dev.begin() + first, dev.begin() + last, staging_.begin(), queue);
+
+            tbb::parallel_for(
+                tbb::blocked_range<std::int32_t>(0, n),
+                [this, first](auto const & range) {
+                    for (auto i = range.begin(); i != range.end(); ++i) {
+                        data_[first + i][0] = staging_[i][0];
+                        data_[first + i][1] = staging_[i][1];
+                        data_[first + i][2] = staging_[i][2];
+                    }
+            });
+        }
+
+        //! A public member function.
+        /*!
+            別の配列の[first, last)番目のベクトルを、この配列の同じ位置にコピーする
+            \param other コピー元の配列
+            \param first 最初のベクトルの番号
+            \param last 最後のベクトルの番号の次
+        */
+        void copy_range(ParticleStore const & other, std::int32_t first, std::int32_t last)
+        {
+            std::copy(other.data_.begin() + first, other.data_.begin() + last, data_.begin() + first);
+        }
+
+        //! A public member function (constant).
+        /*!
+            n個目のベクトルの値を返す
+            \param n ベクトルの番号
+            \return n個目のベクトルの値
+        */
+        value_type get(std::int32_t n) const
+        {
+            return { { data_[n][0], data_[n][1], data_[n][2] } };
+        }
+
+        //! A public member function.
+        /*!
+            ベクトルの個数を変更する（増えた分の成分はゼロで初期化し、容量が足りていれば確保し直さない）
+            \param size ベクトルの個数
+        */
+        void resize(std::int32_t size)
+        {
+            data_.resize(size, std::array<T, 4>());
+        }
+
+        //! A public member function.
+        /*!
+            ベクトルの個数を変更する（増えた分の成分は初期化しないので、メモリに最初に書き込むスレッドを呼び出し側で選べる）
+            \param size ベクトルの個数
+        */
+        void resize_uninitialized(std::int32_t size)
+        {
+            data_.resize(size);
+        }
+
+        //! A public member function.
+        /*!
+            n個目のベクトルに値を設定する
+            \param n ベクトルの番号
+            \param v 設定する値
+        */
+        void set(std::int32_t n, value_type const & v)
+        {
+            data_[n][0] = v[0];
+            data_[n][1] = v[1];
+            data_[n][2] = v[2];
+        }
+
+        //! A public member function (constant).
+        /*!
+            ベクトルの個数を返す
+            \return ベクトルの個数
+        */
+        std::int32_t size() const
+        {
+            return static_cast<std::int32_t>(data_.size());
+        }
+
+        //! A public member function.
+        /*!
+            メモリ配置の名前を返す
+            \return メモリ配置の名前
+        */
+        static char const * name()
+        {
+            return "AoS (4-component vectors)";
+        }
+
+        // #endregion publicメンバ関数
+
+        // #region メンバ変数
+
+    private:
+        //! A private member variable.
+        /*!
+            4成分のベクトルの配列（4番目の成分は使用しない）
+        */
+        std::vector<std::array<T, 4>, DefaultInitAllocator<std::array<T, 4>>> data_;
+
+        //! A private member variable.
+        /*!
+            デバイスとの転送に用いる4成分のベクトルの配列
+        */
+        mutable std::vector<device_type> staging_;
+
+        // #endregion メンバ変数
+    };
+}
+
+#endif  // _PARTICLESTORE_H_
@@ -0,0 +1,107 @@
+﻿/*! \file precision.h
+    \brief 原子の組の計算と、力・エネルギーの足し合わせおよび時間発展に用いる浮動小数点数の型を決める構造体の宣言
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _PRECISION_H_
+#define _PRECISION_H_
+
+#pragma once
+
+#include <type_traits>                              // for std::is_same
+#include <boost/static_assert.hpp>                 // for BOOST_STATIC_ASSERT（fundamental.hppが使用する）
+#include <boost/compute/types/fundamental.hpp>      // for boost::compute::float4_, boost::compute::double4_
+
+namespace moleculardynamics {
+    namespace compute = boost::compute;
+
+    //! A template struct.
+    /*!
+        ホスト側の浮動小数点数の型に対応する、デバイス側の型
+        \tparam T ホスト側の浮動小数点数の型
+    */
+    template <typename T>
+    struct DeviceType;
+
+    //! A struct.
+    /*!
+        floatに対応するデバイス側の型
+    */
+    template <>
+    struct DeviceType<float> {
+        //! A typedef.
+        /*!
+            4成分のベクトルの型
+        */
+        using vector4_type = compute::float4_;
+
+        //! A public static member function.
+        /*!
+            OpenCL Cでの型の名前を返す
+            \return OpenCL Cでの型の名前
+        */
+        static char const * name()
+        {
+            return "float";
+        }
+    };
+
+    //! A struct.
+    /*!
+        doubleに対応するデバイス側の型（cl_khr_fp64が必要）
+    */
+    template <>
+    struct DeviceType<double> {
+        //! A typedef.
+        /*!
+            4成分のベクトルの型
+        */
+        using vector4_type = compute::double4_;
+
+        //! A public static member function.
+        /*!
+            OpenCL Cでの型の名前を返す
+            \return OpenCL Cでの型の名前
+        */
+        static char const * name()
+        {
+            return "double";
+        }
+    };
+
+    //! A template struct.
+    /*!
+        精度の方針を表す構造体
+        MIXED_PRECISIONが定義されていれば、原子の組の計算はTで行い、
+        力とエネルギーの足し合わせおよび座標・速度の時間発展はdoubleで行う
+        \tparam T 原子の組の計算に用いる型
+    */
+    template <typename T>
+    struct Precision {
+        //! A typedef.
+        /*!
+            原子の組の計算に用いる型
+        */
+        using pair_type = T;
+
+        //! A typedef.
+        /*!
+            力とエネルギーの足し合わせ、および座標・速度の時間発展に用いる型
+        */
+#ifdef MIXED_PRECISION
+        using real_type = double;
+#else
+        using real_type = T;
+#endif
+
+        //! A public static member variable (constant).
+        /*!
+            原子の組の計算と時間発展とで、異なる型を用いるかどうか
+        */
+        static auto constexpr MIXED = !std::is_same<pair_type, real_type>::value;
+    };
+}
+
+#endif  // _PRECISION_H_
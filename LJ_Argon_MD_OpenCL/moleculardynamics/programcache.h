@@ -0,0 +1,362 @@
+﻿/*! \file programcache.h
+    \brief OpenCLのプログラムをビルドし、バイナリをディスクにキャッシュするクラスの宣言と実装
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _PROGRAMCACHE_H_
+#define _PROGRAMCACHE_H_
+
+#pragma once
+
+#include <cstdint>                                  // for std::int32_t
+#include <fstream>                                  // for std::ifstream, std::ofstream
+#include <iterator>                                 // for std::istreambuf_iterator
+#include <string>                                   // for std::string
+#include <vector>                                   // for std::vector
+#include <boost/compute/context.hpp>                // for boost::compute::context
+#include <boost/compute/detail/path.hpp>            // for boost::compute::detail::appdata_path, boost::compute::detail::path_delim
+#include <boost/compute/detail/sha1.hpp>            // for boost::compute::detail::sha1
+#include <boost/compute/exception/opencl_error.hpp> // for boost::compute::opencl_error
+#include <boost/compute/kernel.hpp>                 // for boost::compute::kernel
+#include <boost/compute/program.hpp>                // for boost::compute::program
+#include <boost/compute/utility/program_cache.hpp>  // for boost::compute::program_cache
+#include <boost/filesystem.hpp>                     // for boost::filesystem::create_directories, boost::filesystem::remove, boost::filesystem::rename, boost::filesystem::unique_path
+#include <tbb/tick_count.h>                         // for tbb::tick_count
+
+namespace moleculardynamics {
+    namespace compute = boost::compute;
+
+    //! A class.
+    /*!
+        OpenCLのプログラムをビルドし、バイナリをディスクにキャッシュするクラス
+        キャッシュのキーは、プラットフォーム・デバイス・ドライバのバージョン・ビルドオプション・ソースのハッシュ
+        （contextが複数のデバイスを含む場合は、プロセス内でだけキャッシュする）
+    */
+    class ProgramCache final {
+        // #region コンストラクタ・デストラクタ
+
+    public:
+        //! A constructor.
+        /*!
+            コンストラクタ
+            \param context OpenCL context
+        */
+        explicit ProgramCache(compute::context const & context);
+
+        //! A destructor.
+        /*!
+            デフォルトデストラクタ
+        */
+        ~ProgramCache() = default;
+
+        // #endregion コンストラクタ・デストラクタ
+
+        // #region publicメンバ関数
+
+        //! A public member function.
+        /*!
+            ソースからカーネルを作成する（同じプログラムのバイナリがキャッシュにあれば、それを用いる）
+            \param source ソース
+            \param name カーネルの名前
+            \param options ビルドオプション
+            \return カーネル
+        */
+        compute::kernel create(std::string const & source, std::string const & name, std::string const & options = std::string());
+
+        //! A public member function (constant).
+        /*!
+            キャッシュのディレクトリを返す
+            \return キャッシュのディレクトリ
+        */
+        std::string const & getDirectory() const
+        {
+            return directory_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            デバイスとkeyの組に対応する、キャッシュのディレクトリ内のファイル名を返す
+            \param key デバイス以外のキー
+            \param extension 拡張子
+            \return ファイル名
+        */
+        std::string getPath(std::string const & key, std::string const & extension) const;
+
+        //! A public member function (constant).
+        /*!
+            キャッシュにあったプログラムの個数を返す
+            \return キャッシュにあったプログラムの個数
+        */
+        std::int32_t getHits() const
+        {
+            return hits_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            キャッシュになかったプログラムの個数を返す
+            \return キャッシュになかったプログラムの個数
+        */
+        std::int32_t getMisses() const
+        {
+            return misses_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            プログラムの作成にかかった時間の合計を返す
+            \return プログラムの作成にかかった時間の合計（秒）
+        */
+        double getBuildTime() const
+        {
+            return buildtime_;
+        }
+
+        // #endregion publicメンバ関数
+
+        // #region privateメンバ関数
+
+    private:
+        //! A private member function.
+        /*!
+            キャッシュからバイナリを読み込んでプログラムをビルドする
+            \param path バイナリのファイル名
+            \param options ビルドオプション
+            \param program ビルドしたプログラム
+            \return 読み込めればtrue
+        */
+        bool load(std::string const & path, std::string const & options, compute::program & program) const;
+
+        //! A private member function.
+        /*!
+            プログラムのバイナリをキャッシュに書き込む（書き込めなければ何もしない）
+            （MPIの複数のランクが同時に書き込んでも壊れないように、一時ファイルに書いてから名前を変える）
+            \param path バイナリのファイル名
+            \param program ビルドしたプログラム
+        */
+        void save(std::string const & path, compute::program const & program) const;
+
+        // #endregion privateメンバ関数
+
+        // #region メンバ変数
+
+        //! A private member variable (constant).
+        /*!
+            プロセス内でビルドしたプログラムを保持する個数
+        */
+        static auto constexpr MEMORYCACHESIZE = 64;
+
+        //! A private member variable.
+        /*!
+            プログラムの作成にかかった時間の合計（秒）
+        */
+        double buildtime_ = 0.0;
+
+        //! A private member variable.
+        /*!
+            OpenCL context
+        */
+        compute::context context_;
+
+        //! A private member variable.
+        /*!
+            プラットフォーム・デバイス・ドライバを識別する文字列
+        */
+        std::string devicekey_;
+
+        //! A private member variable.
+        /*!
+            キャッシュのディレクトリ
+        */
+        std::string directory_;
+
+        //! A private member variable.
+        /*!
+            キャッシュにあったプログラムの個数
+        */
+        std::int32_t hits_ = 0;
+
+        //! A private member variable.
+        /*!
+            プロセス内でビルドしたプログラムのキャッシュ
+        */
+        compute::program_cache memorycache_;
+
+        //! A private member variable.
+        /*!
+            キャッシュになかったプログラムの個数
+        */
+        std::int32_t misses_ = 0;
+
+        //! A private member variable.
+        /*!
+            バイナリをディスクにキャッシュするかどうか（contextが一つのデバイスだけを含む場合）
+        */
+        bool usedisk_ = true;
+
+        // #endregion メンバ変数
+
+        // #region 禁止されたコンストラクタ・メンバ関数
+
+        //! A private copy constructor (deleted).
+        /*!
+            コピーコンストラクタ（禁止）
+        */
+        ProgramCache(ProgramCache const &) = delete;
+
+        //! A private member function (deleted).
+        /*!
+            operator=()の宣言（禁止）
+            \param コピー元のオブジェクト（未使用）
+            \return コピー元のオブジェクト
+        */
+        ProgramCache & operator=(ProgramCache const &) = delete;
+
+        // #endregion 禁止されたコンストラクタ・メンバ関数
+    };
+
+    // #region コンストラクタ
+
+    inline ProgramCache::ProgramCache(compute::context const & context)
+        :
+        context_(context),
+        directory_(compute::detail::appdata_path() + compute::detail::path_delim() + "LJ_Argon_MD_OpenCL"),
+        memorycache_(ProgramCache::MEMORYCACHESIZE)
+    {
+        // ドライバが更新されたら、キャッシュにあるバイナリは使わない
+        auto const devices = context_.get_devices();
+        auto const platform = devices.front().platform();
+        devicekey_ =
+            platform.name() + '\n' +
+            platform.version();
+
+        for (auto const & device : devices) {
+            devicekey_ += '\n' +
+                device.name() + '\n' +
+                device.version() + '\n' +
+                device.driver_version();
+        }
+
+        // program::binary()は最初のデバイスのバイナリしか返さないので、複数のデバイスを含むcontextではディスクに保存しない
+        usedisk_ = devices.size() == 1;
+    }
+
+    // #endregion コンストラクタ
+
+    // #region publicメンバ関数
+
+    inline compute::kernel ProgramCache::create(std::string const & source, std::string const & name, std::string const & options)
+    {
+        auto const start = tbb::tick_count::now();
+
+        compute::detail::sha1 sha1;
+        sha1.process(options).process(source);
+        std::string const hash = sha1;
+
+        // 同じプロセス内で既にビルドしていれば、それを用いる
+        auto cached = memorycache_.get(hash, options);
+        if (cached) {
+            hits_++;
+            buildtime_ += (tbb::tick_count::now() - start).seconds();
+            return compute::kernel(*cached, name);
+        }
+
+        auto const path = getPath(hash, ".bin");
+
+        compute::program program;
+        if (usedisk_ && load(path, options, program)) {
+            hits_++;
+        }
+        else {
+            // キャッシュになければソースからビルドして、バイナリを書き込む
+            program = compute::program::create_with_source(source, context_);
+            program.build(options);
+            if (usedisk_) {
+                save(path, program);
+            }
+            misses_++;
+        }
+
+        memorycache_.insert(hash, options, program);
+        buildtime_ += (tbb::tick_count::now() - start).seconds();
+
+        return compute::kernel(program, name);
+    }
+
+    inline std::string ProgramCache::getPath(std::string const & key, std::string const & extension) const
+    {
+        compute::detail::sha1 sha1;
+        sha1.process(devicekey_).process(key);
+
+        return directory_ + compute::detail::path_delim() + static_cast<std::string>(sha1) + extension;
+    }
+
+    // #endregion publicメンバ関数
+
+    // #region privateメンバ関数
+
+    inline bool ProgramCache::load(std::string const & path, std::string const & options, compute::program & program) const
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs) {
+            return false;
+        }
+
+        std::vector<unsigned char> binary(
+            (std::istreambuf_iterator<char>(ifs)),
+            std::istreambuf_iterator<char>());
+        if (binary.empty()) {
+            return false;
+        }
+
+        // 壊れたバイナリなどで失敗した場合は、ソースからビルドし直す
+        try {
+            program = compute::program::create_with_binary(binary, context_);
+            program.build(options);
+        }
+        catch (compute::opencl_error const &) {
+            return false;
+        }
+
+        return true;
+    }
+
+    inline void ProgramCache::save(std::string const & path, compute::program const & program) const
+    {
+        boost::system::error_code ec;
+        boost::filesystem::create_directories(directory_, ec);
+
+        auto const temppath = boost::filesystem::unique_path(path + ".%%%%-%%%%-%%%%-%%%%.tmp", ec);
+        if (ec) {
+            return;
+        }
+
+        {
+            std::ofstream ofs(temppath.string(), std::ios::binary);
+            if (!ofs) {
+                return;
+            }
+
+            auto const binary = program.binary();
+            ofs.write(reinterpret_cast<char const *>(binary.data()), binary.size());
+            ofs.close();
+
+            if (!ofs) {
+                boost::filesystem::remove(temppath, ec);
+                return;
+            }
+        }
+
+        // 同じディレクトリの中での名前の変更なので、他のランクからは書きかけのファイルは見えない
+        boost::filesystem::rename(temppath, path, ec);
+        if (ec) {
+            boost::filesystem::remove(temppath, ec);
+        }
+    }
+
+    // #endregion privateメンバ関数
+}
+
+#endif  // _PROGRAMCACHE_H_
@@ -0,0 +1,209 @@
+﻿/*! \file radialdistribution.h
+    \brief 周期境界条件の下で、動径分布関数を求めるクラスの宣言と実装
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _RADIALDISTRIBUTION_H_
+#define _RADIALDISTRIBUTION_H_
+
+#pragma once
+
+#include "particlestore.h"
+#include <cmath>                                // for std::nearbyint, std::pow, std::sqrt
+#include <cstdint>                              // for std::int32_t, std::int64_t
+#include <fstream>                              // for std::ofstream
+#include <string>                               // for std::string
+#include <vector>                               // for std::vector
+#include <boost/format.hpp>                     // for boost::format
+#include <boost/math/constants/constants.hpp>   // for boost::math::constants::pi
+
+namespace moleculardynamics {
+    //! A template class.
+    /*!
+        周期境界条件の下で、複数のステップの座標から動径分布関数g(r)を求めるクラス
+        距離は周期境界条件の長さの半分まで（最小イメージ規約）を考える
+        \tparam T 座標の型
+    */
+    template <typename T>
+    class RadialDistribution final {
+        // #region コンストラクタ・デストラクタ
+
+    public:
+        //! A constructor.
+        /*!
+            デフォルトコンストラクタ
+        */
+        RadialDistribution() = default;
+
+        //! A destructor.
+        /*!
+            デフォルトデストラクタ
+        */
+        ~RadialDistribution() = default;
+
+        // #endregion コンストラクタ・デストラクタ
+
+        // #region publicメンバ関数
+
+        //! A public member function.
+        /*!
+            あるステップの座標から、原子の組の距離のヒストグラムに加える
+            \param r 原子の座標
+            \param numatom 原子数
+            \param periodiclen 周期境界条件の長さ
+        */
+        void accumulate(ParticleStore<T> const & r, std::int32_t numatom, T periodiclen);
+
+        //! A public member function.
+        /*!
+            ヒストグラムを空にする
+        */
+        void clear();
+
+        //! A public member function (constant).
+        /*!
+            ヒストグラムに加えたステップの数を返す
+            \return ヒストグラムに加えたステップの数
+        */
+        std::int32_t samples() const
+        {
+            return samples_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            動径分布関数をファイルに出力する（ステップを一つも加えていなければ何もしない）
+            \param filename 出力するファイル名
+        */
+        void save(std::string const & filename) const;
+
+        // #endregion publicメンバ関数
+
+        // #region メンバ変数
+
+    private:
+        //! A private member variable (constant).
+        /*!
+            ヒストグラムの区間の数
+        */
+        static auto constexpr NBIN = 200;
+
+        //! A private member variable.
+        /*!
+            距離ごとの原子の組の数のヒストグラム
+        */
+        std::vector<std::int64_t> histogram_ = std::vector<std::int64_t>(RadialDistribution::NBIN, 0);
+
+        //! A private member variable.
+        /*!
+            原子数
+        */
+        std::int32_t numatom_ = 0;
+
+        //! A private member variable.
+        /*!
+            周期境界条件の長さ
+        */
+        T periodiclen_ = 0;
+
+        //! A private member variable.
+        /*!
+            ヒストグラムに加えたステップの数
+        */
+        std::int32_t samples_ = 0;
+
+        // #endregion メンバ変数
+
+        // #region 禁止されたコンストラクタ・メンバ関数
+
+        //! A private copy constructor (deleted).
+        /*!
+            コピーコンストラクタ（禁止）
+        */
+        RadialDistribution(RadialDistribution const &) = delete;
+
+        //! A private member function (deleted).
+        /*!
+            operator=()の宣言（禁止）
+            \param コピー元のオブジェクト（未使用）
+            \return コピー元のオブジェクト
+        */
+        RadialDistribution & operator=(RadialDistribution const &) = delete;
+
+        // #endregion 禁止されたコンストラクタ・メンバ関数
+    };
+
+    // #region publicメンバ関数
+
+    template <typename T>
+    void RadialDistribution<T>::accumulate(ParticleStore<T> const & r, std::int32_t numatom, T periodiclen)
+    {
+        // 系の大きさが変わった場合は、それまでのヒストグラムを捨てる
+        if (numatom != numatom_ || periodiclen != periodiclen_) {
+            clear();
+            numatom_ = numatom;
+            periodiclen_ = periodiclen;
+        }
+
+        auto const rmax = 0.5 * periodiclen;
+        auto const invdr = static_cast<T>(RadialDistribution::NBIN) / rmax;
+
+        // 各原子の組を一度だけ数える
+        for (auto n = 0; n < numatom; n++) {
+            for (auto m = n + 1; m < numatom; m++) {
+                auto r2 = static_cast<T>(0);
+                for (auto i = 0; i < 3; i++) {
+                    auto d = r[n][i] - r[m][i];
+                    d -= periodiclen * std::nearbyint(d / periodiclen);
+                    r2 += d * d;
+                }
+
+                if (r2 < rmax * rmax) {
+                    auto const bin = static_cast<std::int32_t>(std::sqrt(r2) * invdr);
+                    if (bin < RadialDistribution::NBIN) {
+                        histogram_[bin]++;
+                    }
+                }
+            }
+        }
+
+        samples_++;
+    }
+
+    template <typename T>
+    void RadialDistribution<T>::clear()
+    {
+        histogram_.assign(RadialDistribution::NBIN, 0);
+        samples_ = 0;
+    }
+
+    template <typename T>
+    void RadialDistribution<T>::save(std::string const & filename) const
+    {
+        if (!samples_) {
+            return;
+        }
+
+        std::ofstream ofs(filename);
+
+        auto const dr = 0.5 * static_cast<double>(periodiclen_) / static_cast<double>(RadialDistribution::NBIN);
+        auto const rho = static_cast<double>(numatom_) / std::pow(static_cast<double>(periodiclen_), 3);
+        auto const pi = boost::math::constants::pi<double>();
+
+        for (auto bin = 0; bin < RadialDistribution::NBIN; bin++) {
+            // 理想気体で殻の中に入る原子の組の数で割る（各組は一度だけ数えているので、原子数の半分を掛ける）
+            auto const rlo = dr * static_cast<double>(bin);
+            auto const rhi = rlo + dr;
+            auto const shell = 4.0 / 3.0 * pi * (rhi * rhi * rhi - rlo * rlo * rlo);
+            auto const ideal = 0.5 * static_cast<double>(numatom_) * rho * shell * static_cast<double>(samples_);
+
+            ofs << boost::format("%.4f %.6f\n") % (rlo + 0.5 * dr) % (static_cast<double>(histogram_[bin]) / ideal);
+        }
+    }
+
+    // #endregion publicメンバ関数
+}
+
+#endif  // _RADIALDISTRIBUTION_H_
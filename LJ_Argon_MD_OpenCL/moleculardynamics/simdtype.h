@@ -0,0 +1,24 @@
+﻿/*! \file simdtype.h
+    \brief 力の計算の内側のループで用いるSIMD命令セットを表す列挙型の宣言
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _SIMDTYPE_H_
+#define _SIMDTYPE_H_
+
+#pragma once
+
+#include <cstdint>  // for std::int32_t
+
+namespace moleculardynamics {
+    enum class SimdType : std::int32_t {
+        Scalar = 0,
+        Sse42 = 1,
+        Avx2 = 2,
+        Avx512 = 3
+    };
+}
+
+#endif  // _SIMDTYPE_H_
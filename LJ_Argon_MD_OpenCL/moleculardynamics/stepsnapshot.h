@@ -0,0 +1,63 @@
+﻿/*! \file stepsnapshot.h
+    \brief TBBのフローグラフで時間発展を行う場合に、あるステップの結果を出力・解析のノードに渡す構造体の宣言と実装
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _STEPSNAPSHOT_H_
+#define _STEPSNAPSHOT_H_
+
+#pragma once
+
+#include "particlestore.h"
+#include <cstdint>  // for std::int32_t
+
+namespace moleculardynamics {
+    //! A template struct.
+    /*!
+        あるステップの全エネルギーと温度のスケーリングの係数、および解析に用いる座標の写し
+        出力と解析は次のステップと同時に行うので、時間発展で書き換えられる値は全てここに写しておく
+        \tparam T 座標とエネルギーの型
+    */
+    template <typename T>
+    struct StepSnapshot final {
+        //! A public member variable.
+        /*!
+            MDのステップ数
+        */
+        std::int32_t step = 0;
+
+        //! A public member variable.
+        /*!
+            全エネルギー
+        */
+        T Utot = 0;
+
+        //! A public member variable.
+        /*!
+            このステップで一つ前のステップの温度を用いたかどうか
+        */
+        bool lagged = false;
+
+        //! A public member variable.
+        /*!
+            このステップで速度のスケーリングに用いた係数（Exactの場合は0）
+        */
+        T s = 0;
+
+        //! A public member variable.
+        /*!
+            このステップの温度から求めた速度のスケーリングの係数
+        */
+        T sexact = 0;
+
+        //! A public member variable.
+        /*!
+            原子の座標の写し（解析を行わないステップでは空）
+        */
+        ParticleStore<T> r;
+    };
+}
+
+#endif  // _STEPSNAPSHOT_H_
@@ -0,0 +1,290 @@
+﻿/*! \file tbbaffinity.h
+    \brief TBBで原子のループを並列化する場合に、NUMAノードとキャッシュの親和性を保つクラスの宣言と実装
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _TBBAFFINITY_H_
+#define _TBBAFFINITY_H_
+
+#pragma once
+
+#include <array>                            // for std::array
+#include <cstddef>                          // for std::size_t
+#include <cstdint>                          // for std::int32_t
+#include <memory>                           // for std::unique_ptr
+#include <vector>                           // for std::vector
+#include <tbb/blocked_range.h>              // for tbb::blocked_range
+#include <tbb/info.h>                       // for tbb::info::numa_nodes
+#include <tbb/parallel_for.h>               // for tbb::parallel_for
+#include <tbb/parallel_reduce.h>            // for tbb::parallel_reduce
+#include <tbb/partitioner.h>                // for tbb::affinity_partitioner
+#include <tbb/task_arena.h>                 // for tbb::task_arena
+#include <tbb/task_group.h>                 // for tbb::task_group
+
+namespace moleculardynamics {
+    //! A class.
+    /*!
+        TBBで原子のループを並列化する場合に、NUMAノードとキャッシュの親和性を保つクラス
+        原子をNUMAノードの数で連続した区間に分け、各区間はそのノードに固定したtask_arenaの中で、
+        ステップ間で使い回すaffinity_partitionerを用いて並列化する
+        （無効な場合は、既定の分割でtbb::parallel_forとtbb::parallel_reduceを呼ぶだけ）
+    */
+    class TbbAffinity final {
+        // #region コンストラクタ・デストラクタ
+
+    public:
+        //! A constructor.
+        /*!
+            デフォルトコンストラクタ
+        */
+        TbbAffinity() = default;
+
+        //! A destructor.
+        /*!
+            デフォルトデストラクタ
+        */
+        ~TbbAffinity() = default;
+
+        // #endregion コンストラクタ・デストラクタ
+
+        // #region publicメンバ関数
+
+        //! A public member function (constant).
+        /*!
+            有効かどうかを返す
+            \return 有効ならtrue
+        */
+        bool enabled() const
+        {
+            return !nodes_.empty();
+        }
+
+        //! A public member function (constant).
+        /*!
+            i番目のNUMAノードの番号を返す
+            \param i 何番目のNUMAノードか
+            \return NUMAノードの番号（NUMAの構成が取得できなければtbb::task_arena::automatic）
+        */
+        tbb::numa_node_id nodeid(std::int32_t i) const
+        {
+            return nodes_[i]->id;
+        }
+
+        //! A public member function (constant).
+        /*!
+            NUMAノードの個数を返す
+            \return NUMAノードの個数（無効なら0）
+        */
+        std::int32_t nodenum() const
+        {
+            return static_cast<std::int32_t>(nodes_.size());
+        }
+
+        //! A public member function.
+        /*!
+            [0, size)の原子のループを並列化する
+            \param size 原子数
+            \param loop ループの種類（同時に実行されうるループは、別の種類にする）
+            \param body tbb::blocked_range<std::int32_t>を受け取る関数オブジェクト
+        */
+        template <typename Body>
+        void parallel_for(std::int32_t size, std::int32_t loop, Body const & body);
+
+        //! A public member function.
+        /*!
+            [0, size)の原子のループを並列化して、値を集計する
+            \param size 原子数
+            \param loop ループの種類（同時に実行されうるループは、別の種類にする）
+            \param identity 集計の単位元
+            \param body tbb::blocked_range<std::int32_t>と途中の値を受け取り、集計した値を返す関数オブジェクト
+            \param join 二つの値を集計する関数オブジェクト
+            \return 集計した値
+        */
+        template <typename Value, typename Body, typename Join>
+        Value parallel_reduce(std::int32_t size, std::int32_t loop, Value const & identity, Body const & body, Join const & join);
+
+        //! A public member function.
+        /*!
+            有効かどうかを設定する
+            有効にする場合は、NUMAノードごとにそのノードのコアに固定したtask_arenaを作る
+            \param enable 有効にするならtrue
+        */
+        void setup(bool enable)
+        {
+            nodes_.clear();
+
+            if (enable) {
+                for (auto const id : tbb::info::numa_nodes()) {
+                    nodes_.push_back(std::make_unique<Node>(id));
+                }
+            }
+        }
+
+        // #endregion publicメンバ関数
+
+        // #region privateメンバ関数
+
+    private:
+        //! A private member function (constant).
+        /*!
+            i番目のNUMAノードが受け持つ原子の区間を返す
+            \param size 原子数
+            \param i 何番目のNUMAノードか
+            \return 受け持つ原子の区間
+        */
+        tbb::blocked_range<std::int32_t> noderange(std::int32_t size, std::size_t i) const
+        {
+            auto const nnode = static_cast<std::int64_t>(nodes_.size());
+            return tbb::blocked_range<std::int32_t>(
+                static_cast<std::int32_t>(size * static_cast<std::int64_t>(i) / nnode),
+                static_cast<std::int32_t>(size * static_cast<std::int64_t>(i + 1) / nnode));
+        }
+
+        // #endregion privateメンバ関数
+
+        // #region メンバ変数
+
+    public:
+        //! A public member variable (constant).
+        /*!
+            時間発展や力の計算など、原子の配列を書き換えるループの種類
+        */
+        static auto constexpr ATOMLOOP = 0;
+
+        //! A public member variable (constant).
+        /*!
+            運動エネルギーの計算のループの種類（フローグラフでは力の計算と同時に実行される）
+        */
+        static auto constexpr KINETICLOOP = 1;
+
+    private:
+        //! A private member variable (constant).
+        /*!
+            ループの種類の個数
+        */
+        static auto constexpr LOOPNUM = 2;
+
+        //! A struct.
+        /*!
+            NUMAノードごとのtask_arenaと、ループの種類ごとのaffinity_partitioner
+        */
+        struct Node final {
+            //! A constructor.
+            /*!
+                コンストラクタ
+                \param nodeid NUMAノードの番号
+            */
+            explicit Node(tbb::numa_node_id nodeid)
+                : arena(tbb::task_arena::constraints(nodeid)), id(nodeid)
+            {
+            }
+
+            //! A public member variable.
+            /*!
+                NUMAノードのコアに固定したtask_arena
+            */
+            tbb::task_arena arena;
+
+            //! A public member variable.
+            /*!
+                NUMAノードの番号
+            */
+            tbb::numa_node_id id;
+
+            //! A public member variable.
+            /*!
+                ループの種類ごとに、ステップ間で使い回すaffinity_partitioner
+            */
+            std::array<tbb::affinity_partitioner, TbbAffinity::LOOPNUM> partitioner;
+        };
+
+        //! A private member variable.
+        /*!
+            NUMAノードごとのtask_arenaとaffinity_partitioner
+        */
+        std::vector<std::unique_ptr<Node>> nodes_;
+
+        // #endregion メンバ変数
+
+        // #region 禁止されたコンストラクタ・メンバ関数
+
+        //! A private copy constructor (deleted).
+        /*!
+            コピーコンストラクタ（禁止）
+        */
+        TbbAffinity(TbbAffinity const &) = delete;
+
+        //! A private member function (deleted).
+        /*!
+            operator=()の宣言（禁止）
+            \param コピー元のオブジェクト（未使用）
+            \return コピー元のオブジェクト
+        */
+        TbbAffinity & operator=(TbbAffinity const &) = delete;
+
+        // #endregion 禁止されたコンストラクタ・メンバ関数
+    };
+
+    // #region publicメンバ関数
+
+    template <typename Body>
+    void TbbAffinity::parallel_for(std::int32_t size, std::int32_t loop, Body const & body)
+    {
+        if (nodes_.empty()) {
+            tbb::parallel_for(tbb::blocked_range<std::int32_t>(0, size), body);
+            return;
+        }
+
+        // 各NUMAノードのtask_arenaに、そのノードが受け持つ区間のループを投入してから、全ての完了を待つ
+        std::vector<tbb::task_group> group(nodes_.size());
+        for (auto i = 0U; i < nodes_.size(); i++) {
+            auto & node = *nodes_[i];
+            node.arena.execute([this, size, loop, &body, &group, &node, i] {
+                group[i].run([this, size, loop, &body, &node, i] {
+                    tbb::parallel_for(noderange(size, i), body, node.partitioner[loop]);
+                });
+            });
+        }
+
+        for (auto i = 0U; i < nodes_.size(); i++) {
+            nodes_[i]->arena.execute([&group, i] { group[i].wait(); });
+        }
+    }
+
+    template <typename Value, typename Body, typename Join>
+    Value TbbAffinity::parallel_reduce(std::int32_t size, std::int32_t loop, Value const & identity, Body const & body, Join const & join)
+    {
+        if (nodes_.empty()) {
+            return tbb::parallel_reduce(tbb::blocked_range<std::int32_t>(0, size), identity, body, join);
+        }
+
+        // NUMAノードごとに集計してから、ノードの順に集計する
+        std::vector<Value> value(nodes_.size(), identity);
+        std::vector<tbb::task_group> group(nodes_.size());
+        for (auto i = 0U; i < nodes_.size(); i++) {
+            auto & node = *nodes_[i];
+            node.arena.execute([this, size, loop, &identity, &body, &join, &value, &group, &node, i] {
+                group[i].run([this, size, loop, &identity, &body, &join, &value, &node, i] {
+                    value[i] = tbb::parallel_reduce(noderange(size, i), identity, body, join, node.partitioner[loop]);
+                });
+            });
+        }
+
+        for (auto i = 0U; i < nodes_.size(); i++) {
+            nodes_[i]->arena.execute([&group, i] { group[i].wait(); });
+        }
+
+        auto result = identity;
+        for (auto const & v : value) {
+            result = join(result, v);
+        }
+
+        return result;
+    }
+
+    // #endregion publicメンバ関数
+}
+
+#endif  // _TBBAFFINITY_H_
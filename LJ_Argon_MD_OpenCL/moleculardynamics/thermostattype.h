@@ -0,0 +1,22 @@
+﻿/*! \file thermostattype.h
+    \brief 温度のスケーリングに用いる運動エネルギーの求め方を表す列挙型の宣言
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _THERMOSTATTYPE_H_
+#define _THERMOSTATTYPE_H_
+
+#pragma once
+
+#include <cstdint>  // for std::int32_t
+
+namespace moleculardynamics {
+    enum class ThermostatType : std::int32_t {
+        Exact = 0,
+        Lagged = 1
+    };
+}
+
+#endif  // _THERMOSTATTYPE_H_
@@ -0,0 +1,382 @@
+﻿/*! \file verletlist.h
+    \brief 周期境界条件の下で、Verletの近接リスト（帳簿法）を構築・管理するクラスの宣言と実装
+
+    Copyright ©  2016 @dc1394 All Rights Reserved.
+    This software is released under the BSD 2-Clause License.
+*/
+
+#ifndef _VERLETLIST_H_
+#define _VERLETLIST_H_
+
+#pragma once
+
+#include "linkedcell.h"
+#include <algorithm>    // for std::max, std::min
+#include <cmath>        // for std::nearbyint
+#include <cstdint>      // for std::int32_t
+#include <vector>       // for std::vector
+
+namespace moleculardynamics {
+    //! A template class.
+    /*!
+        周期境界条件の下で、Verletの近接リスト（帳簿法）を構築・管理するクラス
+        \tparam T 座標の型
+    */
+    template <typename T>
+    class VerletList final {
+        // #region コンストラクタ・デストラクタ
+
+    public:
+        //! A constructor.
+        /*!
+            デフォルトコンストラクタ
+        */
+        VerletList() = default;
+
+        //! A destructor.
+        /*!
+            デフォルトデストラクタ
+        */
+        ~VerletList() = default;
+
+        // #endregion コンストラクタ・デストラクタ
+
+        // #region publicメンバ関数
+
+        //! A public member function.
+        /*!
+            原子の座標から近接リストを構築する
+            \param r 原子の座標
+            \param numatom 原子数
+            \param periodiclen 周期境界条件の長さ
+            \param rl 近接リストのカットオフ半径（カットオフ半径 + スキンの厚さ）
+        */
+        template <typename Container>
+        void build(Container const & r, std::int32_t numatom, T periodiclen, T rl);
+
+        //! A public member function (constant).
+        /*!
+            n個目の原子の、近接リストを構築した時点からの変位の二乗を求める
+            \param n 原子の番号
+            \param x 現在のx座標
+            \param y 現在のy座標
+            \param z 現在のz座標
+            \return 変位の二乗
+        */
+        T displacement2(std::int32_t n, T x, T y, T z) const
+        {
+            auto const dx = minimage(x - rref_[3 * n]);
+            auto const dy = minimage(y - rref_[3 * n + 1]);
+            auto const dz = minimage(z - rref_[3 * n + 2]);
+
+            return dx * dx + dy * dy + dz * dz;
+        }
+
+        //! A public member function (constant).
+        /*!
+            近接リストを構築した回数を返す
+            \return 近接リストを構築した回数
+        */
+        std::int32_t getBuildCount() const
+        {
+            return buildcount_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            近接リストの再構築の間隔の最大値を返す
+            \return 再構築の間隔の最大値（MDのステップ数）
+        */
+        std::int32_t getMaxInterval() const
+        {
+            return maxinterval_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            近接リストの再構築の間隔の平均値を返す
+            \return 再構築の間隔の平均値（MDのステップ数）
+        */
+        double getMeanInterval() const
+        {
+            return buildcount_ > 1 ? static_cast<double>(sumintervals_) / static_cast<double>(buildcount_ - 1) : 0.0;
+        }
+
+        //! A public member function (constant).
+        /*!
+            近接リストの再構築の間隔の最小値を返す
+            \return 再構築の間隔の最小値（MDのステップ数）
+        */
+        std::int32_t getMinInterval() const
+        {
+            return buildcount_ > 1 ? mininterval_ : 0;
+        }
+
+        //! A public member function (constant).
+        /*!
+            記録されたMDのステップ数を返す
+            \return 記録されたMDのステップ数
+        */
+        std::int32_t getStepCount() const
+        {
+            return stepcount_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            近接リストに含まれる原子の番号を、原子の番号順に並べた配列を返す
+            \return 近接リストに含まれる原子の番号の配列
+        */
+        std::vector<std::int32_t> const & neighbor() const
+        {
+            return neighbor_;
+        }
+
+        //! A public member function (constant).
+        /*!
+            各原子の近接リストがneighbor()の何番目から始まるかを表す配列を返す
+            \return 各原子の近接リストの先頭の位置の配列（要素数は原子数 + 1）
+        */
+        std::vector<std::int32_t> const & neighborstart() const
+        {
+            return neighborstart_;
+        }
+
+        //! A public member function.
+        /*!
+            統計情報を初期化する
+        */
+        void resetstatistics()
+        {
+            buildcount_ = 0;
+            maxinterval_ = 0;
+            mininterval_ = 0;
+            stepcount_ = 0;
+            sumintervals_ = 0;
+        }
+
+        //! A public member function.
+        /*!
+            MDのステップが1つ進んだことを記録する
+        */
+        void step()
+        {
+            stepcount_++;
+        }
+
+        //! A public member function (constant).
+        /*!
+            近接リストが使用可能かどうかを返す
+            \param periodiclen 周期境界条件の長さ
+            \param rl 近接リストのカットオフ半径
+            \return 最小イメージ規約が成り立つならtrue
+        */
+        static bool usable(T periodiclen, T rl)
+        {
+            return rl < 0.5 * periodiclen;
+        }
+
+        // #endregion publicメンバ関数
+
+        // #region privateメンバ関数
+
+    private:
+        //! A private member function (constant).
+        /*!
+            最小イメージ規約に従って、距離の成分を周期境界条件の長さの半分以内に収める
+            \param d 距離の成分
+            \return 最も近いイメージとの距離の成分
+        */
+        T minimage(T d) const
+        {
+            return d - periodiclen_ * std::nearbyint(d / periodiclen_);
+        }
+
+        // #endregion privateメンバ関数
+
+        // #region メンバ変数
+
+        //! A private member variable.
+        /*!
+            近接リストを構築した回数
+        */
+        std::int32_t buildcount_ = 0;
+
+        //! A private member variable.
+        /*!
+            近接リストを構築したときのMDのステップ数
+        */
+        std::int32_t laststep_ = 0;
+
+        //! A private member variable.
+        /*!
+            近接リストの構築に用いるセルリスト
+        */
+        LinkedCell<T> linkedcell_;
+
+        //! A private member variable.
+        /*!
+            再構築の間隔の最大値
+        */
+        std::int32_t maxinterval_ = 0;
+
+        //! A private member variable.
+        /*!
+            再構築の間隔の最小値
+        */
+        std::int32_t mininterval_ = 0;
+
+        //! A private member variable.
+        /*!
+            近接リストに含まれる原子の番号
+        */
+        std::vector<std::int32_t> neighbor_;
+
+        //! A private member variable.
+        /*!
+            各原子の近接リストの先頭の位置
+        */
+        std::vector<std::int32_t> neighborstart_;
+
+        //! A private member variable.
+        /*!
+            周期境界条件の長さ
+        */
+        T periodiclen_ = 0;
+
+        //! A private member variable.
+        /*!
+            近接リストを構築したときの原子の座標
+        */
+        std::vector<T> rref_;
+
+        //! A private member variable.
+        /*!
+            近接リストのカットオフ半径
+        */
+        T rl_ = 0;
+
+        //! A private member variable.
+        /*!
+            記録されたMDのステップ数
+        */
+        std::int32_t stepcount_ = 0;
+
+        //! A private member variable.
+        /*!
+            再構築の間隔の和
+        */
+        std::int32_t sumintervals_ = 0;
+
+        // #endregion メンバ変数
+
+        // #region 禁止されたコンストラクタ・メンバ関数
+
+        //! A private copy constructor (deleted).
+        /*!
+            コピーコンストラクタ（禁止）
+        */
+        VerletList(VerletList const &) = delete;
+
+        //! A private member function (deleted).
+        /*!
+            operator=()の宣言（禁止）
+            \param コピー元のオブジェクト（未使用）
+            \return コピー元のオブジェクト
+        */
+        VerletList & operator=(VerletList const &) = delete;
+
+        // #endregion 禁止されたコンストラクタ・メンバ関数
+    };
+
+    // #region publicメンバ関数
+
+    template <typename T>
+    template <typename Container>
+    void VerletList<T>::build(Container const & r, std::int32_t numatom, T periodiclen, T rl)
+    {
+        // 再構築の間隔を記録
+        if (buildcount_ > 0) {
+            auto const interval = stepcount_ - laststep_;
+            maxinterval_ = std::max(maxinterval_, interval);
+            mininterval_ = buildcount_ > 1 ? std::min(mininterval_, interval) : interval;
+            sumintervals_ += interval;
+        }
+        buildcount_++;
+        laststep_ = stepcount_;
+
+        // セルの分割は周期境界条件の長さかカットオフ半径が変わったときだけ決め直す
+        if (periodiclen != periodiclen_ || rl != rl_) {
+            periodiclen_ = periodiclen;
+            rl_ = rl;
+            linkedcell_.setup(periodiclen, rl);
+        }
+
+        auto const rl2 = rl * rl;
+
+        neighbor_.clear();
+        neighborstart_.resize(numatom + 1);
+        rref_.resize(3 * numatom);
+
+        // 近接リストを構築したときの座標を保存
+        for (auto n = 0; n < numatom; n++) {
+            rref_[3 * n] = r[n][0];
+            rref_[3 * n + 1] = r[n][1];
+            rref_[3 * n + 2] = r[n][2];
+        }
+
+        // n個目の原子とm個目の原子の距離がrl以内であれば、m個目の原子を近接リストに加える
+        auto const addneighbor = [this, &r, rl2](std::int32_t n, std::int32_t m) {
+            auto const dx = minimage(r[n][0] - r[m][0]);
+            auto const dy = minimage(r[n][1] - r[m][1]);
+            auto const dz = minimage(r[n][2] - r[m][2]);
+
+            if (dx * dx + dy * dy + dz * dz <= rl2) {
+                neighbor_.push_back(m);
+            }
+        };
+
+        if (linkedcell_.usable()) {
+            // セルリストを用いて近接リストを構築する
+            linkedcell_.build(r, numatom);
+
+            auto const & cellatom = linkedcell_.cellatom();
+            auto const & cellstart = linkedcell_.cellstart();
+            auto const & neighborcell = linkedcell_.neighborcell();
+
+            for (auto n = 0; n < numatom; n++) {
+                neighborstart_[n] = static_cast<std::int32_t>(neighbor_.size());
+
+                auto const c = linkedcell_.atomcell(n) * LinkedCell<T>::NEIGHBORCELLNUM;
+                for (auto i = 0; i < LinkedCell<T>::NEIGHBORCELLNUM; i++) {
+                    auto const nc = neighborcell[c + i];
+
+                    for (auto idx = cellstart[nc]; idx < cellstart[nc + 1]; idx++) {
+                        auto const m = cellatom[idx];
+                        if (n != m) {
+                            addneighbor(n, m);
+                        }
+                    }
+                }
+            }
+        }
+        else {
+            // セルが3個未満の場合は、全ての原子の組から近接リストを構築する
+            for (auto n = 0; n < numatom; n++) {
+                neighborstart_[n] = static_cast<std::int32_t>(neighbor_.size());
+
+                for (auto m = 0; m < numatom; m++) {
+                    if (n != m) {
+                        addneighbor(n, m);
+                    }
+                }
+            }
+        }
+
+        neighborstart_[numatom] = static_cast<std::int32_t>(neighbor_.size());
+    }
+
+    // #endregion publicメンバ関数
+}
+
+#endif  // _VERLETLIST_H_